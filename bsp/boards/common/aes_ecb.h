@@ -14,8 +14,49 @@ Source: http://is.gd/o9RSPq
 extern "C" {
 #endif
 
+#include <limits.h>
+
+//=========================== define ==========================================
+
+// number of expanded keys kept between calls, looked up by key content
+#ifndef AES_ECB_KEYCACHE_SIZE
+#define AES_ECB_KEYCACHE_SIZE   2
+#endif
+
+// 32-bit T-table implementation (1kB of tables) vs. byte-oriented one
+#ifndef AES_ECB_TTABLE
+#if UINT_MAX > 0xffff
+#define AES_ECB_TTABLE          1
+#else
+#define AES_ECB_TTABLE          0
+#endif
+#endif
+
+#define AES_ECB_NUMROUNDS       10
+
+//=========================== typedef =========================================
+
+typedef struct {
+    uint8_t  key[16];
+    bool     valid;
+    uint8_t  inUse;             // number of encryptions currently using the entry
+#if AES_ECB_TTABLE
+    uint32_t roundKeys[4*(AES_ECB_NUMROUNDS+1)];
+#else
+    uint8_t  roundKeys[16*(AES_ECB_NUMROUNDS+1)];
+#endif
+} aes_ecb_keyCacheEntry_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+    aes_ecb_keyCacheEntry_t keyCache[AES_ECB_KEYCACHE_SIZE];
+    uint8_t                 nextVictim;  // round-robin replacement
+} aes_ecb_vars_t;
+
 //=========================== prototypes ======================================
 
+void      aes_ecb_init(void);
 owerror_t aes_ecb_enc(uint8_t* buffer, uint8_t* key);
 
 #ifdef  __cplusplus
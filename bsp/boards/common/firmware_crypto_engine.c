@@ -14,6 +14,7 @@
 #include "aes_ecb.h"
 
 static owerror_t init(void) {
+   aes_ecb_init();
    return E_SUCCESS;
 }
 
@@ -37,6 +37,7 @@ void board_init(OpenMote* self) {
    radiotimer_init(self);
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_board_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] board_init() returned NULL\r\n");
@@ -57,6 +58,7 @@ void board_sleep(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_board_sleep],NULL);
    if (result == NULL) {
       printf("[CRITICAL] board_sleep() returned NULL\r\n");
@@ -77,6 +79,7 @@ void board_reset(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_board_reset],NULL);
    if (result == NULL) {
       printf("[CRITICAL] board_reset() returned NULL\r\n");
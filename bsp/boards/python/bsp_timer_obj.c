@@ -29,6 +29,7 @@ void bsp_timer_init(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_bsp_timer_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] bsp_timer_init() returned NULL\r\n");
@@ -49,6 +50,7 @@ void bsp_timer_reset(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_bsp_timer_reset],NULL);
    if (result == NULL) {
       printf("[CRITICAL] bsp_timer_reset() returned NULL\r\n");
@@ -70,6 +72,7 @@ void bsp_timer_scheduleIn(OpenMote* self, PORT_TIMER_WIDTH delayTicks) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",delayTicks);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_bsp_timer_scheduleIn],arglist);
    if (result == NULL) {
@@ -92,6 +95,7 @@ void bsp_timer_cancel_schedule(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_bsp_timer_cancel_schedule],NULL);
    if (result == NULL) {
       printf("[CRITICAL] bsp_timer_cancel_schedule() returned NULL\r\n");
@@ -113,6 +117,7 @@ PORT_TIMER_WIDTH bsp_timer_get_currentValue(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_bsp_timer_get_currentValue],NULL);
    if (result == NULL) {
       printf("[CRITICAL] bsp_timer_get_currentValue() returned NULL\r\n");
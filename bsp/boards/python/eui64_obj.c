@@ -24,6 +24,7 @@ void eui64_get(OpenMote* self, uint8_t* addressToWrite) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_eui64_get],NULL);
    if (result == NULL) {
       printf("[CRITICAL] eui64_get() returned NULL\r\n");
@@ -0,0 +1,98 @@
+/**
+\brief Notifications batched from the C mote to the Python BSP.
+
+Output-only notifications (debugpins, LEDs, UART bytes, loaded radio frames)
+are appended to a per-mote buffer instead of calling into Python one by one.
+The buffer is handed to the MOTE_NOTIF_events callback as a single string
+when the mote returns to Python, or before any notification which Python
+handles directly, so Python sees all notifications in the order they were
+issued.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "openwsnmodule_obj.h"
+
+//=========================== defines =========================================
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+//=========================== public ==========================================
+
+/**
+\brief Append a notification to the batch.
+
+\param[in] notifId The MOTE_NOTIF_* identifier of the notification.
+\param[in] data    The payload of the notification, NULL if len is 0.
+\param[in] len     The number of bytes in the payload.
+
+\returns TRUE if the notification was batched, FALSE if Python has not
+   registered a MOTE_NOTIF_events callback, in which case the caller calls
+   the per-notification callback itself.
+*/
+bool events_push(OpenMote* self, uint8_t notifId, uint8_t* data, uint8_t len) {
+   events_vars_t* events;
+
+   if (self->callback[MOTE_NOTIF_events]==NULL) {
+      return FALSE;
+   }
+
+   events = &self->events_vars;
+   if (events->len+2+len>MOTE_EVENTS_SIZE) {
+      events_flush(self);
+   }
+
+   events->buf[events->len++] = notifId;
+   events->buf[events->len++] = len;
+   if (len>0) {
+      memcpy(&events->buf[events->len],data,len);
+      events->len += len;
+   }
+
+   return TRUE;
+}
+
+/**
+\brief Hand all batched notifications to Python in a single call.
+*/
+void events_flush(OpenMote* self) {
+   PyObject*   batch;
+   PyObject*   arglist;
+   PyObject*   result;
+
+   if (self->events_vars.len==0) {
+      return;
+   }
+
+#ifdef TRACE_ON
+   printf("C@0x%x: events_flush(len=%d)... \n",self,self->events_vars.len);
+#endif
+
+   batch      = PyString_FromStringAndSize(
+      (const char*)self->events_vars.buf,
+      self->events_vars.len
+   );
+   // empty the batch first, Python may call back into this mote
+   self->events_vars.len = 0;
+   if (batch==NULL) {
+      printf("[CRITICAL] PyString_FromStringAndSize() failed in events_flush\r\n");
+      return;
+   }
+
+   // forward to Python
+   arglist    = Py_BuildValue("(O)",batch);
+   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_events],arglist);
+   Py_DECREF(arglist);
+   Py_DECREF(batch);
+   if (result == NULL) {
+      printf("[CRITICAL] events_flush() returned NULL\r\n");
+      return;
+   }
+   Py_DECREF(result);
+
+#ifdef TRACE_ON
+   printf("C@0x%x: ...done.\n",self);
+#endif
+}
@@ -13,6 +13,8 @@
 
 //=========================== prototypes ======================================
 
+static void leds_forward(OpenMote* self, uint8_t notifId);
+
 //=========================== public ==========================================
 
 void leds_init(OpenMote* self) {
@@ -23,6 +25,7 @@ void leds_init(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] leds_init() returned NULL\r\n");
@@ -36,61 +39,13 @@ void leds_init(OpenMote* self) {
 }
 
 void leds_error_on(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_error_on()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_error_on],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_error_on() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_error_on);
 }
 void leds_error_off(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_error_off()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_error_off],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_error_off() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_error_off);
 }
 void leds_error_toggle(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_error_toggle()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_error_toggle],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_error_toggle() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_error_toggle);
 }
 uint8_t leds_error_isOn(OpenMote* self) {
    PyObject*  result;
@@ -101,6 +56,7 @@ uint8_t leds_error_isOn(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_error_isOn],NULL);
    if (result == NULL) {
       printf("[CRITICAL] leds_error_isOn() returned NULL\r\n");
@@ -116,81 +72,17 @@ uint8_t leds_error_isOn(OpenMote* self) {
    return returnVal;
 }
 void leds_error_blink(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_error_blink()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_error_blink],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_error_blink() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_error_blink);
 }
 
 void leds_radio_on(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_radio_on()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_radio_on],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_radio_on() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_radio_on);
 }
 void leds_radio_off(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_radio_off()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_radio_off],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_radio_off() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_radio_off);
 }
 void leds_radio_toggle(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_radio_toggle()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_radio_toggle],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_radio_toggle() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_radio_toggle);
 }
 uint8_t leds_radio_isOn(OpenMote* self) {
    PyObject*  result;
@@ -201,6 +93,7 @@ uint8_t leds_radio_isOn(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_radio_isOn],NULL);
    if (result == NULL) {
       printf("[CRITICAL] leds_radio_isOn() returned NULL\r\n");
@@ -218,61 +111,13 @@ uint8_t leds_radio_isOn(OpenMote* self) {
 
 // green
 void leds_sync_on(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_sync_on()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_sync_on],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_sync_on() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_sync_on);
 }
 void leds_sync_off(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_sync_off()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_sync_off],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_sync_off() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_sync_off);
 }
 void leds_sync_toggle(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_sync_toggle()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_sync_toggle],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_sync_toggle() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_sync_toggle);
 }
 uint8_t leds_sync_isOn(OpenMote* self) {
    PyObject*  result;
@@ -283,6 +128,7 @@ uint8_t leds_sync_isOn(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_sync_isOn],NULL);
    if (result == NULL) {
       printf("[CRITICAL] leds_sync_isOn() returned NULL\r\n");
@@ -300,61 +146,13 @@ uint8_t leds_sync_isOn(OpenMote* self) {
 
 // yellow
 void leds_debug_on(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_debug_on()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_debug_on],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_debug_on() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_debug_on);
 }
 void leds_debug_off(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_debug_off()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_debug_off],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_debug_off() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_debug_off);
 }
 void leds_debug_toggle(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_debug_toggle()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_debug_toggle],NULL);
-    if (result == NULL) {
-      printf("[CRITICAL] leds_debug_toggle() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_debug_toggle);
 }
 uint8_t leds_debug_isOn(OpenMote* self) {
    PyObject*  result;
@@ -365,6 +163,7 @@ uint8_t leds_debug_isOn(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_debug_isOn],NULL);
    if (result == NULL) {
       printf("[CRITICAL] leds_debug_isOn() returned NULL\r\n");
@@ -381,94 +180,43 @@ uint8_t leds_debug_isOn(OpenMote* self) {
 }
 
 void leds_all_on(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_all_on()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_all_on],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_all_on() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_all_on);
 }
 void leds_all_off(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_all_off()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_all_off],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_all_off() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_all_off);
 }
 void leds_all_toggle(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_all_toggle()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_all_toggle],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_all_toggle() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_all_toggle);
 }
 
 void leds_circular_shift(OpenMote* self) {
-   PyObject*   result;
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: leds_circular_shift()... \n",self);
-#endif
-   
-   // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_circular_shift],NULL);
-   if (result == NULL) {
-      printf("[CRITICAL] leds_circular_shift() returned NULL\r\n");
-      return;
-   }
-   Py_DECREF(result);
-   
-#ifdef TRACE_ON
-   printf("C@0x%x: ...done.\n",self);
-#endif
+   leds_forward(self,MOTE_NOTIF_leds_circular_shift);
 }
 
 void leds_increment(OpenMote* self) {
+   leds_forward(self,MOTE_NOTIF_leds_increment);
+}
+
+//=========================== private =========================================
+
+/**
+\brief Notify Python of an LED change, batched when possible.
+*/
+static void leds_forward(OpenMote* self, uint8_t notifId) {
    PyObject*   result;
    
 #ifdef TRACE_ON
-   printf("C@0x%x: leds_increment()... \n",self);
+   printf("C@0x%x: leds_forward(notifId=%d)... \n",self,notifId);
 #endif
    
+   if (events_push(self,notifId,NULL,0)==TRUE) {
+      return;
+   }
+   
    // forward to Python
-   result     = PyObject_CallObject(self->callback[MOTE_NOTIF_leds_increment],NULL);
+   result     = PyObject_CallObject(self->callback[notifId],NULL);
    if (result == NULL) {
-      printf("[CRITICAL] leds_increment() returned NULL\r\n");
+      printf("[CRITICAL] leds_forward(%d) returned NULL\r\n",notifId);
       return;
    }
    Py_DECREF(result);
@@ -477,5 +225,3 @@ void leds_increment(OpenMote* self) {
    printf("C@0x%x: ...done.\n",self);
 #endif
 }
-
-//=========================== private =========================================
\ No newline at end of file
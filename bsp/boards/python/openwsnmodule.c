@@ -205,6 +205,9 @@ static PyObject* OpenMote_bsp_timer_isr(OpenMote* self) {
    // call the callback
    bsp_timer_isr(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -228,6 +231,9 @@ static PyObject* OpenMote_radio_isr_startFrame(OpenMote* self, PyObject* args) {
       (uint16_t)capturedTime
    );
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -251,6 +257,9 @@ static PyObject* OpenMote_radio_isr_endFrame(OpenMote* self, PyObject* args) {
       (uint16_t)capturedTime
    );
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -262,6 +271,9 @@ static PyObject* OpenMote_radiotimer_isr_compare(OpenMote* self) {
    // call the callback
    radiotimer_intr_compare(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -273,6 +285,9 @@ static PyObject* OpenMote_radiotimer_isr_overflow(OpenMote* self) {
    // call the callback
    radiotimer_intr_overflow(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -284,6 +299,9 @@ static PyObject* OpenMote_uart_isr_tx(OpenMote* self) {
    // call the callback
    uart_intr_tx(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -295,6 +313,9 @@ static PyObject* OpenMote_uart_isr_rx(OpenMote* self) {
    // call the callback
    uart_intr_rx(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -306,6 +327,9 @@ static PyObject* OpenMote_supply_on(OpenMote* self) {
    // call the callback
    supply_on(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
@@ -317,6 +341,9 @@ static PyObject* OpenMote_supply_off(OpenMote* self) {
    // call the callback
    supply_off(self);
    
+   // hand the notifications batched meanwhile to Python
+   events_flush(self);
+   
    // return successfully
    Py_RETURN_NONE;
 }
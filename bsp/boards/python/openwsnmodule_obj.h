@@ -21,13 +21,18 @@
 #include "processIE_obj.h"
 #include "sixtop_obj.h"
 #include "schedule_obj.h"
+#include "iphc_obj.h"
+#include "frag_obj.h"
+#include "forwarding_obj.h"
 #include "icmpv6echo_obj.h"
 #include "icmpv6rpl_obj.h"
+#include "sourceroute_obj.h"
 #include "opencoap_obj.h"
 #include "opentcp_obj.h"
 #include "idmanager_obj.h"
 #include "openqueue_obj.h"
 #include "openrandom_obj.h"
+#include "packetfunctions_obj.h"
 // applications
 #include "c6t_obj.h"
 #include "cexample_obj.h"
@@ -60,6 +65,10 @@ void uart_writeBufferByLen_FASTSIM(OpenMote* self, uint8_t* buffer, uint8_t len)
 void supply_on(OpenMote* self);
 void supply_off(OpenMote* self);
 
+// events
+bool events_push(OpenMote* self, uint8_t notifId, uint8_t* data, uint8_t len);
+void events_flush(OpenMote* self);
+
 //=========================== enums ===========================================
 
 // notifications sent from the C mote to the Python BSP
@@ -163,6 +172,8 @@ enum {
    MOTE_NOTIF_uart_writeCircularBuffer_FASTSIM,
    MOTE_NOTIF_uart_writeBufferByLen_FASTSIM,
    MOTE_NOTIF_uart_readByte,
+   // events
+   MOTE_NOTIF_events,
    // last
    MOTE_NOTIF_LAST
 };
@@ -197,6 +208,18 @@ typedef struct {
    radiotimer_compare_cbt    compare_cb;
 } radiotimer_icb_t;
 
+#define MOTE_EVENTS_SIZE     1024 // bytes of notifications held between two flushes
+
+/**
+\brief Notifications waiting to be handed to Python in a single call.
+
+Each record is [notifId (1B)][length (1B)][payload (length B)].
+*/
+typedef struct {
+   uint8_t         buf[MOTE_EVENTS_SIZE];
+   uint16_t        len;
+} events_vars_t;
+
 //=========================== struct ==========================================
 
 /**
@@ -211,6 +234,8 @@ struct OpenMote {
    bsp_timer_icb_t      bsp_timer_icb;
    radio_icb_t          radio_icb;
    radiotimer_icb_t     radiotimer_icb;
+   //===== notifications batched to Python
+   events_vars_t        events_vars;
    //===== openstack
    // l4
    icmpv6echo_vars_t    icmpv6echo_vars;
@@ -218,6 +243,10 @@ struct OpenMote {
    opencoap_vars_t      opencoap_vars;
    tcp_vars_t           tcp_vars;
    // l3
+   iphc_vars_t          iphc_vars;
+   frag_vars_t          frag_vars;
+   forwarding_vars_t    forwarding_vars;
+   sourceroute_vars_t   sourceroute_vars;
    // l2b
    sixtop_vars_t        sixtop_vars;
    neighbors_vars_t     neighbors_vars;
@@ -228,9 +257,11 @@ struct OpenMote {
    ieee154e_vars_t      ieee154e_vars;
    ieee154e_stats_t     ieee154e_stats;
    ieee154e_dbg_t       ieee154e_dbg;
+   ieee154e_profile_t   ieee154e_profile;
    // cross-layer
    idmanager_vars_t     idmanager_vars;
    openqueue_vars_t     openqueue_vars;
+   packetfunctions_vars_t packetfunctions_vars;
    // drivers
    opentimers_vars_t    opentimers_vars;
    random_vars_t        random_vars;
@@ -78,6 +78,7 @@ void radio_init(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_init() returned NULL\r\n");
@@ -100,6 +101,7 @@ void radio_reset(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_reset],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_reset() returned NULL\r\n");
@@ -123,6 +125,7 @@ void radio_startTimer(OpenMote* self, PORT_TIMER_WIDTH period) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",period);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_startTimer],arglist);
    if (result == NULL) {
@@ -146,6 +149,7 @@ PORT_TIMER_WIDTH radio_getTimerValue(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_getTimerValue],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_getTimerValue() returned NULL\r\n");
@@ -176,6 +180,7 @@ void radio_setTimerPeriod(OpenMote* self, PORT_TIMER_WIDTH period) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",period);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_setTimerPeriod],arglist);
    if (result == NULL) {
@@ -199,6 +204,7 @@ PORT_TIMER_WIDTH radio_getTimerPeriod(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_getTimerPeriod],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_getTimerPeriod() returned NULL\r\n");
@@ -231,6 +237,7 @@ void radio_setFrequency(OpenMote* self, uint8_t frequency) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",frequency);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_setFrequency],arglist);
    if (result == NULL) {
@@ -253,6 +260,7 @@ void radio_rfOn(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_rfOn],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_rfOn() returned NULL\r\n");
@@ -273,6 +281,7 @@ void radio_rfOff(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_rfOff],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_rfOff() returned NULL\r\n");
@@ -299,6 +308,10 @@ void radio_loadPacket(OpenMote* self, uint8_t* packet, uint8_t len) {
    printf("C@0x%x: radio_loadPacket(len=%d)... \n",self,len);
 #endif
    
+   if (events_push(self,MOTE_NOTIF_radio_loadPacket,packet,len)==TRUE) {
+      return;
+   }
+   
    // forward to Python
    pkt        = PyList_New(len);
    for (i=0;i<len;i++) {
@@ -328,6 +341,7 @@ void radio_txEnable(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_txEnable],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_txEnable() returned NULL\r\n");
@@ -348,6 +362,7 @@ void radio_txNow(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_txNow],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_txNow() returned NULL\r\n");
@@ -370,6 +385,7 @@ void radio_rxEnable(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_rxEnable],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_rxEnable() returned NULL\r\n");
@@ -390,6 +406,7 @@ void radio_rxNow(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_rxNow],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_rxNow() returned NULL\r\n");
@@ -420,6 +437,7 @@ void radio_getReceivedFrame(OpenMote* self,
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radio_getReceivedFrame],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radio_getReceivedFrame() returned NULL\r\n");
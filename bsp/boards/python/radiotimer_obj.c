@@ -50,6 +50,7 @@ void radiotimer_init(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_init() returned NULL\r\n");
@@ -70,6 +71,7 @@ void radiotimer_start(OpenMote* self, PORT_RADIOTIMER_WIDTH period) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_start],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_start() returned NULL\r\n");
@@ -93,6 +95,7 @@ PORT_RADIOTIMER_WIDTH radiotimer_getValue(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_getValue],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_getValue() returned NULL\r\n");
@@ -123,6 +126,7 @@ void radiotimer_setPeriod(OpenMote* self, PORT_RADIOTIMER_WIDTH period) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",period);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_setPeriod],arglist);
    if (result == NULL) {
@@ -146,6 +150,7 @@ PORT_RADIOTIMER_WIDTH radiotimer_getPeriod(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_getPeriod],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_getPeriod() returned NULL\r\n");
@@ -178,6 +183,7 @@ void radiotimer_schedule(OpenMote* self, PORT_RADIOTIMER_WIDTH offset) {
 #endif
    
    // forward to Python
+   events_flush(self);
    arglist    = Py_BuildValue("(i)",offset);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_schedule],arglist);
    if (result == NULL) {
@@ -200,6 +206,7 @@ void radiotimer_cancel(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_cancel],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_cancel() returned NULL\r\n");
@@ -223,6 +230,7 @@ PORT_RADIOTIMER_WIDTH radiotimer_getCapturedTime(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_radiotimer_getCapturedTime],NULL);
    if (result == NULL) {
       printf("[CRITICAL] radiotimer_getCapturedTime() returned NULL\r\n");
@@ -38,6 +38,7 @@ void uart_init(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_init],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_init() returned NULL\r\n");
@@ -58,6 +59,7 @@ void uart_enableInterrupts(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_enableInterrupts],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_enableInterrupts() returned NULL\r\n");
@@ -78,6 +80,7 @@ void uart_disableInterrupts(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_disableInterrupts],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_disableInterrupts() returned NULL\r\n");
@@ -98,6 +101,7 @@ void uart_clearRxInterrupts(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_clearRxInterrupts],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_clearRxInterrupts() returned NULL\r\n");
@@ -118,6 +122,7 @@ void uart_clearTxInterrupts(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_clearTxInterrupts],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_clearTxInterrupts() returned NULL\r\n");
@@ -143,6 +148,10 @@ void uart_writeByte(OpenMote* self, uint8_t byteToWrite) {
    printf("C@0x%x: uart_writeByte()... \n",self);
 #endif
    
+   if (events_push(self,MOTE_NOTIF_uart_writeByte,&byteToWrite,1)==TRUE) {
+      return;
+   }
+   
    // forward to Python
    arglist    = Py_BuildValue("(i)",byteToWrite);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_writeByte],arglist);
@@ -178,6 +187,7 @@ void uart_writeCircularBuffer_FASTSIM(OpenMote* self, uint8_t* buffer, uint8_t*
 #endif
    
    // forward to Python
+   events_flush(self);
    len        = (*outputBufIdxW)-(*outputBufIdxR);
    frame      = PyList_New(len);
    i = 0;
@@ -226,6 +236,10 @@ void uart_writeBufferByLen_FASTSIM(OpenMote* self, uint8_t* buffer, uint8_t len)
    );
 #endif
    
+   if (events_push(self,MOTE_NOTIF_uart_writeBufferByLen_FASTSIM,buffer,len)==TRUE) {
+      return;
+   }
+   
    // forward to Python
    frame      = PyList_New(len);
    if (frame==NULL) {
@@ -264,6 +278,7 @@ uint8_t uart_readByte(OpenMote* self) {
 #endif
    
    // forward to Python
+   events_flush(self);
    result     = PyObject_CallObject(self->callback[MOTE_NOTIF_uart_readByte],NULL);
    if (result == NULL) {
       printf("[CRITICAL] uart_readByte() returned NULL\r\n");
@@ -38,8 +38,13 @@ void    uart_disableInterrupts(void);
 void    uart_clearRxInterrupts(void);
 void    uart_clearTxInterrupts(void);
 void    uart_writeByte(uint8_t byteToWrite);
+#ifdef PORT_UART_WRITEBUFFER
+// block write, e.g. by DMA; the tx callback fires once the whole block is sent
+void    uart_writeBuffer(uint8_t* buffer, uint16_t length);
+#endif
 #ifdef FASTSIM
 void    uart_writeCircularBuffer_FASTSIM(uint8_t* buffer, uint8_t* outputBufIdxR, uint8_t* outputBufIdxW);
+void    uart_writeBufferByLen_FASTSIM(uint8_t* buffer, uint8_t len);
 #endif
 uint8_t uart_readByte(void);
 
@@ -17,4 +17,26 @@ uint16_t crcIteration(uint16_t crc, uint8_t byte) {
    return (crc >> 8) ^ fcstab[(crc ^ byte) & 0xff];
 }
 
+/**
+\brief Run the HDLC CRC over a whole buffer.
+
+Same result as calling crcIteration() on each byte, without a call per byte.
+*/
+uint16_t crcBuffer(uint16_t crc, uint8_t* buffer, uint8_t length) {
+   // four bytes per iteration
+   while (length>=4) {
+      crc = (crc >> 8) ^ fcstab[(crc ^ buffer[0]) & 0xff];
+      crc = (crc >> 8) ^ fcstab[(crc ^ buffer[1]) & 0xff];
+      crc = (crc >> 8) ^ fcstab[(crc ^ buffer[2]) & 0xff];
+      crc = (crc >> 8) ^ fcstab[(crc ^ buffer[3]) & 0xff];
+      buffer += 4;
+      length -= 4;
+   }
+   while (length>0) {
+      crc = (crc >> 8) ^ fcstab[(crc ^ *buffer++) & 0xff];
+      length--;
+   }
+   return crc;
+}
+
 //=========================== private =========================================
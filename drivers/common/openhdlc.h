@@ -66,6 +66,7 @@ static const uint16_t fcstab[256] = {
 //=========================== prototypes ======================================
 
 uint16_t crcIteration(uint16_t crc, uint8_t byte);
+uint16_t crcBuffer(uint16_t crc, uint8_t* buffer, uint8_t length);
 
 /**
 \}
@@ -20,6 +20,8 @@
 #include "openhdlc.h"
 #include "schedule.h"
 #include "icmpv6rpl.h"
+#include "frag.h"
+#include "iphc.h"
 
 //=========================== variables =======================================
 
@@ -45,10 +47,30 @@ void openserial_board_reset_cb(
 
 void openserial_goldenImageCommands(void);
 
+// status
+bool printStatusElement(uint8_t statusElement);
+
 // HDLC output
-void outputHdlcOpen(void);
+void outputHdlcOpen(uint8_t outputClass);
 void outputHdlcWrite(uint8_t b);
-void outputHdlcClose(void);
+void outputHdlcWriteBuffer(uint8_t* buffer, uint8_t length);
+owerror_t outputHdlcClose(void);
+void outputWrite(uint8_t b);
+void outputWriteBuffer(uint8_t* buffer, uint8_t length);
+void outputBatchOpen(uint8_t outputClass, uint16_t length);
+owerror_t outputBatchClose(void);
+#ifdef OPENSERIAL_BATCH
+bool outputBatchCanExtend(uint8_t outputClass, uint16_t length);
+#endif
+// output queues
+uint8_t outputGetTxClass(void);
+void outputTxNext(void);
+#ifdef PORT_UART_WRITEBUFFER
+void outputTxBlockDone(void);
+#endif
+#ifdef FASTSIM
+void outputFlush_FASTSIM(void);
+#endif
 // HDLC input
 void inputHdlcOpen(void);
 void inputHdlcWrite(uint8_t b);
@@ -66,6 +88,13 @@ void openserial_init() {
    openserial_vars.mode                = MODE_OFF;
    openserial_vars.debugPrintCounter   = 0;
    
+   // status
+   memset(openserial_vars.statusPeriod,SERIAL_STATUS_PERIOD,sizeof(openserial_vars.statusPeriod));
+   openserial_vars.statusPeriod[STATUS_OUTBUFFERINDEXES] = SERIAL_STATUS_PERIOD_VOLATILE;
+   openserial_vars.statusPeriod[STATUS_ASN]              = SERIAL_STATUS_PERIOD_VOLATILE;
+   openserial_vars.statusPeriod[STATUS_MACSTATS]         = SERIAL_STATUS_PERIOD_VOLATILE;
+   openserial_vars.statusPeriod[STATUS_MACPROFILE]       = SERIAL_STATUS_PERIOD_VOLATILE;
+   
    // input
    openserial_vars.reqFrame[0]         = HDLC_FLAG;
    openserial_vars.reqFrame[1]         = SERFRAME_MOTE2PC_REQUEST;
@@ -82,9 +111,14 @@ void openserial_init() {
    openserial_vars.inputBufFill        = 0;
    
    // ouput
-   openserial_vars.outputBufFilled     = FALSE;
-   openserial_vars.outputBufIdxR       = 0;
-   openserial_vars.outputBufIdxW       = 0;
+   openserial_vars.outputQueue[OUTPUT_DATA].buf     = openserial_vars.outputBufData;
+   openserial_vars.outputQueue[OUTPUT_DATA].size    = SERIAL_OUTPUT_DATA_SIZE;
+   openserial_vars.outputQueue[OUTPUT_ERROR].buf    = openserial_vars.outputBufError;
+   openserial_vars.outputQueue[OUTPUT_ERROR].size   = SERIAL_OUTPUT_ERROR_SIZE;
+   openserial_vars.outputQueue[OUTPUT_STATUS].buf   = openserial_vars.outputBufStatus;
+   openserial_vars.outputQueue[OUTPUT_STATUS].size  = SERIAL_OUTPUT_STATUS_SIZE;
+   openserial_vars.outputTxInFrame     = FALSE;
+   openserial_vars.outputTxLength      = 0;
    
    // set callbacks
    uart_setCallbacks(isr_openserial_tx,
@@ -92,23 +126,90 @@ void openserial_init() {
 }
 
 owerror_t openserial_printStatus(uint8_t statusElement,uint8_t* buffer, uint8_t length) {
-   uint8_t i;
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
+   outputBatchOpen(OUTPUT_STATUS,1+2+1+length);
    outputHdlcWrite(SERFRAME_MOTE2PC_STATUS);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
    outputHdlcWrite(statusElement);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
-   outputHdlcClose();
+   outputHdlcWriteBuffer(buffer,length);
+   outcome = outputBatchClose();
    ENABLE_INTERRUPTS();
    
-   return E_SUCCESS;
+   return outcome;
+}
+
+/**
+\brief Print a status element, only if it changed since it was last printed.
+
+\returns TRUE if the element was printed, FALSE if it did not change or could
+   not be queued.
+*/
+bool openserial_printStatusOnChange(uint8_t statusElement, uint8_t* buffer, uint8_t length) {
+   return openserial_printStatusRowOnChange(
+      statusElement,
+      buffer,
+      length,
+      &openserial_vars.statusDigest[statusElement]
+   );
+}
+
+/**
+\brief Print one row of a status table, only if it changed since it was last
+   printed.
+
+The caller keeps a digest per row, which is only updated once the row is
+queued, so rows lost to a full output queue are printed again.
+
+\param[in]     statusElement The status element the row belongs to.
+\param[in]     buffer        The row, as printed.
+\param[in]     length        The length of the row.
+\param[in,out] lastDigest    The digest of the row when it was last printed.
+
+\returns TRUE if the row was printed, FALSE if it did not change or could not
+   be queued.
+*/
+bool openserial_printStatusRowOnChange(
+      uint8_t   statusElement,
+      uint8_t*  buffer,
+      uint8_t   length,
+      uint16_t* lastDigest
+   ) {
+   uint16_t digest;
+   
+   digest = HDLC_CRCINIT;
+   digest = crcIteration(digest,openserial_vars.statusEpoch);
+   digest = crcBuffer(digest,buffer,length);
+   if (digest==*lastDigest) {
+      return FALSE;
+   }
+   if (openserial_printStatus(statusElement,buffer,length)!=E_SUCCESS) {
+      return FALSE;
+   }
+   *lastDigest = digest;
+   return TRUE;
+}
+
+/**
+\brief Set the number of serial output phases between two reports of a status
+   element.
+
+\param[in] statusElement The status element.
+\param[in] period        The number of output phases, 0 to stop reporting it.
+*/
+void openserial_setStatusPeriod(uint8_t statusElement, uint8_t period) {
+   INTERRUPT_DECLARATION();
+   
+   if (statusElement>=STATUS_MAX) {
+      return;
+   }
+   DISABLE_INTERRUPTS();
+   openserial_vars.statusPeriod[statusElement]    = period;
+   openserial_vars.statusCountdown[statusElement] = 0;
+   ENABLE_INTERRUPTS();
 }
 
 owerror_t openserial_printInfoErrorCritical(
@@ -118,11 +219,11 @@ owerror_t openserial_printInfoErrorCritical(
       errorparameter_t arg1,
       errorparameter_t arg2
    ) {
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
+   outputBatchOpen(OUTPUT_ERROR,1+2+1+1+2+2);
    outputHdlcWrite(severity);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
@@ -132,59 +233,49 @@ owerror_t openserial_printInfoErrorCritical(
    outputHdlcWrite((uint8_t) (arg1 & 0x00ff));
    outputHdlcWrite((uint8_t)((arg2 & 0xff00)>>8));
    outputHdlcWrite((uint8_t) (arg2 & 0x00ff));
-   outputHdlcClose();
+   outcome = outputBatchClose();
    ENABLE_INTERRUPTS();
    
-   return E_SUCCESS;
+   return outcome;
 }
 
 owerror_t openserial_printData(uint8_t* buffer, uint8_t length) {
-   uint8_t  i;
    uint8_t  asn[5];
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
    // retrieve ASN
    ieee154e_getAsn(asn);// byte01,byte23,byte4
    
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
+   outputHdlcOpen(OUTPUT_DATA);
    outputHdlcWrite(SERFRAME_MOTE2PC_DATA);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   outputHdlcWrite(asn[0]);
-   outputHdlcWrite(asn[1]);
-   outputHdlcWrite(asn[2]);
-   outputHdlcWrite(asn[3]);
-   outputHdlcWrite(asn[4]);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
-   outputHdlcClose();
+   outputHdlcWriteBuffer(asn,sizeof(asn));
+   outputHdlcWriteBuffer(buffer,length);
+   outcome = outputHdlcClose();
    ENABLE_INTERRUPTS();
    
-   return E_SUCCESS;
+   return outcome;
 }
 
 owerror_t openserial_printPacket(uint8_t* buffer, uint8_t length, uint8_t channel) {
-   uint8_t  i;
+   owerror_t outcome;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
-   openserial_vars.outputBufFilled  = TRUE;
-   outputHdlcOpen();
+   outputHdlcOpen(OUTPUT_DATA);
    outputHdlcWrite(SERFRAME_MOTE2PC_SNIFFED_PACKET);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[1]);
    outputHdlcWrite(idmanager_getMyID(ADDR_16B)->addr_16b[0]);
-   for (i=0;i<length;i++){
-      outputHdlcWrite(buffer[i]);
-   }
+   outputHdlcWriteBuffer(buffer,length);
    outputHdlcWrite(channel);
-   outputHdlcClose();
+   outcome = outputHdlcClose();
    
    ENABLE_INTERRUPTS();
    
-   return E_SUCCESS;
+   return outcome;
 }
 
 owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
@@ -306,63 +397,41 @@ void openserial_startInput() {
 void openserial_startOutput() {
    //schedule a task to get new status in the output buffer
    uint8_t debugPrintCounter;
+   uint8_t statusElement;
+   uint8_t i;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
-   openserial_vars.debugPrintCounter = (openserial_vars.debugPrintCounter+1)%STATUS_MAX;
    debugPrintCounter = openserial_vars.debugPrintCounter;
+   for (i=0;i<STATUS_MAX;i++) {
+      if (openserial_vars.statusCountdown[i]>0) {
+         openserial_vars.statusCountdown[i]--;
+      }
+   }
+   // changing the epoch changes all digests, so everything is printed again
+   openserial_vars.statusRefreshCounter++;
+   if (openserial_vars.statusRefreshCounter>=SERIAL_STATUS_REFRESH) {
+      openserial_vars.statusRefreshCounter = 0;
+      openserial_vars.statusEpoch++;
+   }
    ENABLE_INTERRUPTS();
    
-   // print debug information
-   switch (debugPrintCounter) {
-      case STATUS_ISSYNC:
-         if (debugPrint_isSync()==TRUE) {
-            break;
-         }
-      case STATUS_ID:
-         if (debugPrint_id()==TRUE) {
-            break;
-         }
-      case STATUS_DAGRANK:
-         if (debugPrint_myDAGrank()==TRUE) {
-            break;
-         }
-      case STATUS_OUTBUFFERINDEXES:
-         if (debugPrint_outBufferIndexes()==TRUE) {
-            break;
-         }
-      case STATUS_ASN:
-         if (debugPrint_asn()==TRUE) {
-            break;
-         }
-      case STATUS_MACSTATS:
-         if (debugPrint_macStats()==TRUE) {
-            break;
-         }
-      case STATUS_SCHEDULE:
-         if(debugPrint_schedule()==TRUE) {
-            break;
-         }
-      case STATUS_BACKOFF:
-         if(debugPrint_backoff()==TRUE) {
-            break;
-         }
-      case STATUS_QUEUE:
-         if(debugPrint_queue()==TRUE) {
-            break;
-         }
-      case STATUS_NEIGHBORS:
-         if (debugPrint_neighbors()==TRUE) {
-            break;
-         }
-      case STATUS_KAPERIOD:
-         if (debugPrint_kaPeriod()==TRUE) {
-            break;
-         }
-      default:
+   // print the next status element which is due and changed, in turn
+   for (i=1;i<=STATUS_MAX;i++) {
+      statusElement = (debugPrintCounter+i)%STATUS_MAX;
+      if (
+            openserial_vars.statusPeriod[statusElement]==0 ||
+            openserial_vars.statusCountdown[statusElement]>0
+         ) {
+         continue;
+      }
+      openserial_vars.statusCountdown[statusElement] = openserial_vars.statusPeriod[statusElement];
+      if (printStatusElement(statusElement)==TRUE) {
          DISABLE_INTERRUPTS();
-         openserial_vars.debugPrintCounter=0;
+         openserial_vars.debugPrintCounter = statusElement;
          ENABLE_INTERRUPTS();
+         break;
+      }
    }
    
    // flush buffer
@@ -371,15 +440,13 @@ void openserial_startOutput() {
    uart_enableInterrupts();           // Enable USCI_A1 TX & RX interrupt
    DISABLE_INTERRUPTS();
    openserial_vars.mode=MODE_OUTPUT;
-   if (openserial_vars.outputBufFilled) {
+   if (openserial_vars.outputTxLength>0) {
+      // the block being sent continues with the next ones when done
+   } else if (outputGetTxClass()!=OUTPUT_MAX) {
 #ifdef FASTSIM
-      uart_writeCircularBuffer_FASTSIM(
-         openserial_vars.outputBuf,
-         &openserial_vars.outputBufIdxR,
-         &openserial_vars.outputBufIdxW
-      );
+      outputFlush_FASTSIM();
 #else
-      uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
+      outputTxNext();
 #endif
    } else {
       openserial_stop();
@@ -431,6 +498,9 @@ void openserial_stop() {
              // golden image command
             openserial_goldenImageCommands();
             break;
+         case SERFRAME_PC2MOTE_SETCONTEXT:
+            iphc_triggerSetContext();
+            break;
          default:
             openserial_printError(COMPONENT_OPENSERIAL,ERR_UNSUPPORTED_COMMAND,
                                   (errorparameter_t)cmdByte,
@@ -601,6 +671,12 @@ void openserial_goldenImageCommands(void){
        case COMMAND_SET_SLOTDURATION:
             ieee154e_setSlotDuration(comandParam_16);
             break;
+       case COMMAND_SET_STATUSPERIOD: // status element (1B), period (1B)
+            openserial_setStatusPeriod(
+                (uint8_t)(comandParam_16 & 0x00ff),
+                (uint8_t)((comandParam_16>>8) & 0x00ff)
+            );
+            break;
        case COMMAND_SET_6PRESPONSE_STATUS:
             if (comandParam_8 ==1) {
                sixtop_setIsResponseEnabled(TRUE);
@@ -631,26 +707,92 @@ bool debugPrint_outBufferIndexes() {
    uint16_t temp_buffer[2];
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
-   temp_buffer[0] = openserial_vars.outputBufIdxW;
-   temp_buffer[1] = openserial_vars.outputBufIdxR;
+   // indexes of the data queue
+   temp_buffer[0] = openserial_vars.outputQueue[OUTPUT_DATA].idxW;
+   temp_buffer[1] = openserial_vars.outputQueue[OUTPUT_DATA].idxR;
    ENABLE_INTERRUPTS();
-   openserial_printStatus(STATUS_OUTBUFFERINDEXES,(uint8_t*)temp_buffer,sizeof(temp_buffer));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_OUTBUFFERINDEXES,(uint8_t*)temp_buffer,sizeof(temp_buffer));
+}
+
+/**
+\brief Print the number of frames dropped in each output queue, over serial.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_serialDrops() {
+   uint16_t temp_buffer[OUTPUT_MAX];
+   uint8_t  i;
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   for (i=0;i<OUTPUT_MAX;i++) {
+      temp_buffer[i] = openserial_vars.outputQueue[i].numDropped;
+   }
+   ENABLE_INTERRUPTS();
+   return openserial_printStatusOnChange(STATUS_SERIALDROPS,(uint8_t*)temp_buffer,sizeof(temp_buffer));
 }
 
 //=========================== private =========================================
 
+//===== status
+
+/**
+\brief Have the module owning a status element print it.
+
+\returns TRUE if something was printed, FALSE otherwise.
+*/
+bool printStatusElement(uint8_t statusElement) {
+   switch (statusElement) {
+      case STATUS_ISSYNC:
+         return debugPrint_isSync();
+      case STATUS_ID:
+         return debugPrint_id();
+      case STATUS_DAGRANK:
+         return debugPrint_myDAGrank();
+      case STATUS_OUTBUFFERINDEXES:
+         return debugPrint_outBufferIndexes();
+      case STATUS_ASN:
+         return debugPrint_asn();
+      case STATUS_MACSTATS:
+         return debugPrint_macStats();
+      case STATUS_SCHEDULE:
+         return debugPrint_schedule();
+      case STATUS_BACKOFF:
+         return debugPrint_backoff();
+      case STATUS_QUEUE:
+         return debugPrint_queue();
+      case STATUS_NEIGHBORS:
+         return debugPrint_neighbors();
+      case STATUS_KAPERIOD:
+         return debugPrint_kaPeriod();
+      case STATUS_MACPROFILE:
+         return debugPrint_macProfile();
+      case STATUS_FRAG:
+         return debugPrint_frag();
+      case STATUS_SERIALDROPS:
+         return debugPrint_serialDrops();
+      default:
+         return FALSE;
+   }
+}
+
 //===== hdlc (output)
 
 /**
-\brief Start an HDLC frame in the output buffer.
+\brief Start an HDLC frame in the output queue of the given class.
+
+The frame is written after the queue's write index, which only moves when the
+frame is closed, so a frame that does not fit is dropped as a whole.
 */
-port_INLINE void outputHdlcOpen() {
+port_INLINE void outputHdlcOpen(uint8_t outputClass) {
+   openserial_vars.outputWriteClass                   = outputClass;
+   openserial_vars.outputWriteIdx                     = openserial_vars.outputQueue[outputClass].idxW;
+   openserial_vars.outputWriteOverflow                = FALSE;
+   
    // initialize the value of the CRC
    openserial_vars.outputCrc                          = HDLC_CRCINIT;
    
    // write the opening HDLC flag
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]     = HDLC_FLAG;
+   outputWrite(HDLC_FLAG);
 }
 /**
 \brief Add a byte to the outgoing HDLC frame being built.
@@ -662,17 +804,52 @@ port_INLINE void outputHdlcWrite(uint8_t b) {
    
    // add byte to buffer
    if (b==HDLC_FLAG || b==HDLC_ESCAPE) {
-      openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]  = HDLC_ESCAPE;
+      outputWrite(HDLC_ESCAPE);
       b                                               = b^HDLC_ESCAPE_MASK;
    }
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]     = b;
+   outputWrite(b);
    
 }
 /**
+\brief Add a buffer to the outgoing HDLC frame being built.
+
+Same as calling outputHdlcWrite() on each byte, but the CRC is run over the
+whole buffer at once and the runs of bytes between those to escape are copied
+as blocks.
+*/
+port_INLINE void outputHdlcWriteBuffer(uint8_t* buffer, uint8_t length) {
+   uint8_t start;
+   uint8_t i;
+   
+   // iterate through CRC calculator
+   openserial_vars.outputCrc = crcBuffer(openserial_vars.outputCrc,buffer,length);
+   
+   i = 0;
+   while (i<length) {
+      // copy the run up to the next byte to escape
+      start = i;
+      while (i<length && buffer[i]!=HDLC_FLAG && buffer[i]!=HDLC_ESCAPE) {
+         i++;
+      }
+      outputWriteBuffer(&buffer[start],i-start);
+      
+      // escape that byte
+      if (i<length) {
+         outputWrite(HDLC_ESCAPE);
+         outputWrite(buffer[i]^HDLC_ESCAPE_MASK);
+         i++;
+      }
+   }
+}
+/**
 \brief Finalize the outgoing HDLC frame.
+
+\returns E_SUCCESS if the frame is queued, E_FAIL if it did not fit and was
+   dropped.
 */
-port_INLINE void outputHdlcClose() {
-   uint16_t   finalCrc;
+port_INLINE owerror_t outputHdlcClose() {
+   uint16_t                  finalCrc;
+   openserial_outputQueue_t* queue;
     
    // finalize the calculation of the CRC
    finalCrc   = ~openserial_vars.outputCrc;
@@ -682,9 +859,344 @@ port_INLINE void outputHdlcClose() {
    outputHdlcWrite((finalCrc>>8)&0xff);
    
    // write the closing HDLC flag
-   openserial_vars.outputBuf[openserial_vars.outputBufIdxW++]   = HDLC_FLAG;
+   outputWrite(HDLC_FLAG);
+   
+   queue = &openserial_vars.outputQueue[openserial_vars.outputWriteClass];
+   if (openserial_vars.outputWriteOverflow==TRUE) {
+      // drop the frame, the write index was never moved
+      if (queue->numDropped<0xffff) {
+         queue->numDropped++;
+      }
+      return E_FAIL;
+   }
+   
+   // commit the frame
+   queue->idxW = openserial_vars.outputWriteIdx;
+#ifdef OPENSERIAL_BATCH
+   queue->batchOpen = FALSE;
+#endif
+   return E_SUCCESS;
+}
+/**
+\brief Add a raw byte to the output queue of the frame being built.
+*/
+port_INLINE void outputWrite(uint8_t b) {
+   openserial_outputQueue_t* queue;
+   uint16_t                  next;
+   
+   if (openserial_vars.outputWriteOverflow==TRUE) {
+      return;
+   }
+   
+   queue = &openserial_vars.outputQueue[openserial_vars.outputWriteClass];
+   next  = openserial_vars.outputWriteIdx+1;
+   if (next==queue->size) {
+      next = 0;
+   }
+   if (next==queue->idxR) {
+      // queue full, one slot is always left free
+      openserial_vars.outputWriteOverflow = TRUE;
+      return;
+   }
+   queue->buf[openserial_vars.outputWriteIdx] = b;
+   openserial_vars.outputWriteIdx             = next;
+}
+/**
+\brief Add raw bytes to the output queue of the frame being built.
+*/
+port_INLINE void outputWriteBuffer(uint8_t* buffer, uint8_t length) {
+   openserial_outputQueue_t* queue;
+   uint16_t                  room;
+   uint16_t                  chunk;
+   
+   if (openserial_vars.outputWriteOverflow==TRUE || length==0) {
+      return;
+   }
+   
+   // one slot is always left free
+   queue = &openserial_vars.outputQueue[openserial_vars.outputWriteClass];
+   if (queue->idxR>openserial_vars.outputWriteIdx) {
+      room = queue->idxR-openserial_vars.outputWriteIdx-1;
+   } else {
+      room = queue->size-openserial_vars.outputWriteIdx+queue->idxR-1;
+   }
+   if (length>room) {
+      openserial_vars.outputWriteOverflow = TRUE;
+      return;
+   }
+   
+   // copy up to the end of the ring, then the rest from its start
+   chunk = queue->size-openserial_vars.outputWriteIdx;
+   if (chunk>length) {
+      chunk = length;
+   }
+   memcpy(&queue->buf[openserial_vars.outputWriteIdx],buffer,chunk);
+   memcpy(&queue->buf[0],&buffer[chunk],length-chunk);
+   openserial_vars.outputWriteIdx += length;
+   if (openserial_vars.outputWriteIdx>=queue->size) {
+      openserial_vars.outputWriteIdx -= queue->size;
+   }
+}
+
+//===== batches
+
+/**
+\brief Start a message which may share its HDLC frame with others.
+
+With OPENSERIAL_BATCH, messages are carried in SERFRAME_MOTE2PC_BATCH frames,
+each preceded by its length. A message is appended to the last frame of its
+queue if that frame is a batch which has not started being sent yet, and both
+fit; otherwise a new batch frame is started. Without OPENSERIAL_BATCH, each
+message gets its own frame.
+
+\param[in] outputClass The output queue.
+\param[in] length      The length of the message, including its type byte.
+*/
+port_INLINE void outputBatchOpen(uint8_t outputClass, uint16_t length) {
+#ifdef OPENSERIAL_BATCH
+   openserial_outputQueue_t* queue;
+   
+   queue = &openserial_vars.outputQueue[outputClass];
+   if (length>SERIAL_BATCH_MAXLEN-2) {
+      // too long to be batched
+      outputHdlcOpen(outputClass);
+      openserial_vars.outputWriteBatch    = FALSE;
+      return;
+   }
+   openserial_vars.outputWriteBatch       = TRUE;
+   if (outputBatchCanExtend(outputClass,length)==TRUE) {
+      // reopen that frame, its CRC and closing flag get overwritten
+      openserial_vars.outputWriteClass    = outputClass;
+      openserial_vars.outputWriteIdx      = queue->batchEnd;
+      openserial_vars.outputWriteOverflow = FALSE;
+      openserial_vars.outputCrc           = queue->batchCrc;
+      openserial_vars.outputWriteStart    = queue->batchStart;
+      openserial_vars.outputWriteBatchLen = queue->batchLen;
+   } else {
+      openserial_vars.outputWriteStart    = queue->idxW;
+      outputHdlcOpen(outputClass);
+      outputHdlcWrite(SERFRAME_MOTE2PC_BATCH);
+      openserial_vars.outputWriteBatchLen = 1;
+   }
+   outputHdlcWrite((uint8_t)length);
+   openserial_vars.outputWriteBatchLen   += 1+length;
+#else
+   outputHdlcOpen(outputClass);
+#endif
+}
+/**
+\brief Finalize a message started with outputBatchOpen().
+
+\returns E_SUCCESS if the message is queued, E_FAIL if it was dropped.
+*/
+port_INLINE owerror_t outputBatchClose() {
+#ifdef OPENSERIAL_BATCH
+   openserial_outputQueue_t* queue;
+   uint16_t                  batchEnd;
+   uint16_t                  batchCrc;
+   
+   queue    = &openserial_vars.outputQueue[openserial_vars.outputWriteClass];
+   batchEnd = openserial_vars.outputWriteIdx;
+   batchCrc = openserial_vars.outputCrc;
+   if (outputHdlcClose()!=E_SUCCESS) {
+      return E_FAIL;
+   }
+   if (openserial_vars.outputWriteBatch==TRUE) {
+      // the frame may be extended by the next message
+      queue->batchOpen  = TRUE;
+      queue->batchStart = openserial_vars.outputWriteStart;
+      queue->batchEnd   = batchEnd;
+      queue->batchCrc   = batchCrc;
+      queue->batchLen   = openserial_vars.outputWriteBatchLen;
+   }
+   return E_SUCCESS;
+#else
+   return outputHdlcClose();
+#endif
 }
 
+#ifdef OPENSERIAL_BATCH
+/**
+\brief Whether a message can be appended to the last frame of a queue.
+
+\param[in] outputClass The output queue.
+\param[in] length      The length of the message, including its type byte.
+*/
+port_INLINE bool outputBatchCanExtend(uint8_t outputClass, uint16_t length) {
+   openserial_outputQueue_t* queue;
+   uint16_t                  idxR;
+   uint16_t                  room;
+   
+   queue = &openserial_vars.outputQueue[outputClass];
+   if (
+         queue->batchOpen==FALSE ||
+         queue->batchLen+1+length>SERIAL_BATCH_MAXLEN
+      ) {
+      return FALSE;
+   }
+   
+   // the frame must not have started being sent
+   idxR = queue->idxR;
+#ifdef PORT_UART_WRITEBUFFER
+   if (openserial_vars.outputTxLength>0 && openserial_vars.outputTxClass==outputClass) {
+      idxR += openserial_vars.outputTxLength;
+      if (idxR==queue->size) {
+         idxR = 0;
+      }
+   }
+#endif
+   if (
+         (queue->batchStart+queue->size-idxR)%queue->size >=
+         (queue->idxW+queue->size-idxR)%queue->size
+      ) {
+      return FALSE;
+   }
+   
+   // the frame is only extended if it can not fail half way: length and
+   // message all escaped, CRC escaped, closing flag
+   if (queue->idxR>queue->batchEnd) {
+      room = queue->idxR-queue->batchEnd-1;
+   } else {
+      room = queue->size-queue->batchEnd+queue->idxR-1;
+   }
+   if (room<2*(1+length)+2*2+1) {
+      return FALSE;
+   }
+   return TRUE;
+}
+#endif
+
+//===== output queues
+
+/**
+\brief Select the output queue to send from.
+
+A frame being sent is always finished first; otherwise the highest priority
+non-empty queue is picked.
+
+\returns the class of that queue, OUTPUT_MAX if all queues are empty.
+*/
+port_INLINE uint8_t outputGetTxClass() {
+   uint8_t c;
+   
+   if (openserial_vars.outputTxInFrame==TRUE) {
+      return openserial_vars.outputTxClass;
+   }
+   for (c=0;c<OUTPUT_MAX;c++) {
+      if (openserial_vars.outputQueue[c].idxR!=openserial_vars.outputQueue[c].idxW) {
+         return c;
+      }
+   }
+   return OUTPUT_MAX;
+}
+
+#ifdef PORT_UART_WRITEBUFFER
+
+/**
+\brief Hand the next contiguous block of the selected queue to the UART.
+
+The block runs up to the write index, or to the end of the ring if the queue
+wraps; it is only released from the queue when the UART is done with it.
+*/
+void outputTxNext() {
+   openserial_outputQueue_t* queue;
+   uint8_t                   c;
+   uint16_t                  length;
+   
+   c = outputGetTxClass();
+   if (c==OUTPUT_MAX) {
+      openserial_vars.outputTxInFrame = FALSE;
+      return;
+   }
+   queue = &openserial_vars.outputQueue[c];
+   if (queue->idxW>queue->idxR) {
+      length = queue->idxW-queue->idxR;
+   } else {
+      length = queue->size-queue->idxR;
+   }
+   
+   // blocks end on a frame boundary, unless the queue wraps
+   openserial_vars.outputTxClass   = c;
+   openserial_vars.outputTxInFrame = ((queue->idxR+length)%queue->size!=queue->idxW);
+   openserial_vars.outputTxLength  = length;
+   uart_writeBuffer(&queue->buf[queue->idxR],length);
+}
+
+/**
+\brief Release the block the UART just finished sending.
+*/
+port_INLINE void outputTxBlockDone() {
+   openserial_outputQueue_t* queue;
+   
+   queue        = &openserial_vars.outputQueue[openserial_vars.outputTxClass];
+   queue->idxR += openserial_vars.outputTxLength;
+   if (queue->idxR==queue->size) {
+      queue->idxR = 0;
+   }
+   openserial_vars.outputTxLength = 0;
+}
+
+#else
+
+/**
+\brief Write the next byte of the selected queue to the UART.
+*/
+void outputTxNext() {
+   openserial_outputQueue_t* queue;
+   uint8_t                   c;
+   uint8_t                   b;
+   
+   c = outputGetTxClass();
+   if (c==OUTPUT_MAX) {
+      return;
+   }
+   queue = &openserial_vars.outputQueue[c];
+   b     = queue->buf[queue->idxR++];
+   if (queue->idxR==queue->size) {
+      queue->idxR = 0;
+   }
+   
+   // frames start and end with a flag, which is escaped everywhere else
+   if (b==HDLC_FLAG) {
+      openserial_vars.outputTxClass   = c;
+      openserial_vars.outputTxInFrame = !openserial_vars.outputTxInFrame;
+   }
+   uart_writeByte(b);
+}
+
+#endif
+
+#ifdef FASTSIM
+/**
+\brief Flush all output queues at once, in order of priority.
+*/
+void outputFlush_FASTSIM() {
+   openserial_outputQueue_t* queue;
+   uint8_t                   c;
+   uint16_t                  length;
+   
+   for (c=0;c<OUTPUT_MAX;c++) {
+      queue = &openserial_vars.outputQueue[c];
+      while (queue->idxR!=queue->idxW) {
+         if (queue->idxW>queue->idxR) {
+            length = queue->idxW-queue->idxR;
+         } else {
+            length = queue->size-queue->idxR;
+         }
+         if (length>0xff) {
+            length = 0xff;
+         }
+         uart_writeBufferByLen_FASTSIM(&queue->buf[queue->idxR],(uint8_t)length);
+         queue->idxR += length;
+         if (queue->idxR==queue->size) {
+            queue->idxR = 0;
+         }
+      }
+   }
+   openserial_vars.outputTxInFrame = FALSE;
+}
+#endif
+
 //===== hdlc (input)
 
 /**
@@ -693,9 +1205,6 @@ port_INLINE void outputHdlcClose() {
 port_INLINE void inputHdlcOpen() {
    // reset the input buffer index
    openserial_vars.inputBufFill                       = 0;
-   
-   // initialize the value of the CRC
-   openserial_vars.inputCrc                           = HDLC_CRCINIT;
 }
 /**
 \brief Add a byte to the incoming HDLC frame.
@@ -712,18 +1221,24 @@ port_INLINE void inputHdlcWrite(uint8_t b) {
       // add byte to input buffer
       openserial_vars.inputBuf[openserial_vars.inputBufFill] = b;
       openserial_vars.inputBufFill++;
-      
-      // iterate through CRC calculator
-      openserial_vars.inputCrc = crcIteration(openserial_vars.inputCrc,b);
    }
 }
 /**
 \brief Finalize the incoming HDLC frame.
+
+The CRC is checked over the whole frame here rather than byte by byte in the
+receive interrupt.
 */
 port_INLINE void inputHdlcClose() {
    
    // verify the validity of the frame
-   if (openserial_vars.inputCrc==HDLC_CRCGOOD) {
+   if (
+         crcBuffer(
+            HDLC_CRCINIT,
+            openserial_vars.inputBuf,
+            openserial_vars.inputBufFill
+         )==HDLC_CRCGOOD
+      ) {
       // the CRC is correct
       
       // remove the CRC from the input buffer
@@ -740,6 +1255,16 @@ port_INLINE void inputHdlcClose() {
 
 //executed in ISR, called from scheduler.c
 void isr_openserial_tx() {
+#ifdef PORT_UART_WRITEBUFFER
+   if (openserial_vars.outputTxLength>0) {
+      // a whole output block was sent
+      outputTxBlockDone();
+      if (openserial_vars.mode==MODE_OUTPUT) {
+         outputTxNext();
+      }
+      return;
+   }
+#endif
    switch (openserial_vars.mode) {
       case MODE_INPUT:
          openserial_vars.reqFrameIdx++;
@@ -748,12 +1273,9 @@ void isr_openserial_tx() {
          }
          break;
       case MODE_OUTPUT:
-         if (openserial_vars.outputBufIdxW==openserial_vars.outputBufIdxR) {
-            openserial_vars.outputBufFilled = FALSE;
-         }
-         if (openserial_vars.outputBufFilled) {
-            uart_writeByte(openserial_vars.outputBuf[openserial_vars.outputBufIdxR++]);
-         }
+#ifndef PORT_UART_WRITEBUFFER
+         outputTxNext();
+#endif
          break;
       case MODE_OFF:
       default:
@@ -19,12 +19,30 @@
 //=========================== define ==========================================
 
 /**
-\brief Number of bytes of the serial output buffer, in bytes.
+\brief Number of bytes of the serial output queues, in bytes.
 
-\warning should be exactly 256 so wrap-around on the index does not require
-         the use of a slow modulo operator.
+Each class of frames has its own queue, so status frames can not crowd out
+data frames. A frame which does not fit in its queue is dropped whole.
 */
-#define SERIAL_OUTPUT_BUFFER_SIZE 256 // leave at 256!
+#ifndef SERIAL_OUTPUT_DATA_SIZE
+#define SERIAL_OUTPUT_DATA_SIZE   256
+#endif
+#ifndef SERIAL_OUTPUT_ERROR_SIZE
+#define SERIAL_OUTPUT_ERROR_SIZE  64
+#endif
+#ifndef SERIAL_OUTPUT_STATUS_SIZE
+#define SERIAL_OUTPUT_STATUS_SIZE 128
+#endif
+
+/**
+\brief Maximum number of bytes in a batch frame, before escaping and CRC.
+
+With OPENSERIAL_BATCH, status and info/error/critical messages are packed into
+batch frames of up to this size.
+*/
+#ifndef SERIAL_BATCH_MAXLEN
+#define SERIAL_BATCH_MAXLEN       128
+#endif
 
 /**
 \brief Number of bytes of the serial input buffer, in bytes.
@@ -34,6 +52,31 @@
 */
 #define SERIAL_INPUT_BUFFER_SIZE  200
 
+/**
+\brief Default number of serial output phases between two reports of a status
+       element.
+
+Elements are only reported when their content changed since their last
+report; the period can be changed for each element at run time, 0 disables
+reporting of that element.
+*/
+#ifndef SERIAL_STATUS_PERIOD
+#define SERIAL_STATUS_PERIOD          1
+#endif
+/// Default period of the elements which change every slot (ASN, MAC stats...).
+#ifndef SERIAL_STATUS_PERIOD_VOLATILE
+#define SERIAL_STATUS_PERIOD_VOLATILE 8
+#endif
+/**
+\brief Number of serial output phases after which all status elements are
+       reported again, changed or not.
+
+This resynchronizes a PC which connected late or lost status frames.
+*/
+#ifndef SERIAL_STATUS_REFRESH
+#define SERIAL_STATUS_REFRESH         128
+#endif
+
 /// Modes of the openserial module.
 enum {
    MODE_OFF    = 0, ///< The module is off, no serial activity.
@@ -41,6 +84,14 @@ enum {
    MODE_OUTPUT = 2  ///< The serial is transmitting bytes.
 };
 
+/// Classes of output frames, by decreasing priority.
+enum {
+   OUTPUT_DATA   = 0, ///< Data and sniffed packets.
+   OUTPUT_ERROR  = 1, ///< Info, error and critical messages.
+   OUTPUT_STATUS = 2, ///< Status elements.
+   OUTPUT_MAX    = 3,
+};
+
 // frames sent mote->PC
 #define SERFRAME_MOTE2PC_DATA               ((uint8_t)'D')
 #define SERFRAME_MOTE2PC_STATUS             ((uint8_t)'S')
@@ -49,12 +100,14 @@ enum {
 #define SERFRAME_MOTE2PC_CRITICAL           ((uint8_t)'C')
 #define SERFRAME_MOTE2PC_REQUEST            ((uint8_t)'R')
 #define SERFRAME_MOTE2PC_SNIFFED_PACKET     ((uint8_t)'P')
+#define SERFRAME_MOTE2PC_BATCH              ((uint8_t)'B')
 
 // frames sent PC->mote
 #define SERFRAME_PC2MOTE_SETROOT            ((uint8_t)'R')
 #define SERFRAME_PC2MOTE_DATA               ((uint8_t)'D')
 #define SERFRAME_PC2MOTE_TRIGGERSERIALECHO  ((uint8_t)'S')
 #define SERFRAME_PC2MOTE_COMMAND_GD         ((uint8_t)'G')
+#define SERFRAME_PC2MOTE_SETCONTEXT         ((uint8_t)'X')
 
 //=========================== typedef =========================================
 
@@ -75,36 +128,75 @@ enum {
    COMMAND_SET_6P_CLEAR          = 13,
    COMMAND_SET_SLOTDURATION      = 14,
    COMMAND_SET_6PRESPONSE_STATUS = 15,
-   COMMAND_MAX                   = 16,
+   COMMAND_SET_STATUSPERIOD      = 16,
+   COMMAND_MAX                   = 17,
 };
 
+/**
+\brief A queue of HDLC frames waiting to be sent over serial.
+
+Only complete frames are between idxR and idxW.
+*/
+typedef struct {
+   uint8_t*   buf;
+   uint16_t   size;
+   uint16_t   idxW;
+   uint16_t   idxR;
+   uint16_t   numDropped;             ///< frames dropped as the queue was full.
+#ifdef OPENSERIAL_BATCH
+   bool       batchOpen;              ///< the last frame is a batch which may be extended.
+   uint16_t   batchStart;             ///< index of the opening flag of that frame.
+   uint16_t   batchEnd;               ///< index right after its last message.
+   uint16_t   batchCrc;               ///< CRC up to its last message.
+   uint8_t    batchLen;               ///< length up to its last message, unescaped.
+#endif
+} openserial_outputQueue_t;
+
 //=========================== module variables ================================
 
 typedef struct {
    // admin
    uint8_t    mode;
    uint8_t    debugPrintCounter;
+   uint8_t    statusPeriod[STATUS_MAX];    // output phases between reports, 0 if disabled
+   uint8_t    statusCountdown[STATUS_MAX]; // output phases before the next report
+   uint16_t   statusDigest[STATUS_MAX];    // of the last report of each element
+   uint8_t    statusEpoch;                 // folded into digests, forces a refresh when changed
+   uint8_t    statusRefreshCounter;
    // input
    uint8_t    reqFrame[1+1+2+1]; // flag (1B), command (2B), CRC (2B), flag (1B)
    uint8_t    reqFrameIdx;
    uint8_t    lastRxByte;
    bool       busyReceiving;
    bool       inputEscaping;
-   uint16_t   inputCrc;
    uint8_t    inputBufFill;
    uint8_t    inputBuf[SERIAL_INPUT_BUFFER_SIZE];
    // output
-   bool       outputBufFilled;
+   openserial_outputQueue_t outputQueue[OUTPUT_MAX];
+   uint8_t    outputBufData[SERIAL_OUTPUT_DATA_SIZE];
+   uint8_t    outputBufError[SERIAL_OUTPUT_ERROR_SIZE];
+   uint8_t    outputBufStatus[SERIAL_OUTPUT_STATUS_SIZE];
    uint16_t   outputCrc;
-   uint8_t    outputBufIdxW;
-   uint8_t    outputBufIdxR;
-   uint8_t    outputBuf[SERIAL_OUTPUT_BUFFER_SIZE];
+   uint8_t    outputWriteClass;       // queue of the frame being built
+   uint16_t   outputWriteIdx;         // end of the frame being built
+   bool       outputWriteOverflow;    // the frame being built does not fit
+   uint8_t    outputTxClass;          // queue being sent
+   bool       outputTxInFrame;        // in the middle of a frame of that queue
+   uint16_t   outputTxLength;         // length of the block being sent
+#ifdef OPENSERIAL_BATCH
+   bool       outputWriteBatch;       // the frame being built is a batch
+   uint16_t   outputWriteStart;       // opening flag of the frame being built
+   uint8_t    outputWriteBatchLen;    // length of the frame being built, unescaped
+#endif
 } openserial_vars_t;
 
 //=========================== prototypes ======================================
 
 void    openserial_init(void);
 owerror_t openserial_printStatus(uint8_t statusElement, uint8_t* buffer, uint8_t length);
+bool    openserial_printStatusOnChange(uint8_t statusElement, uint8_t* buffer, uint8_t length);
+bool    openserial_printStatusRowOnChange(uint8_t statusElement, uint8_t* buffer, uint8_t length, uint16_t* lastDigest);
+void    openserial_setStatusPeriod(uint8_t statusElement, uint8_t period);
 owerror_t openserial_printInfo(uint8_t calling_component, uint8_t error_code,
                               errorparameter_t arg1,
                               errorparameter_t arg2);
@@ -122,6 +214,7 @@ void    openserial_startInput(void);
 void    openserial_startOutput(void);
 void    openserial_stop(void);
 bool    debugPrint_outBufferIndexes(void);
+bool    debugPrint_serialDrops(void);
 void    openserial_echo(uint8_t* but, uint8_t bufLen);
 
 // interrupt handlers
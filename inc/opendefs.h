@@ -42,6 +42,8 @@ static const uint8_t infoStackName[] = "OpenWSN ";
 #define LENGTH_ADDR64b  8
 #define LENGTH_ADDR128b 16
 
+#define LENGTH_PACKET   (1+1+125+2+1) // 1B spi address, 1B length, 125B data, 2B CRC, 1B LQI
+
 
 enum {
    E_SUCCESS                           = 0,
@@ -111,7 +113,10 @@ enum {
    STATUS_QUEUE                        =  8,
    STATUS_NEIGHBORS                    =  9,
    STATUS_KAPERIOD                     = 10,
-   STATUS_MAX                          = 11,
+   STATUS_MACPROFILE                   = 11,
+   STATUS_FRAG                         = 12,
+   STATUS_SERIALDROPS                  = 13,
+   STATUS_MAX                          = 14,
 };
 
 //component identifiers
@@ -170,6 +175,7 @@ enum {
    COMPONENT_UINJECT                   = 0x24,
    COMPONENT_RRT                       = 0x25,
    COMPONENT_SECURITY                  = 0x26,
+   COMPONENT_FRAG                      = 0x27,
 };
 
 /**
@@ -248,6 +254,14 @@ enum {
    ERR_SIXTOP_RETURNCODE               = 0x3c, // sixtop return code {0} at sixtop state {1}
    ERR_SIXTOP_COUNT                    = 0x3d, // there are {0} cells to request mote
    ERR_SIXTOP_LIST                     = 0x3e, // the cells reserved to request mote contains slot {0} and slot {1}
+   ERR_SOURCEROUTE_FULL                = 0x3f, // source routing table is full (max number of nodes is {0})
+   ERR_ROUTINGTABLE_FULL               = 0x40, // downward routing table is full (max number of routes is {0})
+   ERR_FRAG_REASSEMBLY_TIMEOUT         = 0x41, // reassembly of datagram with tag {0} timed out (datagram size {1})
+   ERR_FRAG_NO_BUFFER                  = 0x42, // no buffer to reassemble or fragment datagram with tag {0} (datagram size {1})
+   ERR_UNKNOWN_CONTEXT                 = 0x43, // unknown or invalid 6LoWPAN context {0} (location {1})
+   ERR_COAP_NO_FREE_OBSERVER           = 0x44, // no free row to register an observer of component {0}
+   ERR_COAP_NO_FREE_EXCHANGE           = 0x45, // confirmable message of component {0} refused, {1} outstanding with its destination
+   ERR_COAP_BAD_OPTION                 = 0x46, // malformed CoAP option {0} of length {1}, message rejected
 };
 
 //=========================== typedef =========================================
@@ -330,7 +344,8 @@ typedef struct {
    uint8_t       l1_lqi;                         // LQI of received packet
    bool          l1_crc;                         // did received packet pass CRC check?
    //the packet
-   uint8_t       packet[1+1+125+2+1];            // 1B spi address, 1B length, 125B data, 2B CRC, 1B LQI
+   uint8_t*      packet;                         // frame buffer, at most LENGTH_PACKET bytes (see openqueue)
+   uint8_t       packetSize;                     // size of the frame buffer, in bytes
 } OpenQueueEntry_t;
 
 //=========================== variables =======================================
@@ -15,42 +15,78 @@
 scheduler_vars_t scheduler_vars;
 scheduler_dbg_t  scheduler_dbg;
 
-//=========================== prototypes ======================================
+// index of the lowest bit set in a nibble (0xff if none)
+static const uint8_t scheduler_nibbleLsb[16] = {
+   0xff,0,1,0,2,0,1,0,3,0,1,0,2,0,1,0
+};
 
-void consumeTask(uint8_t taskId);
+//=========================== prototypes ======================================
 
 //=========================== public ==========================================
 
-void scheduler_init() {   
+void scheduler_init() {
+   uint8_t i;
    
    // initialization module variables
    memset(&scheduler_vars,0,sizeof(scheduler_vars_t));
    memset(&scheduler_dbg,0,sizeof(scheduler_dbg_t));
    
+   // chain all task containers into the free list
+   for (i=0;i<TASK_LIST_DEPTH-1;i++) {
+      scheduler_vars.taskBuf[i].next = &scheduler_vars.taskBuf[i+1];
+   }
+   scheduler_vars.freeList        = &scheduler_vars.taskBuf[0];
+   
    // enable the scheduler's interrupt so SW can wake up the scheduler
    SCHEDULER_ENABLE_INTERRUPT();
 }
 
 void scheduler_start() {
-   taskList_item_t* pThisTask;
+   taskList_item_t*   pThisTask;
+   taskList_bucket_t* bucket;
+   uint16_t           map;
+   uint8_t            prio;
+   uint8_t            shift;
+   INTERRUPT_DECLARATION();
+   
    while (1) {
-      while(scheduler_vars.task_list!=NULL) {
-         // there is still at least one task in the linked-list of tasks
+      while(scheduler_vars.bucketMap!=0) {
+         // there is still at least one task pending
+         
+         DISABLE_INTERRUPTS();
          
-         // the task to execute is the one at the head of the queue
-         pThisTask                = scheduler_vars.task_list;
+         // the highest priority is the lowest bit set in the bucket map
+         map                      = scheduler_vars.bucketMap;
+         shift                    = 0;
+         while ((map & 0x000f)==0) {
+            map                 >>= 4;
+            shift                += 4;
+         }
+         prio                     = shift+scheduler_nibbleLsb[map & 0x000f];
          
-         // shift the queue by one task
-         scheduler_vars.task_list = pThisTask->next;
+         // pop the task at the head of that priority's FIFO
+         bucket                   = &scheduler_vars.bucket[prio];
+         pThisTask                = bucket->head;
+         bucket->head             = pThisTask->next;
+         if (bucket->head==NULL) {
+            bucket->tail          = NULL;
+            scheduler_vars.bucketMap &= ~(1<<prio);
+         }
+         scheduler_dbg.numTasksCurPrio[prio]--;
+         
+         ENABLE_INTERRUPTS();
          
          // execute the current task
          pThisTask->cb();
          
          // free up this task container
+         DISABLE_INTERRUPTS();
          pThisTask->cb            = NULL;
          pThisTask->prio          = TASKPRIO_NONE;
-         pThisTask->next          = NULL;
+         pThisTask->next          = scheduler_vars.freeList;
+         scheduler_vars.freeList  = pThisTask;
          scheduler_dbg.numTasksCur--;
+         ENABLE_INTERRUPTS();
       }
       debugpins_task_clr();
       board_sleep();
@@ -59,45 +95,52 @@ void scheduler_start() {
 }
 
  void scheduler_push_task(task_cbt cb, task_prio_t prio) {
-   taskList_item_t*  taskContainer;
-   taskList_item_t** taskListWalker;
+   taskList_item_t*   taskContainer;
+   taskList_bucket_t* bucket;
    INTERRUPT_DECLARATION();
    
    DISABLE_INTERRUPTS();
    
-   // find an empty task container
-   taskContainer = &scheduler_vars.taskBuf[0];
-   while (taskContainer->cb!=NULL &&
-          taskContainer<=&scheduler_vars.taskBuf[TASK_LIST_DEPTH-1]) {
-      taskContainer++;
-   }
-   if (taskContainer>&scheduler_vars.taskBuf[TASK_LIST_DEPTH-1]) {
+   // take an empty task container from the free list
+   taskContainer = scheduler_vars.freeList;
+   if (taskContainer==NULL) {
       // task list has overflown. This should never happpen!
-   
+      
       // we can not print from within the kernel. Instead:
       // blink the error LED
       leds_error_blink();
-      // reset the board
-      board_reset();
+      // drop the task, account for it in the debug stats
+      scheduler_dbg.numTasksDropped++;
+      
+      ENABLE_INTERRUPTS();
+      return;
    }
+   scheduler_vars.freeList        = taskContainer->next;
+   
    // fill that task container with this task
    taskContainer->cb              = cb;
    taskContainer->prio            = prio;
+   taskContainer->next            = NULL;
    
-   // find position in queue
-   taskListWalker                 = &scheduler_vars.task_list;
-   while (*taskListWalker!=NULL &&
-          (*taskListWalker)->prio < taskContainer->prio) {
-      taskListWalker              = (taskList_item_t**)&((*taskListWalker)->next);
+   // append to the tail of that priority's FIFO
+   bucket                         = &scheduler_vars.bucket[prio];
+   if (bucket->tail==NULL) {
+      bucket->head                = taskContainer;
+   } else {
+      bucket->tail->next          = taskContainer;
    }
-   // insert at that position
-   taskContainer->next            = *taskListWalker;
-   *taskListWalker                = taskContainer;
+   bucket->tail                   = taskContainer;
+   scheduler_vars.bucketMap      |= (1<<prio);
+   
    // maintain debug stats
    scheduler_dbg.numTasksCur++;
    if (scheduler_dbg.numTasksCur>scheduler_dbg.numTasksMax) {
       scheduler_dbg.numTasksMax   = scheduler_dbg.numTasksCur;
    }
+   scheduler_dbg.numTasksCurPrio[prio]++;
+   if (scheduler_dbg.numTasksCurPrio[prio]>scheduler_dbg.numTasksMaxPrio[prio]) {
+      scheduler_dbg.numTasksMaxPrio[prio] = scheduler_dbg.numTasksCurPrio[prio];
+   }
    
    ENABLE_INTERRUPTS();
 }
@@ -24,14 +24,17 @@ typedef enum {
    TASKPRIO_COAP                  = 0x06,
    TASKPRIO_ADAPTIVE_SYNC         = 0x07, 
    TASKPRIO_OTF                   = 0x08,
+   TASKPRIO_FRAG_TIMEOUT          = 0x09,
    // tasks trigger by other interrupts
-   TASKPRIO_BUTTON                = 0x09,
-   TASKPRIO_SIXTOP_TIMEOUT        = 0x0a,
-   TASKPRIO_SNIFFER               = 0x0b,
-   TASKPRIO_MAX                   = 0x0c,
+   TASKPRIO_BUTTON                = 0x0a,
+   TASKPRIO_SIXTOP_TIMEOUT        = 0x0b,
+   TASKPRIO_SNIFFER               = 0x0c,
+   TASKPRIO_MAX                   = 0x0d,
 } task_prio_t;
 
 #define TASK_LIST_DEPTH           10
+// priorities run from 0 to TASKPRIO_MAX included, the latter is the lowest one
+#define TASKPRIO_NUM              (TASKPRIO_MAX+1)
 
 //=========================== typedef =========================================
 
@@ -43,18 +46,29 @@ typedef struct task_llist_t {
    void*                          next;
 } taskList_item_t;
 
+/**
+\brief FIFO of pending tasks sharing the same priority.
+*/
+typedef struct {
+   taskList_item_t*               head;
+   taskList_item_t*               tail;
+} taskList_bucket_t;
+
 //=========================== module variables ================================
 
 typedef struct {
    taskList_item_t                taskBuf[TASK_LIST_DEPTH];
-   taskList_item_t*               task_list;
-   uint8_t                        numTasksCur;
-   uint8_t                        numTasksMax;
+   taskList_item_t*               freeList;          // unused task containers
+   taskList_bucket_t              bucket[TASKPRIO_NUM]; // one FIFO per priority
+   uint16_t                       bucketMap;         // bit i set iff bucket[i] not empty
 } scheduler_vars_t;
 
 typedef struct {
    uint8_t                        numTasksCur;
    uint8_t                        numTasksMax;
+   uint8_t                        numTasksDropped;   // pushed while all containers in use
+   uint8_t                        numTasksMaxPrio[TASKPRIO_NUM]; // max depth per priority
+   uint8_t                        numTasksCurPrio[TASKPRIO_NUM];
 } scheduler_dbg_t;
 
 //=========================== prototypes ======================================
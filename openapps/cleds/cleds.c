@@ -39,6 +39,7 @@ void cleds__init() {
    cleds_vars.desc.path1val            = NULL;
    cleds_vars.desc.componentID         = COMPONENT_CLEDS;
    cleds_vars.desc.discoverable        = TRUE;
+   cleds_vars.desc.observable          = TRUE;
    cleds_vars.desc.callbackRx          = &cleds_receive;
    cleds_vars.desc.callbackSendDone    = &cleds_sendDone;
    
@@ -97,6 +98,7 @@ owerror_t cleds_receive(
          } else {
             leds_error_off();
          }
+         opencoap_notify(&cleds_vars.desc);
          
          // reset packet payload
          msg->payload                     = &(msg->packet[127]);
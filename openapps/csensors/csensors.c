@@ -50,6 +50,12 @@ void csensors_timer_cb(opentimer_id_t id);
 
 void csensors_task_cb(void);
 
+void csensors_observe_start(void);
+
+void csensors_observe_cb(opentimer_id_t id);
+
+void csensors_observe_task(void);
+
 void csensors_setPeriod(
    uint32_t          period,
    uint8_t           id
@@ -95,6 +101,7 @@ void csensors_init() {
    csensors_vars.cb_put                      = 0;
    csensors_vars.cb_get                      = 0;
    csensors_vars.numCsensors                 = 0;
+   csensors_vars.observeTimerId              = TOO_MANY_TIMERS_ERROR;
 
    for(i=0;i<numSensors;i++) {
       csensors_vars.csensors_resource[i].timerId               = MAX_NUM_TIMERS;
@@ -153,6 +160,7 @@ void csensors_register(
    }
    csensors_resource->desc.componentID      = COMPONENT_CSENSORS;
    csensors_resource->desc.discoverable     = TRUE;
+   csensors_resource->desc.observable       = TRUE;
    csensors_resource->desc.callbackRx       = &csensors_receive;
    csensors_resource->desc.callbackSendDone = &csensors_sendDone;
 
@@ -189,12 +197,9 @@ owerror_t csensors_receive(
 
          if (coap_options[1].type != COAP_OPTION_NUM_URIPATH) {
 
-            // have CoAP module write links to csensors resources
+            // have CoAP module write links to csensors resources, and the payload marker
             opencoap_writeLinks(msg,COMPONENT_CSENSORS);
 
-            packetfunctions_reserveHeaderSize(msg,1);
-            msg->payload[0]     = COAP_PAYLOAD_MARKER;
-
             // add return option
             packetfunctions_reserveHeaderSize(msg,2);
             msg->payload[0]     = COAP_OPTION_NUM_CONTENTFORMAT << 4 | 1;
@@ -216,6 +221,9 @@ owerror_t csensors_receive(
             packetfunctions_reserveHeaderSize(msg,2);
             msg->payload[0] = (COAP_OPTION_NUM_CONTENTFORMAT << 4) | 1;
             msg->payload[1] = COAP_MEDTYPE_APPOCTETSTREAM;
+
+            // this response may register an observer, sample while there are
+            csensors_observe_start();
          }
          // set the CoAP header
          coap_header->Code                = COAP_CODE_RESP_CONTENT;
@@ -363,6 +371,54 @@ void csensors_task_cb() {
    return;
 }
 
+/**
+   \brief   Start sampling the observed sensors, if not started already.
+*/
+void csensors_observe_start() {
+   if (csensors_vars.observeTimerId==TOO_MANY_TIMERS_ERROR) {
+      csensors_vars.observeTimerId = opentimers_start(
+         CSENSORS_OBSERVE_PERIOD,
+         TIMER_ONESHOT,
+         TIME_MS,
+         csensors_observe_cb
+      );
+   }
+}
+
+void csensors_observe_cb(opentimer_id_t id) {
+   scheduler_push_task(csensors_observe_task,TASKPRIO_COAP);
+}
+
+/**
+   \brief   Sample the observed sensors, notify the observers of those whose value
+      changed since last reported. Sampling stops once no sensor is observed.
+*/
+void csensors_observe_task() {
+   csensors_resource_t*       resource;
+   bool                       observed;
+   uint8_t                    id;
+
+   // the one-shot timer is over
+   csensors_vars.observeTimerId = TOO_MANY_TIMERS_ERROR;
+
+   observed = FALSE;
+   for(id=0;id<csensors_vars.numCsensors;id++) {
+      resource = &csensors_vars.csensors_resource[id];
+      if (opencoap_isObserved(&resource->desc)==FALSE) {
+         continue;
+      }
+      observed = TRUE;
+      if (resource->opensensors_resource->callbackRead()!=resource->lastValue) {
+         // the notification reports the new value
+         opencoap_notify(&resource->desc);
+      }
+   }
+
+   if (observed==TRUE) {
+      csensors_observe_start();
+   }
+}
+
 /**
 \brief Called when receiving a CoAP PUT to set a timer.
 
@@ -414,6 +470,7 @@ void csensors_fillpayload(OpenQueueEntry_t* msg,
    uint16_t              value;
 
    value=csensors_vars.csensors_resource[id].opensensors_resource->callbackRead();
+   csensors_vars.csensors_resource[id].lastValue = value;
    packetfunctions_reserveHeaderSize(msg,3);
    
    // add CoAP payload
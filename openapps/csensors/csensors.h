@@ -22,6 +22,11 @@
 /// task list used for matching callbacks from scheduler to the related timers
 #define CSENSORSTASKLIST 40
 
+/// period at which observed sensors are sampled, in ms
+#ifndef CSENSORS_OBSERVE_PERIOD
+#define CSENSORS_OBSERVE_PERIOD 5000
+#endif
+
 //=========================== typedef =========================================
 
 typedef struct {
@@ -29,6 +34,7 @@ typedef struct {
    opensensors_resource_desc_t* opensensors_resource;
    uint16_t                     period;
    opentimer_id_t               timerId;
+   uint16_t                     lastValue;       ///< value last reported
 } csensors_resource_t;
 
 //=========================== module variables ================================
@@ -40,6 +46,7 @@ typedef struct {
    uint8_t                      cb_list[CSENSORSTASKLIST];
    uint8_t                      cb_put;
    uint8_t                      cb_get;
+   opentimer_id_t               observeTimerId;  ///< samples the observed sensors
 } csensors_vars_t;
 
 //=========================== variables =======================================
@@ -59,11 +59,8 @@ owerror_t cwellknown_receive(
          msg->payload        = &(msg->packet[127]);
          msg->length         = 0;
          
-         // have CoAP module write links to all resources
+         // have CoAP module write links to all resources, and the payload marker
          opencoap_writeLinks(msg,COMPONENT_CWELLKNOWN);
-         
-         packetfunctions_reserveHeaderSize(msg,1);
-         msg->payload[0]     = COAP_PAYLOAD_MARKER;
             
          // add return option
          packetfunctions_reserveHeaderSize(msg,2);
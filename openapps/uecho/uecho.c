@@ -18,7 +18,7 @@ void uecho_receive(OpenQueueEntry_t* request) {
    uint16_t          temp_l4_destination_port;
    OpenQueueEntry_t* reply;
    
-   reply = openqueue_getFreePacketBuffer(COMPONENT_UECHO);
+   reply = openqueue_getFreePacketBufferForLength(COMPONENT_UECHO,request->length);
    if (reply==NULL) {
       openserial_printError(
          COMPONENT_UECHO,
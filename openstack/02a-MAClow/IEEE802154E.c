@@ -22,6 +22,7 @@
 ieee154e_vars_t    ieee154e_vars;
 ieee154e_stats_t   ieee154e_stats;
 ieee154e_dbg_t     ieee154e_dbg;
+ieee154e_profile_t ieee154e_profile;
 
 //=========================== prototypes ======================================
 
@@ -88,6 +89,10 @@ void     notif_receive(OpenQueueEntry_t* packetReceived);
 // statistics
 void     resetStats(void);
 void     updateStats(PORT_SIGNED_INT_WIDTH timeCorrection);
+void     resetProfile(void);
+void     profileDeadline(uint8_t deadline, PORT_RADIOTIMER_WIDTH timeout);
+void     profileDuration(uint8_t row, PORT_RADIOTIMER_WIDTH start);
+void     profileRecord(uint8_t row, int16_t value);
 // misc
 uint8_t  calculateFrequency(uint8_t channelOffset);
 void     changeState(ieee154e_state_t newstate);
@@ -110,6 +115,7 @@ void ieee154e_init() {
    // initialize variables
    memset(&ieee154e_vars,0,sizeof(ieee154e_vars_t));
    memset(&ieee154e_dbg,0,sizeof(ieee154e_dbg_t));
+   resetProfile();
    
    ieee154e_vars.singleChannel     = SYNCHRONIZING_CHANNEL;
    ieee154e_vars.isAckEnabled      = TRUE;
@@ -190,6 +196,7 @@ void isr_ieee154e_newSlot() {
          changeIsSync(TRUE);
          incrementAsnOffset();
          ieee154e_syncSlotOffset();
+         schedule_syncAsn(&ieee154e_vars.asn);
          ieee154e_vars.nextActiveSlotOffset = schedule_getNextActiveSlotOffset();
       } else {
          activity_synchronize_newSlot();
@@ -382,8 +389,7 @@ bool debugPrint_asn() {
    output.byte4         =  ieee154e_vars.asn.byte4;
    output.bytes2and3    =  ieee154e_vars.asn.bytes2and3;
    output.bytes0and1    =  ieee154e_vars.asn.bytes0and1;
-   openserial_printStatus(STATUS_ASN,(uint8_t*)&output,sizeof(output));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_ASN,(uint8_t*)&output,sizeof(output));
 }
 
 /**
@@ -397,8 +403,7 @@ status information about several modules in the OpenWSN stack.
 bool debugPrint_isSync() {
    uint8_t output=0;
    output = ieee154e_vars.isSync;
-   openserial_printStatus(STATUS_ISSYNC,(uint8_t*)&output,sizeof(uint8_t));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_ISSYNC,(uint8_t*)&output,sizeof(uint8_t));
 }
 
 /**
@@ -411,8 +416,57 @@ status information about several modules in the OpenWSN stack.
 */
 bool debugPrint_macStats() {
    // send current stats over serial
-   openserial_printStatus(STATUS_MACSTATS,(uint8_t*)&ieee154e_stats,sizeof(ieee154e_stats_t));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_MACSTATS,(uint8_t*)&ieee154e_stats,sizeof(ieee154e_stats_t));
+}
+
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+Prints the slack profile of the next FSM deadline, or the profile of the next
+duration, which changed since it was last printed, in turn.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_macProfile() {
+#if IEEE802154E_PROFILE
+   debugDeadlineProfile_t temp;
+   uint8_t                i;
+   INTERRUPT_DECLARATION();
+   
+   for (i=0;i<PROFILE_MAX;i++) {
+      // increment the row just printed
+      ieee154e_profile.debugPrintRow = (ieee154e_profile.debugPrintRow+1)%PROFILE_MAX;
+      
+      // gather status data, the profile is updated from ISR
+      temp.deadline = ieee154e_profile.debugPrintRow;
+      DISABLE_INTERRUPTS();
+      memcpy(
+         &temp.profile,
+         &ieee154e_profile.deadlines[ieee154e_profile.debugPrintRow],
+         sizeof(ieee154e_deadlineProfile_t)
+      );
+      ENABLE_INTERRUPTS();
+      
+      // send status data over serial port
+      if (
+         openserial_printStatusRowOnChange(
+            STATUS_MACPROFILE,
+            (uint8_t*)&temp,
+            sizeof(debugDeadlineProfile_t),
+            &ieee154e_profile.debugDigest[ieee154e_profile.debugPrintRow]
+         )==TRUE
+      ) {
+         return TRUE;
+      }
+   }
+   
+   return FALSE;
+#else
+   return FALSE;
+#endif
 }
 
 //=========================== private =========================================
@@ -551,7 +605,7 @@ port_INLINE void activity_synchronize_endOfFrame(PORT_RADIOTIMER_WIDTH capturedT
       ieee154e_vars.dataReceived->payload = &(ieee154e_vars.dataReceived->packet[FIRST_FRAME_BYTE]);
       radio_getReceivedFrame(       ieee154e_vars.dataReceived->payload,
                                    &ieee154e_vars.dataReceived->length,
-                             sizeof(ieee154e_vars.dataReceived->packet),
+                                    ieee154e_vars.dataReceived->packetSize,
                                    &ieee154e_vars.dataReceived->l1_rssi,
                                    &ieee154e_vars.dataReceived->l1_lqi,
                                    &ieee154e_vars.dataReceived->l1_crc);
@@ -789,7 +843,7 @@ port_INLINE bool ieee154e_processIEs(OpenQueueEntry_t* pkt, uint16_t* lenIE) {
             // at this point, ASN and frame length are known
             // the current slotoffset can be inferred
             ieee154e_syncSlotOffset();
-            schedule_syncSlotOffset(ieee154e_vars.slotOffset);
+            schedule_syncAsn(&ieee154e_vars.asn);
             ieee154e_vars.nextActiveSlotOffset = schedule_getNextActiveSlotOffset();
             /* 
             infer the asnOffset based on the fact that
@@ -933,6 +987,7 @@ port_INLINE void activity_ti1ORri1() {
             // record that I attempt to transmit this packet
             ieee154e_vars.dataToSend->l2_numTxAttempts++;
             // arm tt1
+            profileDeadline(DEADLINE_TT1,DURATION_tt1);
             radiotimer_schedule(DURATION_tt1);
             break;
          }
@@ -944,6 +999,7 @@ port_INLINE void activity_ti1ORri1() {
          // change state
          changeState(S_RXDATAOFFSET);
          // arm rt1
+         profileDeadline(DEADLINE_RT1,DURATION_rt1);
          radiotimer_schedule(DURATION_rt1);
          break;
       case CELLTYPE_SERIALRX:
@@ -987,41 +1043,56 @@ port_INLINE void activity_ti1ORri1() {
 }
 
 port_INLINE void activity_ti2() {
+   OpenQueueEntry_t* frame;
+   PORT_RADIOTIMER_WIDTH start;
    
    // change state
    changeState(S_TXDATAPREPARE);
-
-   // make a local copy of the frame
-   packetfunctions_duplicatePacket(&ieee154e_vars.localCopyForTransmission, ieee154e_vars.dataToSend);
+   start = radio_getTimerValue();
 
    // check if packet needs to be encrypted/authenticated before transmission 
-   if (ieee154e_vars.localCopyForTransmission.l2_securityLevel != IEEE154_ASH_SLF_TYPE_NOSEC) { // security enabled
-      // encrypt in a local copy
-      if (IEEE802154_SECURITY.outgoingFrame(&ieee154e_vars.localCopyForTransmission) != E_SUCCESS) {
+   if (ieee154e_vars.dataToSend->l2_securityLevel != IEEE154_ASH_SLF_TYPE_NOSEC) { // security enabled
+      // the nonce contains the ASN, so the secured frame is different for each
+      // attempt: encrypt in a local copy, the queue keeps the plaintext
+      ieee154e_vars.localCopyForTransmission.packet     = ieee154e_vars.localCopyBuffer;
+      ieee154e_vars.localCopyForTransmission.packetSize = LENGTH_PACKET;
+      if (
+            packetfunctions_duplicatePacket(&ieee154e_vars.localCopyForTransmission, ieee154e_vars.dataToSend) != E_SUCCESS ||
+            IEEE802154_SECURITY.outgoingFrame(&ieee154e_vars.localCopyForTransmission) != E_SUCCESS
+         ) {
          // keep the frame in the OpenQueue in order to retry later
          endSlot(); // abort
          return;
       }
+      frame = &ieee154e_vars.localCopyForTransmission;
+   } else {
+      // unsecured frames are the same for each attempt, send them in place
+      frame = ieee154e_vars.dataToSend;
    }
    
-   // add 2 CRC bytes only to the local copy as we end up here for each retransmission
-   packetfunctions_reserveFooterSize(&ieee154e_vars.localCopyForTransmission, 2);
-   
    // calculate the frequency to transmit on
    ieee154e_vars.freq = calculateFrequency(schedule_getChannelOffset()); 
    
    // configure the radio for that frequency
    radio_setFrequency(ieee154e_vars.freq);
    
-   // load the packet in the radio's Tx buffer
-   radio_loadPacket(ieee154e_vars.localCopyForTransmission.payload,
-                    ieee154e_vars.localCopyForTransmission.length);
+   // load the packet in the radio's Tx buffer, with the 2 CRC bytes the radio
+   // fills in. The frame is not extended as we end up here for each
+   // retransmission, openqueue always leaves room for them after the frame.
+   radio_loadPacket(frame->payload,
+                    frame->length+2);
    
    // enable the radio in Tx mode. This does not send the packet.
    radio_txEnable();
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
+   // profile the preparation, secured frames are copied and encrypted
+   profileDuration(
+      frame==ieee154e_vars.dataToSend ? PROFILE_TXPREPARE : PROFILE_TXPREPARE_SECURED,
+      start
+   );
    // arm tt2
+   profileDeadline(DEADLINE_TT2,DURATION_tt2);
    radiotimer_schedule(DURATION_tt2);
    
    // change state
@@ -1109,6 +1180,7 @@ port_INLINE void activity_ti5(PORT_RADIOTIMER_WIDTH capturedTime) {
    
    if (listenForAck==TRUE) {
       // arm tt5
+      profileDeadline(DEADLINE_TT5,DURATION_tt5);
       radiotimer_schedule(DURATION_tt5);
    } else {
       // indicate succesful Tx to schedule to keep statistics
@@ -1138,6 +1210,7 @@ port_INLINE void activity_ti6() {
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
    // arm tt6
+   profileDeadline(DEADLINE_TT6,DURATION_tt6);
    radiotimer_schedule(DURATION_tt6);
    
    // change state
@@ -1177,7 +1250,7 @@ port_INLINE void activity_tie5() {
       notif_sendDone(ieee154e_vars.dataToSend,E_FAIL);
    } else {
       // return packet to the virtual COMPONENT_SIXTOP_TO_IEEE802154E component
-      ieee154e_vars.dataToSend->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+      openqueue_macPutBackDataPacket(ieee154e_vars.dataToSend);
    }
    
    // reset local variable
@@ -1254,7 +1327,7 @@ port_INLINE void activity_ti9(PORT_RADIOTIMER_WIDTH capturedTime) {
       ieee154e_vars.ackReceived->payload = &(ieee154e_vars.ackReceived->packet[FIRST_FRAME_BYTE]);
       radio_getReceivedFrame(       ieee154e_vars.ackReceived->payload,
                                    &ieee154e_vars.ackReceived->length,
-                             sizeof(ieee154e_vars.ackReceived->packet),
+                                    ieee154e_vars.ackReceived->packetSize,
                                    &ieee154e_vars.ackReceived->l1_rssi,
                                    &ieee154e_vars.ackReceived->l1_lqi,
                                    &ieee154e_vars.ackReceived->l1_crc);
@@ -1353,6 +1426,7 @@ port_INLINE void activity_ri2() {
    ieee154e_vars.radioOnThisSlot=TRUE;
    
    // arm rt2
+   profileDeadline(DEADLINE_RT2,DURATION_rt2);
    radiotimer_schedule(DURATION_rt2);
        
    // change state
@@ -1458,7 +1532,7 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
       ieee154e_vars.dataReceived->payload = &(ieee154e_vars.dataReceived->packet[FIRST_FRAME_BYTE]);
       radio_getReceivedFrame(       ieee154e_vars.dataReceived->payload,
                                    &ieee154e_vars.dataReceived->length,
-                             sizeof(ieee154e_vars.dataReceived->packet),
+                                    ieee154e_vars.dataReceived->packetSize,
                                    &ieee154e_vars.dataReceived->l1_rssi,
                                    &ieee154e_vars.dataReceived->l1_lqi,
                                    &ieee154e_vars.dataReceived->l1_crc);
@@ -1535,6 +1609,7 @@ port_INLINE void activity_ri5(PORT_RADIOTIMER_WIDTH capturedTime) {
       // check if ack requested
       if (ieee802514_header.ackRequested==1 && ieee154e_vars.isAckEnabled == TRUE) {
          // arm rt5
+         profileDeadline(DEADLINE_RT5,DURATION_rt5);
          radiotimer_schedule(DURATION_rt5);
       } else {
          // synchronize to the received packet iif I'm not a DAGroot and this is my preferred parent
@@ -1570,7 +1645,7 @@ port_INLINE void activity_ri6() {
    changeState(S_TXACKPREPARE);
    
    // get a buffer to put the ack to send in
-   ieee154e_vars.ackToSend = openqueue_getFreePacketBuffer(COMPONENT_IEEE802154E);
+   ieee154e_vars.ackToSend = openqueue_getFreeSmallPacketBuffer(COMPONENT_IEEE802154E);
    if (ieee154e_vars.ackToSend==NULL) {
       // log the error
       openserial_printError(COMPONENT_IEEE802154E,ERR_NO_FREE_PACKET_BUFFER,
@@ -1636,6 +1711,7 @@ port_INLINE void activity_ri6() {
    ieee154e_vars.radioOnInit=radio_getTimerValue();
    ieee154e_vars.radioOnThisSlot=TRUE;
    // arm rt6
+   profileDeadline(DEADLINE_RT6,DURATION_rt6);
    radiotimer_schedule(DURATION_rt6);
    
    // change state
@@ -1822,6 +1898,17 @@ port_INLINE void ieee154e_getAsn(uint8_t* array) {
    array[4]         =  ieee154e_vars.asn.byte4;
 }
 
+/**
+\brief Current ASN, in units of 256 slots.
+
+Coarse enough for the lifetimes of routes and fragments, it wraps around
+every 2^24 slots.
+*/
+uint16_t ieee154e_getCoarseAsn() {
+   return (ieee154e_vars.asn.bytes0and1/256 & 0xff) |
+          ((uint16_t)(ieee154e_vars.asn.bytes2and3 & 0xff)<<8);
+}
+
 port_INLINE uint16_t ieee154e_getTimeCorrection() {
     int16_t returnVal;
     
@@ -2092,6 +2179,76 @@ port_INLINE void resetStats() {
    // do not reset the number of de-synchronizations
 }
 
+port_INLINE void resetProfile() {
+   uint8_t i;
+   
+   memset(&ieee154e_profile,0,sizeof(ieee154e_profile_t));
+   for (i=0;i<PROFILE_MAX;i++) {
+      ieee154e_profile.deadlines[i].minSlack = 0x7fff;
+      ieee154e_profile.deadlines[i].maxSlack = -0x7fff;
+   }
+}
+
+/**
+\brief Record how much time is left before a deadline.
+
+Called right before arming the FSM timer which ends a processing step, i.e.
+when that processing is done. The difference with the timer's timeout is
+the slack: how much longer that step could have taken. A negative slack
+means the timer is armed too late and the deadline is missed.
+
+\param[in] deadline The deadline, one of ieee154e_deadline_t.
+\param[in] timeout  The value the FSM timer is about to be armed with.
+*/
+port_INLINE void profileDeadline(uint8_t deadline, PORT_RADIOTIMER_WIDTH timeout) {
+#if IEEE802154E_PROFILE
+   profileRecord(deadline,(int16_t)(timeout-radio_getTimerValue()));
+#endif
+}
+
+/**
+\brief Record how long a processing step took.
+
+\param[in] row   The step, one of the PROFILE_* rows of ieee154e_deadline_t.
+\param[in] start The radio timer value when the step started.
+*/
+port_INLINE void profileDuration(uint8_t row, PORT_RADIOTIMER_WIDTH start) {
+#if IEEE802154E_PROFILE
+   profileRecord(row,(int16_t)(radio_getTimerValue()-start));
+#endif
+}
+
+/**
+\brief Add a value to the min, max and histogram of a profile row.
+*/
+port_INLINE void profileRecord(uint8_t row, int16_t value) {
+   ieee154e_deadlineProfile_t* profile;
+   uint8_t  bin;
+   
+   profile = &ieee154e_profile.deadlines[row];
+   
+   if (value<profile->minSlack) {
+      profile->minSlack = value;
+   }
+   if (value>profile->maxSlack) {
+      profile->maxSlack = value;
+   }
+   
+   // logarithmic bins
+   if (value<0) {
+      bin = 0;
+   } else {
+      bin = 1;
+      while (value>1 && bin<PROFILE_NUMBINS-1) {
+         value >>= 1;
+         bin++;
+      }
+   }
+   if (profile->histogram[bin]<0xffff) {
+      profile->histogram[bin]++;
+   }
+}
+
 void updateStats(PORT_SIGNED_INT_WIDTH timeCorrection) {
    // update minCorrection
    if (timeCorrection<ieee154e_stats.minCorrection) {
@@ -2237,7 +2394,7 @@ void endSlot() {
          notif_sendDone(ieee154e_vars.dataToSend,E_FAIL);
       } else {
          // return packet to the virtual COMPONENT_SIXTOP_TO_IEEE802154E component
-         ieee154e_vars.dataToSend->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+         openqueue_macPutBackDataPacket(ieee154e_vars.dataToSend);
       }
       
       // reset local variable
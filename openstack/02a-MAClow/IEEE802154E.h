@@ -201,6 +201,30 @@ enum ieee154e_linkOption_enum {
 #define DURATION_rt7 ieee154e_vars.lastCapturedTime+TsTxAckDelay-delayTx+wdRadioTx
 #define DURATION_rt8 ieee154e_vars.lastCapturedTime+wdAckDuration
 
+// slack profiling of the FSM deadlines, see profileDeadline(), and duration
+// of the Tx data preparation, see profileDuration()
+#ifndef IEEE802154E_PROFILE
+#define IEEE802154E_PROFILE          1
+#endif
+#define PROFILE_NUMBINS              8
+
+// FSM deadlines, i.e. timers armed after a processing step
+typedef enum {
+   DEADLINE_TT1              = 0,      // slot start, before preparing Tx data
+   DEADLINE_TT2              = 1,      // Tx data prepared, before 'go'
+   DEADLINE_TT5              = 2,      // Tx data done, before preparing Rx ACK
+   DEADLINE_TT6              = 3,      // Rx ACK prepared, before 'go'
+   DEADLINE_RT1              = 4,      // slot start, before preparing Rx data
+   DEADLINE_RT2              = 5,      // Rx data prepared, before 'go'
+   DEADLINE_RT5              = 6,      // Rx data done, before preparing Tx ACK
+   DEADLINE_RT6              = 7,      // Tx ACK prepared, before 'go'
+   DEADLINE_MAX              = 8,
+   // durations, in ticks, profiled as the deadlines' slack
+   PROFILE_TXPREPARE         = 8,      // activity_ti2(), unsecured frame sent in place
+   PROFILE_TXPREPARE_SECURED = 9,      // activity_ti2(), secured copy of the frame
+   PROFILE_MAX               = 10,
+} ieee154e_deadline_t;
+
 //=========================== typedef =========================================
 
 // IEEE802.15.4E acknowledgement (ACK)
@@ -223,6 +247,7 @@ typedef struct {
    PORT_RADIOTIMER_WIDTH     deSyncTimeout;           // how many slots left before looses sync
    bool                      isSync;                  // TRUE iff mote is synchronized to network
    OpenQueueEntry_t          localCopyForTransmission;// copy of the frame used for current TX
+   uint8_t                   localCopyBuffer[LENGTH_PACKET];// frame buffer of localCopyForTransmission
    // as shown on the chronogram
    ieee154e_state_t          state;                   // state of the FSM
    OpenQueueEntry_t*         dataToSend;              // pointer to the data to send
@@ -273,6 +298,29 @@ typedef struct {
    PORT_RADIOTIMER_WIDTH     num_endOfFrame;
 } ieee154e_dbg_t;
 
+// slack, in radio timer ticks, left when arming the timer of a deadline, or
+// duration of a processing step for the PROFILE_* rows
+BEGIN_PACK
+typedef struct {
+   int16_t                   minSlack;                // smallest slack
+   int16_t                   maxSlack;                // largest slack
+   uint16_t                  histogram[PROFILE_NUMBINS];// bin 0: missed, bin 1: [0..1], bin i: [2^(i-1)..2^i-1], last bin: above
+} ieee154e_deadlineProfile_t;
+END_PACK
+
+BEGIN_PACK
+typedef struct {
+   uint8_t                   deadline;
+   ieee154e_deadlineProfile_t profile;
+} debugDeadlineProfile_t;
+END_PACK
+
+typedef struct {
+   ieee154e_deadlineProfile_t deadlines[PROFILE_MAX];
+   uint8_t                   debugPrintRow;
+   uint16_t                  debugDigest[PROFILE_MAX]; // of each row, when last printed
+} ieee154e_profile_t;
+
 //=========================== prototypes ======================================
 
 // admin
@@ -281,6 +329,7 @@ void               ieee154e_init(void);
 PORT_RADIOTIMER_WIDTH   ieee154e_asnDiff(asn_t* someASN);
 bool               ieee154e_isSynch(void);
 void               ieee154e_getAsn(uint8_t* array);
+uint16_t           ieee154e_getCoarseAsn(void);
 void               ieee154e_setIsAckEnabled(bool isEnabled);
 void               ieee154e_setSingleChannel(uint8_t channel);
 void               ieee154e_setIsSecurityEnabled(bool isEnabled);
@@ -295,6 +344,7 @@ void               ieee154e_endOfFrame(PORT_RADIOTIMER_WIDTH capturedTime);
 bool               debugPrint_asn(void);
 bool               debugPrint_isSync(void);
 bool               debugPrint_macStats(void);
+bool               debugPrint_macProfile(void);
 
 /**
 \}
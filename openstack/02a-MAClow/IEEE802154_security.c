@@ -8,6 +8,7 @@
 \author Malisa Vucinic <malishav@gmail.com>, June 2015.
 */
 
+#include "opendefs.h"
 #include "packetfunctions.h"
 #include "crypto_engine.h"
 #include "IEEE802154.h"
@@ -25,6 +25,8 @@ bool isThisRowMatching(
         open_addr_t* address,
         uint8_t      rowNumber
      );
+uint8_t getNeighborRow(open_addr_t* address);
+uint8_t neighborHash(open_addr_t* address);
 
 //=========================== public ==========================================
 
@@ -35,6 +37,8 @@ void neighbors_init() {
    
    // clear module variables
    memset(&neighbors_vars,0,sizeof(neighbors_vars_t));
+   memset(&neighbors_vars.hashHead[0],NEIGHBORS_NONE,sizeof(neighbors_vars.hashHead));
+   memset(&neighbors_vars.hashNext[0],NEIGHBORS_NONE,sizeof(neighbors_vars.hashNext));
    
    // set myDAGrank
    if (idmanager_getIsDAGroot()==TRUE) {
@@ -208,12 +212,10 @@ bool neighbors_isStableNeighbor(open_addr_t* address) {
          return returnVal;
    }
    
-   // iterate through neighbor table
-   for (i=0;i<MAXNUMNEIGHBORS;i++) {
-      if (isThisRowMatching(&temp_addr_64b,i) && neighbors_vars.neighbors[i].stableNeighbor==TRUE) {
-         returnVal  = TRUE;
-         break;
-      }
+   // look up neighbor table
+   i = getNeighborRow(&temp_addr_64b);
+   if (i!=NEIGHBORS_NONE && neighbors_vars.neighbors[i].stableNeighbor==TRUE) {
+      returnVal  = TRUE;
    }
    
    return returnVal;
@@ -236,12 +238,10 @@ bool neighbors_isPreferredParent(open_addr_t* address) {
    // by default, not preferred
    returnVal = FALSE;
    
-   // iterate through neighbor table
-   for (i=0;i<MAXNUMNEIGHBORS;i++) {
-      if (isThisRowMatching(address,i) && neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE) {
-         returnVal  = TRUE;
-         break;
-      }
+   // look up neighbor table
+   i = getNeighborRow(address);
+   if (i!=NEIGHBORS_NONE && neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE) {
+      returnVal  = TRUE;
    }
    
    ENABLE_INTERRUPTS();
@@ -318,55 +318,43 @@ void neighbors_indicateRx(open_addr_t* l2_src,
                           bool         joinPrioPresent,
                           uint8_t      joinPrio) {
    uint8_t i;
-   bool    newNeighbor;
    
    // update existing neighbor
-   newNeighbor = TRUE;
-   for (i=0;i<MAXNUMNEIGHBORS;i++) {
-      if (isThisRowMatching(l2_src,i)) {
-         
-         // this is not a new neighbor
-         newNeighbor = FALSE;
-         
-         // update numRx, rssi, asn
-         neighbors_vars.neighbors[i].numRx++;
-         neighbors_vars.neighbors[i].rssi=rssi;
-         memcpy(&neighbors_vars.neighbors[i].asn,asnTs,sizeof(asn_t));
-         //update jp
-         if (joinPrioPresent==TRUE){
-            neighbors_vars.neighbors[i].joinPrio=joinPrio;
-         }
-         
-         // update stableNeighbor, switchStabilityCounter
-         if (neighbors_vars.neighbors[i].stableNeighbor==FALSE) {
-            if (neighbors_vars.neighbors[i].rssi>BADNEIGHBORMAXRSSI) {
-               neighbors_vars.neighbors[i].switchStabilityCounter++;
-               if (neighbors_vars.neighbors[i].switchStabilityCounter>=SWITCHSTABILITYTHRESHOLD) {
-                  neighbors_vars.neighbors[i].switchStabilityCounter=0;
-                  neighbors_vars.neighbors[i].stableNeighbor=TRUE;
-               }
-            } else {
+   i = getNeighborRow(l2_src);
+   if (i!=NEIGHBORS_NONE) {
+      // update numRx, rssi, asn
+      neighbors_vars.neighbors[i].numRx++;
+      neighbors_vars.neighbors[i].rssi=rssi;
+      memcpy(&neighbors_vars.neighbors[i].asn,asnTs,sizeof(asn_t));
+      //update jp
+      if (joinPrioPresent==TRUE){
+         neighbors_vars.neighbors[i].joinPrio=joinPrio;
+      }
+      
+      // update stableNeighbor, switchStabilityCounter
+      if (neighbors_vars.neighbors[i].stableNeighbor==FALSE) {
+         if (neighbors_vars.neighbors[i].rssi>BADNEIGHBORMAXRSSI) {
+            neighbors_vars.neighbors[i].switchStabilityCounter++;
+            if (neighbors_vars.neighbors[i].switchStabilityCounter>=SWITCHSTABILITYTHRESHOLD) {
                neighbors_vars.neighbors[i].switchStabilityCounter=0;
+               neighbors_vars.neighbors[i].stableNeighbor=TRUE;
             }
-         } else if (neighbors_vars.neighbors[i].stableNeighbor==TRUE) {
-            if (neighbors_vars.neighbors[i].rssi<GOODNEIGHBORMINRSSI) {
-               neighbors_vars.neighbors[i].switchStabilityCounter++;
-               if (neighbors_vars.neighbors[i].switchStabilityCounter>=SWITCHSTABILITYTHRESHOLD) {
-                  neighbors_vars.neighbors[i].switchStabilityCounter=0;
-                   neighbors_vars.neighbors[i].stableNeighbor=FALSE;
-               }
-            } else {
+         } else {
+            neighbors_vars.neighbors[i].switchStabilityCounter=0;
+         }
+      } else if (neighbors_vars.neighbors[i].stableNeighbor==TRUE) {
+         if (neighbors_vars.neighbors[i].rssi<GOODNEIGHBORMINRSSI) {
+            neighbors_vars.neighbors[i].switchStabilityCounter++;
+            if (neighbors_vars.neighbors[i].switchStabilityCounter>=SWITCHSTABILITYTHRESHOLD) {
                neighbors_vars.neighbors[i].switchStabilityCounter=0;
+                neighbors_vars.neighbors[i].stableNeighbor=FALSE;
             }
+         } else {
+            neighbors_vars.neighbors[i].switchStabilityCounter=0;
          }
-         
-         // stop looping
-         break;
       }
-   }
-   
-   // register new neighbor
-   if (newNeighbor==TRUE) {
+   } else {
+      // register new neighbor
       registerNewNeighbor(l2_src, rssi, asnTs, joinPrioPresent,joinPrio);
    }
 }
@@ -399,24 +387,21 @@ void neighbors_indicateTx(open_addr_t* l2_dest,
       return;
    }
    
-   // loop through neighbor table
-   for (i=0;i<MAXNUMNEIGHBORS;i++) {
-      if (isThisRowMatching(l2_dest,i)) {
-         // handle roll-over case
-        
-          if (neighbors_vars.neighbors[i].numTx>(0xff-numTxAttempts)) {
-              neighbors_vars.neighbors[i].numWraps++; //counting the number of times that tx wraps.
-              neighbors_vars.neighbors[i].numTx/=2;
-              neighbors_vars.neighbors[i].numTxACK/=2;
-           }
-         // update statistics
-        neighbors_vars.neighbors[i].numTx += numTxAttempts; 
-        
-        if (was_finally_acked==TRUE) {
-            neighbors_vars.neighbors[i].numTxACK++;
-            memcpy(&neighbors_vars.neighbors[i].asn,asnTs,sizeof(asn_t));
-        }
-        break;
+   // look up neighbor table
+   i = getNeighborRow(l2_dest);
+   if (i!=NEIGHBORS_NONE) {
+      // handle roll-over case
+      if (neighbors_vars.neighbors[i].numTx>(0xff-numTxAttempts)) {
+         neighbors_vars.neighbors[i].numWraps++; //counting the number of times that tx wraps.
+         neighbors_vars.neighbors[i].numTx/=2;
+         neighbors_vars.neighbors[i].numTxACK/=2;
+      }
+      // update statistics
+      neighbors_vars.neighbors[i].numTx += numTxAttempts; 
+      
+      if (was_finally_acked==TRUE) {
+         neighbors_vars.neighbors[i].numTxACK++;
+         memcpy(&neighbors_vars.neighbors[i].asn,asnTs,sizeof(asn_t));
       }
    }
 }
@@ -445,23 +430,19 @@ void neighbors_indicateRxDIO(OpenQueueEntry_t* msg) {
    // retrieve rank
    temp_8b            = *(msg->payload+2);
    neighbors_vars.dio->rank = (temp_8b << 8) + *(msg->payload+3);
-   if (isNeighbor(&(msg->l2_nextORpreviousHop))==TRUE) {
-      for (i=0;i<MAXNUMNEIGHBORS;i++) {
-         if (isThisRowMatching(&(msg->l2_nextORpreviousHop),i)) {
-            if (
-                  neighbors_vars.dio->rank > neighbors_vars.neighbors[i].DAGrank &&
-                  neighbors_vars.dio->rank - neighbors_vars.neighbors[i].DAGrank >(DEFAULTLINKCOST*2*MINHOPRANKINCREASE)
-               ) {
-                // the new DAGrank looks suspiciously high, only increment a bit
-                neighbors_vars.neighbors[i].DAGrank += (DEFAULTLINKCOST*2*MINHOPRANKINCREASE);
-                openserial_printError(COMPONENT_NEIGHBORS,ERR_LARGE_DAGRANK,
-                               (errorparameter_t)neighbors_vars.dio->rank,
-                               (errorparameter_t)neighbors_vars.neighbors[i].DAGrank);
-            } else {
-               neighbors_vars.neighbors[i].DAGrank = neighbors_vars.dio->rank;
-            }
-            break;
-         }
+   i = getNeighborRow(&(msg->l2_nextORpreviousHop));
+   if (i!=NEIGHBORS_NONE) {
+      if (
+            neighbors_vars.dio->rank > neighbors_vars.neighbors[i].DAGrank &&
+            neighbors_vars.dio->rank - neighbors_vars.neighbors[i].DAGrank >(DEFAULTLINKCOST*2*MINHOPRANKINCREASE)
+         ) {
+          // the new DAGrank looks suspiciously high, only increment a bit
+          neighbors_vars.neighbors[i].DAGrank += (DEFAULTLINKCOST*2*MINHOPRANKINCREASE);
+          openserial_printError(COMPONENT_NEIGHBORS,ERR_LARGE_DAGRANK,
+                         (errorparameter_t)neighbors_vars.dio->rank,
+                         (errorparameter_t)neighbors_vars.neighbors[i].DAGrank);
+      } else {
+         neighbors_vars.neighbors[i].DAGrank = neighbors_vars.dio->rank;
       }
    } 
    // update my routing information
@@ -503,6 +484,9 @@ routing decisions to change. Examples are:
 - I received a DIO which updated by neighbor table. If this DIO indicated a
   very low DAGrank, I may want to change by routing parent.
 - I became a DAGroot, so my DAGrank should be 0.
+
+A change of preferred parent or of DAGRank (i.e. rank/MINHOPRANKINCREASE)
+resets the DIO Trickle timer, so neighbors learn about it promptly.
 */
 void neighbors_updateMyDAGrankAndNeighborPreference() {
    uint8_t   i;
@@ -510,15 +494,21 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
    uint32_t  tentativeDAGrank; // 32-bit since is used to sum
    uint8_t   prefParentIdx;
    bool      prefParentFound;
-   uint32_t  rankIncreaseIntermediary; // stores intermediary results of rankIncrease calculation
+   uint32_t  rankIncreaseIntermediary; // stores intermediary results of rankIncrease calculation
+   dagrank_t oldDAGrank;
+   uint8_t   oldPrefParentIdx;
    
    // if I'm a DAGroot, my DAGrank is always MINHOPRANKINCREASE
    if ((idmanager_getIsDAGroot())==TRUE) {
        // the dagrank is not set through setting command, set rank to MINHOPRANKINCREASE here 
        neighbors_vars.myDAGrank=MINHOPRANKINCREASE;
-       return;
+       return;
    }
    
+   // remember the current routing state
+   oldDAGrank                = neighbors_vars.myDAGrank;
+   oldPrefParentIdx          = NEIGHBORS_NONE;
+   
    // reset my DAG rank to max value. May be lowered below.
    neighbors_vars.myDAGrank  = MAXDAGRANK;
    
@@ -531,6 +521,9 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
       if (neighbors_vars.neighbors[i].used==TRUE) {
          
          // reset parent preference
+         if (neighbors_vars.neighbors[i].parentPreference==MAXPREFERENCE) {
+            oldPrefParentIdx = i;
+         }
          neighbors_vars.neighbors[i].parentPreference=0;
          
          // calculate link cost to this neighbor
@@ -538,9 +531,9 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
             rankIncrease = DEFAULTLINKCOST*2*MINHOPRANKINCREASE;
          } else {
             //6TiSCH minimal draft using OF0 for rank computation
-            rankIncreaseIntermediary = (((uint32_t)neighbors_vars.neighbors[i].numTx) << 10);
-            rankIncreaseIntermediary = (rankIncreaseIntermediary * 2 * MINHOPRANKINCREASE) / ((uint32_t)neighbors_vars.neighbors[i].numTxACK);
-            rankIncrease = (uint16_t)(rankIncreaseIntermediary >> 10);
+            rankIncreaseIntermediary = (((uint32_t)neighbors_vars.neighbors[i].numTx) << 10);
+            rankIncreaseIntermediary = (rankIncreaseIntermediary * 2 * MINHOPRANKINCREASE) / ((uint32_t)neighbors_vars.neighbors[i].numTxACK);
+            rankIncrease = (uint16_t)(rankIncreaseIntermediary >> 10);
          }
          
          tentativeDAGrank = neighbors_vars.neighbors[i].DAGrank+rankIncrease;
@@ -559,6 +552,21 @@ void neighbors_updateMyDAGrankAndNeighborPreference() {
       neighbors_vars.neighbors[prefParentIdx].parentPreference       = MAXPREFERENCE;
       neighbors_vars.neighbors[prefParentIdx].stableNeighbor         = TRUE;
       neighbors_vars.neighbors[prefParentIdx].switchStabilityCounter = 0;
+   } else {
+      prefParentIdx = NEIGHBORS_NONE;
+   }
+   
+   // my DIOs are inconsistent with what neighbors last heard
+   if (
+         prefParentIdx!=oldPrefParentIdx ||
+         neighbors_vars.myDAGrank/MINHOPRANKINCREASE!=oldDAGrank/MINHOPRANKINCREASE
+      ) {
+      icmpv6rpl_resetDIOTrickle();
+   }
+   
+   // my DAO is outdated, report my new parent
+   if (prefParentIdx!=oldPrefParentIdx && prefParentIdx!=NEIGHBORS_NONE) {
+      icmpv6rpl_triggerDAO();
    }
 }
 
@@ -590,11 +598,18 @@ status information about several modules in the OpenWSN stack.
 */
 bool debugPrint_neighbors() {
    debugNeighborEntry_t temp;
-   neighbors_vars.debugRow=(neighbors_vars.debugRow+1)%MAXNUMNEIGHBORS;
-   temp.row=neighbors_vars.debugRow;
-   temp.neighborEntry=neighbors_vars.neighbors[neighbors_vars.debugRow];
-   openserial_printStatus(STATUS_NEIGHBORS,(uint8_t*)&temp,sizeof(debugNeighborEntry_t));
-   return TRUE;
+   uint8_t              i;
+   // print the next row which changed since it was last printed
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      neighbors_vars.debugRow=(neighbors_vars.debugRow+1)%MAXNUMNEIGHBORS;
+      temp.row=neighbors_vars.debugRow;
+      temp.neighborEntry=neighbors_vars.neighbors[neighbors_vars.debugRow];
+      if (openserial_printStatusRowOnChange(STATUS_NEIGHBORS,(uint8_t*)&temp,sizeof(debugNeighborEntry_t),
+                                            &neighbors_vars.debugDigest[neighbors_vars.debugRow])==TRUE) {
+         return TRUE;
+      }
+   }
+   return FALSE;
 }
 
 //=========================== private =========================================
@@ -626,6 +641,10 @@ void registerNewNeighbor(open_addr_t* address,
             neighbors_vars.neighbors[i].stableNeighbor         = TRUE;
             neighbors_vars.neighbors[i].switchStabilityCounter = 0;
             memcpy(&neighbors_vars.neighbors[i].addr_64b,address,sizeof(open_addr_t));
+            // index this row by its address
+            j = neighborHash(address);
+            neighbors_vars.hashNext[i]                         = neighbors_vars.hashHead[j];
+            neighbors_vars.hashHead[j]                         = i;
             neighbors_vars.neighbors[i].DAGrank                = DEFAULTDAGRANK;
             neighbors_vars.neighbors[i].rssi                   = rssi;
             neighbors_vars.neighbors[i].numRx                  = 1;
@@ -662,16 +681,24 @@ void registerNewNeighbor(open_addr_t* address,
 }
 
 bool isNeighbor(open_addr_t* neighbor) {
-   uint8_t i=0;
-   for (i=0;i<MAXNUMNEIGHBORS;i++) {
-      if (isThisRowMatching(neighbor,i)) {
-         return TRUE;
-      }
-   }
-   return FALSE;
+   return getNeighborRow(neighbor)!=NEIGHBORS_NONE;
 }
 
 void removeNeighbor(uint8_t neighborIndex) {
+   uint8_t* link;
+   
+   // unlink the row from its hash chain
+   if (neighbors_vars.neighbors[neighborIndex].used==TRUE) {
+      link = &neighbors_vars.hashHead[neighborHash(&neighbors_vars.neighbors[neighborIndex].addr_64b)];
+      while (*link!=NEIGHBORS_NONE && *link!=neighborIndex) {
+         link = &neighbors_vars.hashNext[*link];
+      }
+      if (*link==neighborIndex) {
+         *link = neighbors_vars.hashNext[neighborIndex];
+      }
+      neighbors_vars.hashNext[neighborIndex] = NEIGHBORS_NONE;
+   }
+   
    neighbors_vars.neighbors[neighborIndex].used                      = FALSE;
    neighbors_vars.neighbors[neighborIndex].parentPreference          = 0;
    neighbors_vars.neighbors[neighborIndex].stableNeighbor            = FALSE;
@@ -691,6 +718,46 @@ void removeNeighbor(uint8_t neighborIndex) {
 
 //=========================== helpers =========================================
 
+/**
+\brief Find the row of a neighbor in the neighbor table.
+
+Only the rows in the hash bucket of that address are compared, so the cost of
+a lookup does not grow with MAXNUMNEIGHBORS.
+
+\param[in] address The EUI64 address of the neighbor.
+
+\returns The index of that neighbor's row, or NEIGHBORS_NONE if it is not in
+   the neighbor table.
+*/
+uint8_t getNeighborRow(open_addr_t* address) {
+   uint8_t i;
+   
+   if (address->type!=ADDR_64B) {
+      openserial_printCritical(COMPONENT_NEIGHBORS,ERR_WRONG_ADDR_TYPE,
+                            (errorparameter_t)address->type,
+                            (errorparameter_t)3);
+      return NEIGHBORS_NONE;
+   }
+   
+   i = neighbors_vars.hashHead[neighborHash(address)];
+   while (i!=NEIGHBORS_NONE) {
+      if (isThisRowMatching(address,i)) {
+         return i;
+      }
+      i = neighbors_vars.hashNext[i];
+   }
+   return NEIGHBORS_NONE;
+}
+
+/**
+\brief Hash bucket of an EUI64 address.
+
+EUI64s of motes in a deployment typically only differ in their last bytes.
+*/
+uint8_t neighborHash(open_addr_t* address) {
+   return (address->addr_64b[6]^address->addr_64b[7])&(NEIGHBORS_HASHSIZE-1);
+}
+
 bool isThisRowMatching(open_addr_t* address, uint8_t rowNumber) {
    switch (address->type) {
       case ADDR_64B:
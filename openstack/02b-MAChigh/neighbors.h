@@ -12,7 +12,11 @@
 
 //=========================== define ==========================================
 
+#ifndef MAXNUMNEIGHBORS
 #define MAXNUMNEIGHBORS           10
+#endif
+#define NEIGHBORS_HASHSIZE        16   // number of hash buckets, power of 2
+#define NEIGHBORS_NONE            0xff // end of a hash chain
 #define MAXPREFERENCE             2
 #define BADNEIGHBORMAXRSSI        -80 //dBm
 #define GOODNEIGHBORMINRSSI       -90 //dBm
@@ -64,8 +68,11 @@ END_PACK
    
 typedef struct {
    neighborRow_t        neighbors[MAXNUMNEIGHBORS];
+   uint8_t              hashHead[NEIGHBORS_HASHSIZE]; // first row of each bucket
+   uint8_t              hashNext[MAXNUMNEIGHBORS];    // next row in the same bucket
    dagrank_t            myDAGrank;
    uint8_t              debugRow;
+   uint16_t             debugDigest[MAXNUMNEIGHBORS]; // of each row, when last printed
    icmpv6rpl_dio_ht*    dio; //keep it global to be able to debug correctly.
 } neighbors_vars_t;
 
@@ -112,43 +112,89 @@ port_INLINE uint8_t processIE_prependSlotframeLinkIE(OpenQueueEntry_t* pkt){
    slotOffset_t      slotOffset;
    slotOffset_t      lastSlotOffset;
    frameLength_t     frameLength;
+   uint8_t           frameHandle;
+   uint8_t           numLinks;
+   uint8_t           i;
+   open_addr_t       anycast;
+   scheduleEntry_t*  scheduleWalker;
+   
+   INTERRUPT_DECLARATION();
   
    len            = 0;
    linkOption     = 0;
    lastSlotOffset = SCHEDULE_MINIMAL_6TISCH_SLOTOFFSET + SCHEDULE_MINIMAL_6TISCH_ACTIVE_CELLS;
    
-   // for each link in the default schedule, add:
-   // - [1B] linkOption bitmap
-   // - [2B] channel offset
-   // - [2B] timeslot
- 
-   //===== shared cells
-   
-   linkOption = (1<<FLAG_TX_S)|(1<<FLAG_RX_S)|(1<<FLAG_SHARED_S)|(1<<FLAG_TIMEKEEPING_S);
-   for (slotOffset=lastSlotOffset;slotOffset>SCHEDULE_MINIMAL_6TISCH_SLOTOFFSET;slotOffset--) {
-      packetfunctions_reserveHeaderSize(pkt,5);
-      pkt->payload[0]   = (slotOffset-1)        & 0xFF;
-      pkt->payload[1]   = ((slotOffset-1) >> 8) & 0xFF;
-      pkt->payload[2]   = SCHEDULE_MINIMAL_6TISCH_CHANNELOFFSET;     // channel offset
-      pkt->payload[3]   = 0x00;
-      pkt->payload[4]   = linkOption;                          // linkOption
-      len+=5;
+   memset(&anycast,0,sizeof(open_addr_t));
+   anycast.type   = ADDR_ANYCAST;
+   
+   // for each slotframe, last one first, add its links, then its header
+   i = schedule_getFrameNumber();
+   while (i>0) {
+      i--;
+      schedule_getSlotframeInfo(i,&frameHandle,&frameLength);
+      
+      // for each link, add:
+      // - [1B] linkOption bitmap
+      // - [2B] channel offset
+      // - [2B] timeslot
+      
+      numLinks    = 0;
+      linkOption  = (1<<FLAG_TX_S)|(1<<FLAG_RX_S)|(1<<FLAG_SHARED_S);
+      if (i==0) {
+         //===== shared cells of the minimal schedule
+         
+         linkOption |= (1<<FLAG_TIMEKEEPING_S);
+         for (slotOffset=lastSlotOffset;slotOffset>SCHEDULE_MINIMAL_6TISCH_SLOTOFFSET;slotOffset--) {
+            packetfunctions_reserveHeaderSize(pkt,5);
+            pkt->payload[0]   = (slotOffset-1)        & 0xFF;
+            pkt->payload[1]   = ((slotOffset-1) >> 8) & 0xFF;
+            pkt->payload[2]   = SCHEDULE_MINIMAL_6TISCH_CHANNELOFFSET;     // channel offset
+            pkt->payload[3]   = 0x00;
+            pkt->payload[4]   = linkOption;                          // linkOption
+            len+=5;
+            numLinks++;
+         }
+      } else {
+         //===== shared cells of the other slotframes
+         
+         DISABLE_INTERRUPTS();
+         scheduleWalker = schedule_getNextNeighborCell(&anycast,NULL);
+         while (scheduleWalker!=NULL) {
+            if (scheduleWalker->slotframeHandle==frameHandle) {
+               packetfunctions_reserveHeaderSize(pkt,5);
+               pkt->payload[0]   =  scheduleWalker->slotOffset       & 0xFF;
+               pkt->payload[1]   = (scheduleWalker->slotOffset >> 8) & 0xFF;
+               pkt->payload[2]   =  scheduleWalker->channelOffset;  // channel offset
+               pkt->payload[3]   = 0x00;
+               pkt->payload[4]   = linkOption;                      // linkOption
+               len+=5;
+               numLinks++;
+            }
+            scheduleWalker = schedule_getNextNeighborCell(&anycast,scheduleWalker);
+         }
+         ENABLE_INTERRUPTS();
+      }
+      
+      //===== slotframe header
+      
+      // - [1B] slotframe handle (id)
+      // - [2B] Slotframe Size (101)
+      // - [1B] number of links (6)
+      packetfunctions_reserveHeaderSize(pkt,4);
+      pkt->payload[0] = frameHandle;
+      pkt->payload[1] =  frameLength       & 0xFF;
+      pkt->payload[2] = (frameLength >> 8) & 0xFF;
+      pkt->payload[3] = numLinks;                              //number of links
+      len+=4;
    }
    
    //===== slotframe IE header
    
-   // - [1B] number of links (6)
-   // - [2B] Slotframe Size (101)
-   // - [1B] slotframe handle (id)
-   frameLength = schedule_getFrameLength();
-   packetfunctions_reserveHeaderSize(pkt,5);
-   pkt->payload[0] = schedule_getFrameNumber();  
-   pkt->payload[1] = schedule_getFrameHandle();
-   pkt->payload[2] =  frameLength       & 0xFF;
-   pkt->payload[3] = (frameLength >> 8) & 0xFF;
-   pkt->payload[4] = SCHEDULE_MINIMAL_6TISCH_ACTIVE_CELLS; //number of links
+   // - [1B] number of slotframes
+   packetfunctions_reserveHeaderSize(pkt,1);
+   pkt->payload[0] = schedule_getFrameNumber();
   
-   len+=5;
+   len+=1;
    
    //===== MLME IE header
    // - [1b] 15 short ==0x00
@@ -363,14 +409,13 @@ port_INLINE void processIE_retrieveSlotframeLinkIE(
    cellInfo_ht          linkInfo;
    open_addr_t          temp_neighbor;
    frameLength_t        oldFrameLength;
+   bool                 addLinks;
    
    localptr = *ptr; 
   
    // number of slot frames 1B
    numSlotFrames = *((uint8_t*)(pkt->payload)+localptr);
    localptr++;
-   
-   schedule_setFrameNumber(numSlotFrames);
 
    // for each slotframe
    i=0;
@@ -380,55 +425,62 @@ port_INLINE void processIE_retrieveSlotframeLinkIE(
       sfInfo.slotframehandle =*((uint8_t*)(pkt->payload)+localptr);
       localptr++;
       
-      schedule_setFrameHandle(sfInfo.slotframehandle);
-      
       // [2B] slotframe size
       sfInfo.slotframesize   = *((uint8_t*)(pkt->payload)+localptr);
       localptr++;
       sfInfo.slotframesize  |= (*((uint8_t*)(pkt->payload)+localptr))<<8;
       localptr++;;
       
-      oldFrameLength = schedule_getFrameLength();
-      schedule_setFrameLength(sfInfo.slotframesize);
-      
       // [1B] number of links
       sfInfo.numlinks        = *((uint8_t*)(pkt->payload)+localptr);
       localptr++;
       
-      if (oldFrameLength == 0) {
+      if (i==0) {
+         // the first slotframe is the minimal one
+         oldFrameLength = schedule_getFrameLength();
+         schedule_setFrameHandle(sfInfo.slotframehandle);
+         schedule_setFrameLength(sfInfo.slotframesize);
+         addLinks = (oldFrameLength == 0);
+      } else {
+         // the others are only installed once
+         addLinks = (schedule_addSlotframe(sfInfo.slotframehandle,sfInfo.slotframesize)==E_SUCCESS);
+      }
+      
+      for (j=0;j<sfInfo.numlinks;j++){
+         
+         // [2B] TimeSlot
+         linkInfo.tsNum = *((uint8_t*)(pkt->payload)+localptr);
+         localptr++;
+         linkInfo.tsNum  |= (*((uint8_t*)(pkt->payload)+localptr))<<8;
+         localptr++;
+         
+         // [2B] Ch.Offset
+         linkInfo.choffset = *((uint8_t*)(pkt->payload)+localptr);
+         localptr++;
+         linkInfo.choffset  |= (*((uint8_t*)(pkt->payload)+localptr))<<8;
+         localptr++;
          
-         for (j=0;j<sfInfo.numlinks;j++){
-            
-            // [2B] TimeSlot
-            linkInfo.tsNum = *((uint8_t*)(pkt->payload)+localptr);
-            localptr++;
-            linkInfo.tsNum  |= (*((uint8_t*)(pkt->payload)+localptr))<<8;
-            localptr++;
-            
-            // [2B] Ch.Offset
-            linkInfo.choffset = *((uint8_t*)(pkt->payload)+localptr);
-            localptr++;
-            linkInfo.choffset  |= (*((uint8_t*)(pkt->payload)+localptr))<<8;
-            localptr++;
-            
-            // [1B] LinkOption bitmap
-            linkInfo.linkoptions = *((uint8_t*)(pkt->payload)+localptr);
-            localptr++;
-            
-            // shared TXRX anycast slot(s)
-            memset(&temp_neighbor,0,sizeof(temp_neighbor));
-            temp_neighbor.type             = ADDR_ANYCAST;
-            schedule_addActiveSlot(
-               linkInfo.tsNum,                     // slot offset
-               CELLTYPE_TXRX,                      // type of slot
-               TRUE,                               // shared?
-               linkInfo.choffset,                  // channel offset
-               &temp_neighbor                      // neighbor
-            );
+         // [1B] LinkOption bitmap
+         linkInfo.linkoptions = *((uint8_t*)(pkt->payload)+localptr);
+         localptr++;
+         
+         if (addLinks==FALSE) {
+            continue;
          }
+         
+         // shared TXRX anycast slot(s)
+         memset(&temp_neighbor,0,sizeof(temp_neighbor));
+         temp_neighbor.type             = ADDR_ANYCAST;
+         schedule_addActiveSlot(
+            sfInfo.slotframehandle,             // slotframe
+            linkInfo.tsNum,                     // slot offset
+            CELLTYPE_TXRX,                      // type of slot
+            TRUE,                               // shared?
+            linkInfo.choffset,                  // channel offset
+            &temp_neighbor                      // neighbor
+         );
       }
       i++;
-      break; //TODO: this break is put since a single slotframe is managed
    }
    
    *ptr=localptr;
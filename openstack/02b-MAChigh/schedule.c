@@ -13,6 +13,11 @@ schedule_vars_t schedule_vars;
 //=========================== prototypes ======================================
 
 void schedule_resetEntry(scheduleEntry_t* pScheduleEntry);
+uint8_t schedule_neighborBucket(open_addr_t* neighbor);
+slotframeEntry_t* schedule_getSlotframe(uint8_t frameHandle);
+slotOffset_t schedule_asnToSlotOffset(asn_t* asn, frameLength_t frameLength);
+frameLength_t schedule_slotsToNextCell(slotframeEntry_t* slotframe);
+void schedule_selectCurrentEntry(void);
 
 //=========================== public ==========================================
 
@@ -36,6 +41,10 @@ void schedule_init() {
    schedule_vars.backoffExponent = MINBE-1;
    schedule_vars.maxActiveSlots = MAXACTIVESLOTS;
    
+   // the minimal slotframe always exists, its length is set when joining
+   schedule_vars.numSlotframes   = 1;
+   schedule_vars.slotframes[0].frameHandle = SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE;
+   
    start_slotOffset = SCHEDULE_MINIMAL_6TISCH_SLOTOFFSET;
    if (idmanager_getIsDAGroot()==TRUE) {
       schedule_startDAGroot();
@@ -46,6 +55,7 @@ void schedule_init() {
    memset(&temp_neighbor,0,sizeof(temp_neighbor));
    for (running_slotOffset=start_slotOffset;running_slotOffset<start_slotOffset+NUMSERIALRX;running_slotOffset++) {
       schedule_addActiveSlot(
+         schedule_vars.slotframes[0].frameHandle, // slotframe
          running_slotOffset,                    // slot offset
          CELLTYPE_SERIALRX,                     // type of slot
          FALSE,                                 // shared?
@@ -64,21 +74,21 @@ void schedule_startDAGroot() {
    open_addr_t     temp_neighbor;
    
    start_slotOffset = SCHEDULE_MINIMAL_6TISCH_SLOTOFFSET;
-   // set frame length, handle and number (default 1 by now)
-   if (schedule_vars.frameLength == 0) {
+   // set frame length and handle
+   if (schedule_vars.slotframes[0].frameLength == 0) {
        // slotframe length is not set, set it to default length
        schedule_setFrameLength(SLOTFRAME_LENGTH);
    } else {
        // slotframe elgnth is set, nothing to do here
    }
    schedule_setFrameHandle(SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE);
-   schedule_setFrameNumber(SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_NUMBER);
 
    // shared TXRX anycast slot(s)
    memset(&temp_neighbor,0,sizeof(temp_neighbor));
    temp_neighbor.type             = ADDR_ANYCAST;
    for (running_slotOffset=start_slotOffset;running_slotOffset<start_slotOffset+SCHEDULE_MINIMAL_6TISCH_ACTIVE_CELLS;running_slotOffset++) {
       schedule_addActiveSlot(
+         SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE, // slotframe
          running_slotOffset,                 // slot offset
          CELLTYPE_TXRX,                      // type of slot
          TRUE,                               // shared?
@@ -98,45 +108,54 @@ status information about several modules in the OpenWSN stack.
 */
 bool debugPrint_schedule() {
    debugScheduleEntry_t temp;
+   uint8_t              i;
    
-   // increment the row just printed
-   schedule_vars.debugPrintRow         = (schedule_vars.debugPrintRow+1)%schedule_vars.maxActiveSlots;
-   
-   // gather status data
-   temp.row                            = schedule_vars.debugPrintRow;
-   temp.slotOffset                     = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].slotOffset;
-   temp.type                           = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].type;
-   temp.shared                         = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].shared;
-   temp.channelOffset                  = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].channelOffset;
-   memcpy(
-      &temp.neighbor,
-      &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].neighbor,
-      sizeof(open_addr_t)
-   );
-   temp.numRx                          = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numRx;
-   temp.numTx                          = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTx;
-   temp.numTxACK                       = \
-      schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTxACK;
-   memcpy(
-      &temp.lastUsedAsn,
-      &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].lastUsedAsn,
-      sizeof(asn_t)
-   );
-   
-   // send status data over serial port
-   openserial_printStatus(
-      STATUS_SCHEDULE,
-      (uint8_t*)&temp,
-      sizeof(debugScheduleEntry_t)
-   );
+   // print the next row which changed since it was last printed
+   for (i=0;i<schedule_vars.maxActiveSlots;i++) {
+      // increment the row just printed
+      schedule_vars.debugPrintRow         = (schedule_vars.debugPrintRow+1)%schedule_vars.maxActiveSlots;
+      
+      // gather status data
+      temp.row                            = schedule_vars.debugPrintRow;
+      temp.slotOffset                     = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].slotOffset;
+      temp.type                           = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].type;
+      temp.shared                         = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].shared;
+      temp.channelOffset                  = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].channelOffset;
+      memcpy(
+         &temp.neighbor,
+         &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].neighbor,
+         sizeof(open_addr_t)
+      );
+      temp.numRx                          = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numRx;
+      temp.numTx                          = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTx;
+      temp.numTxACK                       = \
+         schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].numTxACK;
+      memcpy(
+         &temp.lastUsedAsn,
+         &schedule_vars.scheduleBuf[schedule_vars.debugPrintRow].lastUsedAsn,
+         sizeof(asn_t)
+      );
+      
+      // send status data over serial port
+      if (
+         openserial_printStatusRowOnChange(
+            STATUS_SCHEDULE,
+            (uint8_t*)&temp,
+            sizeof(debugScheduleEntry_t),
+            &schedule_vars.debugDigest[schedule_vars.debugPrintRow]
+         )==TRUE
+      ) {
+         return TRUE;
+      }
+   }
    
-   return TRUE;
+   return FALSE;
 }
 
 /**
@@ -155,19 +174,17 @@ bool debugPrint_backoff() {
    temp[1] = schedule_vars.backoff;
    
    // send status data over serial port
-   openserial_printStatus(
+   return openserial_printStatusOnChange(
       STATUS_BACKOFF,
       (uint8_t*)&temp,
       sizeof(temp)
    );
-   
-   return TRUE;
 }
 
 //=== from 6top (writing the schedule)
 
 /**
-\brief Set frame length.
+\brief Set the length of the minimal slotframe.
 
 \param newFrameLength The new frame length.
 */
@@ -176,7 +193,7 @@ void schedule_setFrameLength(frameLength_t newFrameLength) {
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   schedule_vars.frameLength = newFrameLength;
+   schedule_vars.slotframes[0].frameLength = newFrameLength;
    if (newFrameLength <= MAXACTIVESLOTS) {
       schedule_vars.maxActiveSlots = newFrameLength;
    }
@@ -184,31 +201,96 @@ void schedule_setFrameLength(frameLength_t newFrameLength) {
 }
 
 /**
-\brief Set frame handle.
+\brief Set the handle of the minimal slotframe.
+
+The cells already in that slotframe follow.
 
 \param frameHandle The new frame handle.
 */
 void schedule_setFrameHandle(uint8_t frameHandle) {
+   uint8_t i;
+   
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   for (i=0;i<MAXACTIVESLOTS;i++) {
+      if (
+            schedule_vars.scheduleBuf[i].type!=CELLTYPE_OFF &&
+            schedule_vars.scheduleBuf[i].slotframeHandle==schedule_vars.slotframes[0].frameHandle
+         ) {
+         schedule_vars.scheduleBuf[i].slotframeHandle = frameHandle;
+      }
+   }
+   schedule_vars.slotframes[0].frameHandle = frameHandle;
+   
+   ENABLE_INTERRUPTS();
+}
+
+/**
+\brief Add a slotframe, running next to the minimal one.
+
+The new slotframe starts empty; add cells to it with schedule_addActiveSlot().
+When cells of several slotframes fall on the same ASN, the cell of the
+slotframe with the lowest handle is used.
+
+\param frameHandle The handle of the new slotframe.
+\param frameLength The length of the new slotframe, in slots.
+
+\returns E_SUCCESS if the slotframe was added, E_FAIL if it already exists or
+   MAXSLOTFRAMES is reached.
+*/
+owerror_t schedule_addSlotframe(uint8_t frameHandle, frameLength_t frameLength) {
+   slotframeEntry_t* slotframe;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   schedule_vars.frameHandle = frameHandle;
+   if (schedule_getSlotframe(frameHandle)!=NULL) {
+      // already installed
+      ENABLE_INTERRUPTS();
+      return E_FAIL;
+   }
+   
+   if (frameLength==0 || schedule_vars.numSlotframes==MAXSLOTFRAMES) {
+      ENABLE_INTERRUPTS();
+      openserial_printError(
+         COMPONENT_SCHEDULE,ERR_INVALID_PARAM,
+         (errorparameter_t)frameHandle,
+         (errorparameter_t)frameLength
+      );
+      return E_FAIL;
+   }
+   
+   slotframe                = &schedule_vars.slotframes[schedule_vars.numSlotframes];
+   memset(slotframe,0,sizeof(slotframeEntry_t));
+   slotframe->frameHandle   = frameHandle;
+   slotframe->frameLength   = frameLength;
+   slotframe->slotOffset    = schedule_asnToSlotOffset(&schedule_vars.asn,frameLength);
+   schedule_vars.numSlotframes++;
    
    ENABLE_INTERRUPTS();
+   return E_SUCCESS;
 }
 
 /**
-\brief Set frame number.
+\brief Get the handle and length of a slotframe.
 
-\param frameNumber The new frame number.
+\param index       Index of the slotframe, below schedule_getFrameNumber(). The
+   minimal slotframe has index 0.
+\param frameHandle Where to write the handle of the slotframe.
+\param frameLength Where to write the length of the slotframe.
 */
-void schedule_setFrameNumber(uint8_t frameNumber) {
+void schedule_getSlotframeInfo(
+      uint8_t        index,
+      uint8_t*       frameHandle,
+      frameLength_t* frameLength
+   ) {
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   schedule_vars.frameNumber = frameNumber;
+   *frameHandle = schedule_vars.slotframes[index].frameHandle;
+   *frameLength = schedule_vars.slotframes[index].frameLength;
    
    ENABLE_INTERRUPTS();
 }
@@ -221,6 +303,7 @@ void schedule_setFrameNumber(uint8_t frameNumber) {
 \param info
 */
 void  schedule_getSlotInfo(
+   uint8_t              slotframeHandle,
    slotOffset_t         slotOffset,
    open_addr_t*         neighbor,
    slotinfo_element_t*  info
@@ -228,18 +311,18 @@ void  schedule_getSlotInfo(
    
    scheduleEntry_t* slotContainer;
   
-   // find an empty schedule entry container
-   slotContainer = &schedule_vars.scheduleBuf[0];
-   while (slotContainer<=&schedule_vars.scheduleBuf[schedule_vars.maxActiveSlots-1]) {
+   // only walk the cells of that neighbor
+   slotContainer = schedule_getNextNeighborCell(neighbor,NULL);
+   while (slotContainer!=NULL) {
        //check that this entry for that neighbour and timeslot is not already scheduled.
-       if (packetfunctions_sameAddress(neighbor,&(slotContainer->neighbor))&& (slotContainer->slotOffset==slotOffset)){
+       if (slotContainer->slotOffset==slotOffset && slotContainer->slotframeHandle==slotframeHandle){
                //it exists so this is an update.
                info->link_type                 = slotContainer->type;
                info->shared                    =slotContainer->shared;
                info->channelOffset             = slotContainer->channelOffset;
                return; //as this is an update. No need to re-insert as it is in the same position on the list.
         }
-        slotContainer++;
+        slotContainer = schedule_getNextNeighborCell(neighbor,slotContainer);
    }
    //return cell type off.
    info->link_type                 = CELLTYPE_OFF;
@@ -259,6 +342,7 @@ uint16_t  schedule_getMaxActiveSlots() {
 /**
 \brief Add a new active slot into the schedule.
 
+\param slotframeHandle  The slotframe to add the slot to
 \param slotOffset       The slotoffset of the new slot
 \param type             The type of the cell
 \param shared           Whether this cell is shared (TRUE) or not (FALSE).
@@ -267,19 +351,36 @@ uint16_t  schedule_getMaxActiveSlots() {
    none)
 */
 owerror_t schedule_addActiveSlot(
+      uint8_t         slotframeHandle,
       slotOffset_t    slotOffset,
       cellType_t      type,
       bool            shared,
       channelOffset_t channelOffset,
       open_addr_t*    neighbor
    ) {
+   slotframeEntry_t* slotframe;
    scheduleEntry_t* slotContainer;
    scheduleEntry_t* previousSlotWalker;
    scheduleEntry_t* nextSlotWalker;
+   uint32_t         distanceToCell;
+   uint32_t         distanceToCurrent;
+   uint8_t          bucket;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
+   // find the slotframe
+   slotframe = schedule_getSlotframe(slotframeHandle);
+   if (slotframe==NULL) {
+      ENABLE_INTERRUPTS();
+      openserial_printError(
+         COMPONENT_SCHEDULE,ERR_INVALID_PARAM,
+         (errorparameter_t)slotframeHandle,
+         (errorparameter_t)slotOffset
+      );
+      return E_FAIL;
+   }
+   
    // find an empty schedule entry container
    slotContainer = &schedule_vars.scheduleBuf[0];
    while (
@@ -306,21 +407,35 @@ owerror_t schedule_addActiveSlot(
    slotContainer->shared                    = shared;
    slotContainer->channelOffset             = channelOffset;
    memcpy(&slotContainer->neighbor,neighbor,sizeof(open_addr_t));
+   slotContainer->slotframeHandle           = slotframeHandle;
+   
+   // mark slot offset as occupied
+   if (slotOffset<SCHEDULE_BITMAP_SLOTS) {
+      slotframe->occupied[slotOffset/8] |= 1<<(slotOffset%8);
+   }
    
-   // insert in circular list
-   if (schedule_vars.currentScheduleEntry==NULL) {
+   // index by neighbor
+   bucket                                   = schedule_neighborBucket(neighbor);
+   slotContainer->nextNeighborCell          = schedule_vars.neighborCells[bucket];
+   schedule_vars.neighborCells[bucket]      = slotContainer;
+   
+   // insert in the circular list of the slotframe
+   if (slotframe->currentEntry==NULL) {
       // this is the first active slot added
       
       // the next slot of this slot is this slot
       slotContainer->next                   = slotContainer;
       
       // current slot points to this slot
-      schedule_vars.currentScheduleEntry    = slotContainer;
+      slotframe->currentEntry               = slotContainer;
+      if (schedule_vars.currentScheduleEntry==NULL) {
+         schedule_vars.currentScheduleEntry = slotContainer;
+      }
    } else  {
       // this is NOT the first active slot added
       
       // find position in schedule
-      previousSlotWalker                    = schedule_vars.currentScheduleEntry;
+      previousSlotWalker                    = slotframe->currentEntry;
       while (1) {
          nextSlotWalker                     = previousSlotWalker->next;
          if (
@@ -346,6 +461,19 @@ owerror_t schedule_addActiveSlot(
       // insert between previousSlotWalker and nextSlotWalker
       previousSlotWalker->next              = slotContainer;
       slotContainer->next                   = nextSlotWalker;
+      
+      // keep pointing at the last cell at or before the current slot offset
+      if (
+            slotframe->frameLength>0 &&
+            slotframe->slotOffset<slotframe->frameLength &&
+            slotOffset<slotframe->frameLength
+         ) {
+         distanceToCell     = ((uint32_t)slotOffset+slotframe->frameLength-slotframe->currentEntry->slotOffset)%slotframe->frameLength;
+         distanceToCurrent  = ((uint32_t)slotframe->slotOffset+slotframe->frameLength-slotframe->currentEntry->slotOffset)%slotframe->frameLength;
+         if (distanceToCell>0 && distanceToCell<=distanceToCurrent) {
+            slotframe->currentEntry         = slotContainer;
+         }
+      }
    }
    
    ENABLE_INTERRUPTS();
@@ -355,32 +483,40 @@ owerror_t schedule_addActiveSlot(
 /**
 \brief Remove an active slot from the schedule.
 
+\param slotframeHandle  The slotframe to remove the slot from.
 \param slotOffset       The slotoffset of the slot to remove.
 \param neighbor         The neighbor associated with this cell (all 0's if
    none)
 */
-owerror_t schedule_removeActiveSlot(slotOffset_t slotOffset, open_addr_t* neighbor) {
+owerror_t schedule_removeActiveSlot(
+      uint8_t         slotframeHandle,
+      slotOffset_t    slotOffset,
+      open_addr_t*    neighbor
+   ) {
+   slotframeEntry_t* slotframe;
    scheduleEntry_t* slotContainer;
    scheduleEntry_t* previousSlotWalker;
+   scheduleEntry_t** neighborWalker;
+   scheduleEntry_t* scheduleWalker;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   // find the schedule entry
-   slotContainer = &schedule_vars.scheduleBuf[0];
-   while (slotContainer<=&schedule_vars.scheduleBuf[schedule_vars.maxActiveSlots-1]) {
-      if (
-            slotContainer->slotOffset==slotOffset
-            &&
-            packetfunctions_sameAddress(neighbor,&(slotContainer->neighbor))
-            ){
-         break;
-      }
-      slotContainer++;
+   // find the schedule entry, among the cells of that neighbor
+   slotContainer = schedule_getNextNeighborCell(neighbor,NULL);
+   while (
+         slotContainer!=NULL &&
+         (
+            slotContainer->slotOffset!=slotOffset ||
+            slotContainer->slotframeHandle!=slotframeHandle
+         )
+      ) {
+      slotContainer = schedule_getNextNeighborCell(neighbor,slotContainer);
    }
    
    // abort it could not find
-   if (slotContainer>&schedule_vars.scheduleBuf[schedule_vars.maxActiveSlots-1]) {
+   slotframe = schedule_getSlotframe(slotframeHandle);
+   if (slotContainer==NULL || slotframe==NULL) {
       ENABLE_INTERRUPTS();
       openserial_printCritical(
          COMPONENT_SCHEDULE,ERR_FREEING_ERROR,
@@ -398,12 +534,12 @@ owerror_t schedule_removeActiveSlot(slotOffset_t slotOffset, open_addr_t* neighb
       slotContainer->next                   = NULL;
       
       // current slot points to this slot
-      schedule_vars.currentScheduleEntry    = NULL;
+      slotframe->currentEntry               = NULL;
    } else  {
       // this is NOT the last active slot
       
       // find the previous in the schedule
-      previousSlotWalker                    = schedule_vars.currentScheduleEntry;
+      previousSlotWalker                    = slotframe->currentEntry;
       
       while (1) {
          if (previousSlotWalker->next==slotContainer){
@@ -417,34 +553,82 @@ owerror_t schedule_removeActiveSlot(slotOffset_t slotOffset, open_addr_t* neighb
       previousSlotWalker->next              = slotContainer->next;
       
       // update current slot if points to slot I just removed
-      if (schedule_vars.currentScheduleEntry==slotContainer) {
-         schedule_vars.currentScheduleEntry = slotContainer->next;
+      if (slotframe->currentEntry==slotContainer) {
+         slotframe->currentEntry            = previousSlotWalker;
+      }
+   }
+   if (schedule_vars.currentScheduleEntry==slotContainer) {
+      schedule_vars.currentScheduleEntry    = slotframe->currentEntry;
+      if (schedule_vars.currentScheduleEntry==NULL) {
+         schedule_vars.currentScheduleEntry = schedule_vars.slotframes[0].currentEntry;
       }
    }
    
+   // remove from the neighbor index
+   neighborWalker = &schedule_vars.neighborCells[schedule_neighborBucket(neighbor)];
+   while (*neighborWalker!=slotContainer) {
+      neighborWalker = (scheduleEntry_t**)&((*neighborWalker)->nextNeighborCell);
+   }
+   *neighborWalker = slotContainer->nextNeighborCell;
+   
    // reset removed schedule entry
    schedule_resetEntry(slotContainer);
    
+   // mark slot offset as available, unless another cell of the slotframe
+   // (e.g. to another neighbor) still uses it
+   if (slotOffset<SCHEDULE_BITMAP_SLOTS) {
+      scheduleWalker = slotframe->currentEntry;
+      if (scheduleWalker!=NULL) {
+         do {
+            if (scheduleWalker->slotOffset==slotOffset) {
+               break;
+            }
+            scheduleWalker = scheduleWalker->next;
+         } while (scheduleWalker!=slotframe->currentEntry);
+      }
+      if (scheduleWalker==NULL || scheduleWalker->slotOffset!=slotOffset) {
+         slotframe->occupied[slotOffset/8] &= ~(1<<(slotOffset%8));
+      }
+   }
+   
    ENABLE_INTERRUPTS();
    
    return E_SUCCESS;
 }
 
-bool schedule_isSlotOffsetAvailable(uint16_t slotOffset){
-   
+bool schedule_isSlotOffsetAvailable(uint8_t slotframeHandle, uint16_t slotOffset){
+   slotframeEntry_t* slotframe;
    scheduleEntry_t* scheduleWalker;
+   bool             returnVal;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   scheduleWalker = schedule_vars.currentScheduleEntry;
+   slotframe = schedule_getSlotframe(slotframeHandle);
+   if (slotframe==NULL) {
+      ENABLE_INTERRUPTS();
+      return FALSE;
+   }
+   
+   if (slotOffset<SCHEDULE_BITMAP_SLOTS) {
+      returnVal = (slotframe->occupied[slotOffset/8] & (1<<(slotOffset%8)))==0;
+      ENABLE_INTERRUPTS();
+      return returnVal;
+   }
+   
+   if (slotframe->currentEntry==NULL) {
+      ENABLE_INTERRUPTS();
+      return TRUE;
+   }
+   
+   scheduleWalker = slotframe->currentEntry;
    do {
       if(slotOffset == scheduleWalker->slotOffset){
           ENABLE_INTERRUPTS();
           return FALSE;
       }
       scheduleWalker = scheduleWalker->next;
-   }while(scheduleWalker!=schedule_vars.currentScheduleEntry);
+   }while(scheduleWalker!=slotframe->currentEntry);
    
    ENABLE_INTERRUPTS();
    
@@ -453,28 +637,30 @@ bool schedule_isSlotOffsetAvailable(uint16_t slotOffset){
 
 scheduleEntry_t* schedule_statistic_poorLinkQuality(){
    scheduleEntry_t* scheduleWalker;
+   uint8_t          i;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   scheduleWalker = schedule_vars.currentScheduleEntry;
-   do {
-      if(
-         scheduleWalker->numTx > MIN_NUMTX_FOR_PDR                     &&\
-         PDR_THRESHOLD > 100*scheduleWalker->numTxACK/scheduleWalker->numTx
-      ){
-         break;
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      if (schedule_vars.slotframes[i].currentEntry==NULL) {
+         continue;
       }
-      scheduleWalker = scheduleWalker->next;
-   }while(scheduleWalker!=schedule_vars.currentScheduleEntry);
-   
-   if (scheduleWalker == schedule_vars.currentScheduleEntry){
-       ENABLE_INTERRUPTS();
-       return NULL;
-   } else {
-       ENABLE_INTERRUPTS();
-       return scheduleWalker;
+      scheduleWalker = schedule_vars.slotframes[i].currentEntry;
+      do {
+         if(
+            scheduleWalker->numTx > MIN_NUMTX_FOR_PDR                     &&\
+            PDR_THRESHOLD > 100*scheduleWalker->numTxACK/scheduleWalker->numTx
+         ){
+            ENABLE_INTERRUPTS();
+            return scheduleWalker;
+         }
+         scheduleWalker = scheduleWalker->next;
+      }while(scheduleWalker!=schedule_vars.slotframes[i].currentEntry);
    }
+   
+   ENABLE_INTERRUPTS();
+   return NULL;
 }
 
 uint16_t  schedule_getCellsCounts(uint8_t frameID,cellType_t type, open_addr_t* neighbor){
@@ -483,22 +669,14 @@ uint16_t  schedule_getCellsCounts(uint8_t frameID,cellType_t type, open_addr_t*
    
     INTERRUPT_DECLARATION();
     DISABLE_INTERRUPTS();
-    
-    if (frameID != SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE){
-        ENABLE_INTERRUPTS();
-        return 0;
-    }
    
-    scheduleWalker = schedule_vars.currentScheduleEntry;
-    do {
-       if(
-          packetfunctions_sameAddress(&(scheduleWalker->neighbor),neighbor) &&
-          type == scheduleWalker->type
-       ){
+    scheduleWalker = schedule_getNextNeighborCell(neighbor,NULL);
+    while (scheduleWalker!=NULL) {
+       if(type == scheduleWalker->type && frameID == scheduleWalker->slotframeHandle){
            count++;
        }
-       scheduleWalker = scheduleWalker->next;
-    }while(scheduleWalker!=schedule_vars.currentScheduleEntry);
+       scheduleWalker = schedule_getNextNeighborCell(neighbor,scheduleWalker);
+    }
    
     ENABLE_INTERRUPTS();
     return count;
@@ -511,8 +689,12 @@ void schedule_removeAllCells(
     
     // remove all entries in schedule with previousHop address
     for(i=0;i<MAXACTIVESLOTS;i++){
-        if (packetfunctions_sameAddress(&(schedule_vars.scheduleBuf[i].neighbor),previousHop)){
+        if (
+              schedule_vars.scheduleBuf[i].slotframeHandle==slotframeID &&
+              packetfunctions_sameAddress(&(schedule_vars.scheduleBuf[i].neighbor),previousHop)
+           ){
            schedule_removeActiveSlot(
+              slotframeID,
               schedule_vars.scheduleBuf[i].slotOffset,
               previousHop
            );
@@ -524,16 +706,91 @@ scheduleEntry_t* schedule_getCurrentScheduleEntry(){
     return schedule_vars.currentScheduleEntry;
 }
 
+/**
+\brief Walk the cells scheduled with some neighbor.
+
+Only the cells in the neighbor's bucket of the index are visited.
+
+\note Call this function with interrupts disabled, so cells are not removed
+   while walking.
+
+\param neighbor The neighbor to walk the cells of.
+\param previous The cell returned by the previous call, NULL to get the first
+   cell.
+
+\returns The next cell scheduled with that neighbor, NULL if none is left.
+*/
+scheduleEntry_t* schedule_getNextNeighborCell(
+      open_addr_t*     neighbor,
+      scheduleEntry_t* previous
+   ){
+   scheduleEntry_t* scheduleWalker;
+   
+   if (previous==NULL) {
+      scheduleWalker = schedule_vars.neighborCells[schedule_neighborBucket(neighbor)];
+   } else {
+      scheduleWalker = previous->nextNeighborCell;
+   }
+   while (scheduleWalker!=NULL) {
+      if (packetfunctions_sameAddress(&(scheduleWalker->neighbor),neighbor)) {
+         break;
+      }
+      scheduleWalker = scheduleWalker->nextNeighborCell;
+   }
+   return scheduleWalker;
+}
+
 //=== from IEEE802154E: reading the schedule and updating statistics
 
-void schedule_syncSlotOffset(slotOffset_t targetSlotOffset) {
+/**
+\brief Position every slotframe at an ASN.
+
+Each slotframe points at its last cell at or before the ASN; the current cell
+is that of the slotframe with the lowest handle having a cell at this ASN.
+
+\param asn The ASN to synchronize to.
+*/
+void schedule_syncAsn(asn_t* asn) {
+   slotframeEntry_t* slotframe;
+   scheduleEntry_t* scheduleWalker;
+   scheduleEntry_t* lastCell;
+   scheduleEntry_t* lastCellBefore;
+   uint8_t          i;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   while (schedule_vars.currentScheduleEntry->slotOffset!=targetSlotOffset) {
-      schedule_advanceSlot();
+   memcpy(&schedule_vars.asn,asn,sizeof(asn_t));
+   
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      slotframe = &schedule_vars.slotframes[i];
+      if (slotframe->frameLength==0) {
+         continue;
+      }
+      slotframe->slotOffset = schedule_asnToSlotOffset(asn,slotframe->frameLength);
+      if (slotframe->currentEntry==NULL) {
+         continue;
+      }
+      // find the last cell at or before the slot offset, wrapping around to
+      // the last cell of the slotframe if there is none
+      lastCell       = NULL;
+      lastCellBefore = NULL;
+      scheduleWalker = slotframe->currentEntry;
+      do {
+         if (lastCell==NULL || scheduleWalker->slotOffset>lastCell->slotOffset) {
+            lastCell = scheduleWalker;
+         }
+         if (
+               scheduleWalker->slotOffset<=slotframe->slotOffset &&
+               (lastCellBefore==NULL || scheduleWalker->slotOffset>lastCellBefore->slotOffset)
+            ) {
+            lastCellBefore = scheduleWalker;
+         }
+         scheduleWalker = scheduleWalker->next;
+      } while (scheduleWalker!=slotframe->currentEntry);
+      slotframe->currentEntry = (lastCellBefore!=NULL) ? lastCellBefore : lastCell;
    }
+   schedule_selectCurrentEntry();
    
    ENABLE_INTERRUPTS();
 }
@@ -542,25 +799,82 @@ void schedule_syncSlotOffset(slotOffset_t targetSlotOffset) {
 \brief advance to next active slot
 */
 void schedule_advanceSlot() {
+   slotframeEntry_t* slotframe;
+   scheduleEntry_t* nextEntry;
+   uint32_t         distance;
+   uint8_t          i;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   schedule_vars.currentScheduleEntry = schedule_vars.currentScheduleEntry->next;
+   // move the ASN forward
+   distance = (uint32_t)schedule_vars.asn.bytes0and1+schedule_vars.slotsToNextActive;
+   schedule_vars.asn.bytes0and1 = (uint16_t)distance;
+   if (distance>0xffff) {
+      schedule_vars.asn.bytes2and3++;
+      if (schedule_vars.asn.bytes2and3==0) {
+         schedule_vars.asn.byte4++;
+      }
+   }
+   
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      slotframe = &schedule_vars.slotframes[i];
+      if (slotframe->frameLength==0) {
+         continue;
+      }
+      // walk over the cells of this slotframe in the slots being skipped
+      while (slotframe->currentEntry!=NULL) {
+         nextEntry = slotframe->currentEntry->next;
+         if (nextEntry==slotframe->currentEntry) {
+            break;
+         }
+         distance  = ((uint32_t)nextEntry->slotOffset+slotframe->frameLength-slotframe->slotOffset);
+         distance %= slotframe->frameLength;
+         if (distance==0 || distance>schedule_vars.slotsToNextActive) {
+            break;
+         }
+         slotframe->currentEntry = nextEntry;
+      }
+      slotframe->slotOffset = (slotOffset_t)(
+         ((uint32_t)slotframe->slotOffset+schedule_vars.slotsToNextActive)%slotframe->frameLength
+      );
+   }
+   schedule_selectCurrentEntry();
    
    ENABLE_INTERRUPTS();
 }
 
 /**
 \brief return slotOffset of next active slot
+
+The slot offset is relative to the minimal slotframe, the next active slot
+being the closest next cell over all slotframes.
 */
 slotOffset_t schedule_getNextActiveSlotOffset() {
-   slotOffset_t res;   
+   slotframeEntry_t* primary;
+   frameLength_t    distance;
+   frameLength_t    minDistance;
+   uint8_t          i;
+   slotOffset_t     res;
    
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   res = ((scheduleEntry_t*)(schedule_vars.currentScheduleEntry->next))->slotOffset;
+   primary     = &schedule_vars.slotframes[0];
+   minDistance = primary->frameLength;
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      distance = schedule_slotsToNextCell(&schedule_vars.slotframes[i]);
+      if (distance!=0 && distance<minDistance) {
+         minDistance = distance;
+      }
+   }
+   schedule_vars.slotsToNextActive = minDistance;
+   
+   if (primary->frameLength==0) {
+      res = primary->slotOffset+minDistance;
+   } else {
+      res = (slotOffset_t)(((uint32_t)primary->slotOffset+minDistance)%primary->frameLength);
+   }
    
    ENABLE_INTERRUPTS();
    
@@ -578,7 +892,7 @@ frameLength_t schedule_getFrameLength() {
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   returnVal = schedule_vars.frameLength;
+   returnVal = schedule_vars.slotframes[0].frameLength;
    
    ENABLE_INTERRUPTS();
    
@@ -596,7 +910,7 @@ uint8_t schedule_getFrameHandle() {
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   returnVal = schedule_vars.frameHandle;
+   returnVal = schedule_vars.slotframes[0].frameHandle;
    
    ENABLE_INTERRUPTS();
    
@@ -604,9 +918,9 @@ uint8_t schedule_getFrameHandle() {
 }
 
 /**
-\brief Get the frame number.
+\brief Get the number of slotframes.
 
-\returns The frame number.
+\returns The number of slotframes.
 */
 uint8_t schedule_getFrameNumber() {
    uint8_t returnVal;
@@ -614,7 +928,7 @@ uint8_t schedule_getFrameNumber() {
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
-   returnVal = schedule_vars.frameNumber;
+   returnVal = schedule_vars.numSlotframes;
    
    ENABLE_INTERRUPTS();
    
@@ -809,4 +1123,97 @@ void schedule_resetEntry(scheduleEntry_t* e) {
    e->lastUsedAsn.bytes2and3 = 0;
    e->lastUsedAsn.byte4      = 0;
    e->next                   = NULL;
+   e->nextNeighborCell       = NULL;
+}
+
+/**
+\brief Bucket of the per-neighbor cell index a neighbor belongs to.
+*/
+uint8_t schedule_neighborBucket(open_addr_t* neighbor) {
+   return neighbor->addr_64b[7]&(SCHEDULE_NEIGHBOR_HASHSIZE-1);
+}
+
+/**
+\brief Find a slotframe by handle.
+
+\returns The slotframe, NULL if there is no slotframe with that handle.
+*/
+slotframeEntry_t* schedule_getSlotframe(uint8_t frameHandle) {
+   uint8_t i;
+   
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      if (schedule_vars.slotframes[i].frameHandle==frameHandle) {
+         return &schedule_vars.slotframes[i];
+      }
+   }
+   return NULL;
+}
+
+/**
+\brief Slot offset of an ASN in a slotframe of some length.
+*/
+slotOffset_t schedule_asnToSlotOffset(asn_t* asn, frameLength_t frameLength) {
+   uint32_t slotOffset;
+   
+   slotOffset = asn->byte4;
+   slotOffset = slotOffset % frameLength;
+   slotOffset = slotOffset << 16;
+   slotOffset = slotOffset + asn->bytes2and3;
+   slotOffset = slotOffset % frameLength;
+   slotOffset = slotOffset << 16;
+   slotOffset = slotOffset + asn->bytes0and1;
+   slotOffset = slotOffset % frameLength;
+   
+   return (slotOffset_t)slotOffset;
+}
+
+/**
+\brief Number of slots from the current slot to the next cell of a slotframe.
+
+\returns The number of slots, between 1 and the frame length, 0 if the
+   slotframe has no cells.
+*/
+frameLength_t schedule_slotsToNextCell(slotframeEntry_t* slotframe) {
+   uint32_t distance;
+   
+   if (slotframe->frameLength==0 || slotframe->currentEntry==NULL) {
+      return 0;
+   }
+   distance  = ((scheduleEntry_t*)slotframe->currentEntry->next)->slotOffset;
+   distance += slotframe->frameLength-slotframe->slotOffset;
+   distance %= slotframe->frameLength;
+   if (distance==0) {
+      distance = slotframe->frameLength;
+   }
+   return (frameLength_t)distance;
+}
+
+/**
+\brief Pick the cell to use in the current slot.
+
+When cells of several slotframes fall on the current slot, the slotframe with
+the lowest handle wins.
+*/
+void schedule_selectCurrentEntry() {
+   slotframeEntry_t* slotframe;
+   scheduleEntry_t* winner;
+   uint8_t          i;
+   
+   winner = NULL;
+   for (i=0;i<schedule_vars.numSlotframes;i++) {
+      slotframe = &schedule_vars.slotframes[i];
+      if (
+            slotframe->currentEntry==NULL ||
+            slotframe->currentEntry->slotOffset!=slotframe->slotOffset
+         ) {
+         continue;
+      }
+      if (winner==NULL || slotframe->frameHandle<winner->slotframeHandle) {
+         winner = slotframe->currentEntry;
+      }
+   }
+   if (winner==NULL) {
+      winner = schedule_vars.slotframes[0].currentEntry;
+   }
+   schedule_vars.currentScheduleEntry = winner;
 }
@@ -26,6 +26,16 @@ The superframe repears over time and can be arbitrarly long.
 #define SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE          1 //id of slotframe
 #define SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_NUMBER          1 //1 slotframe by default.
 
+/**
+\brief Maximum number of slotframes running concurrently.
+
+The first slotframe is the one set up by the minimal 6TiSCH configuration.
+Other slotframes are added with schedule_addSlotframe(). When cells of
+different slotframes fall on the same ASN, the cell of the slotframe with the
+lowest handle is used.
+*/
+#define MAXSLOTFRAMES        2
+
 #define NUMSERIALRX          3
 #define NUMSLOTSOFF          3
 
@@ -41,6 +51,20 @@ in your schedule, so not to waste RAM.
 */
 #define MAXACTIVESLOTS       (SCHEDULE_MINIMAL_6TISCH_ACTIVE_CELLS+NUMSERIALRX+NUMSLOTSOFF)
 
+/**
+\brief Number of slot offsets tracked in the occupancy bitmap.
+
+Checking whether a slot offset below this value is available costs a single
+bit test. Slot offsets at or above this value are looked up by walking the
+schedule. Keep this a multiple of 8 and at least the slotframe length.
+*/
+#define SCHEDULE_BITMAP_SLOTS      128
+
+/**
+\brief Number of buckets of the per-neighbor cell index, a power of 2.
+*/
+#define SCHEDULE_NEIGHBOR_HASHSIZE 8
+
 /**
 \brief Minimum backoff exponent.
 
@@ -89,6 +113,8 @@ typedef struct {
    uint8_t         numTxACK;
    asn_t           lastUsedAsn;
    void*           next;
+   void*           nextNeighborCell; // next cell in the same neighbor bucket
+   uint8_t         slotframeHandle;  // slotframe this cell belongs to
 } scheduleEntry_t;
 
 BEGIN_PACK
@@ -114,18 +140,29 @@ typedef struct {
   channelOffset_t  channelOffset;
 }slotinfo_element_t;
 
+typedef struct {
+   uint8_t          frameHandle;   // lowest handle wins when cells overlap
+   frameLength_t    frameLength;   // 0 until known
+   slotOffset_t     slotOffset;    // offset of the current slot in this slotframe
+   scheduleEntry_t* currentEntry;  // last cell at or before slotOffset
+   uint8_t          occupied[SCHEDULE_BITMAP_SLOTS/8];  // one bit per slot offset in use
+} slotframeEntry_t;
+
 //=========================== variables =======================================
 
 typedef struct {
    scheduleEntry_t  scheduleBuf[MAXACTIVESLOTS];
-   scheduleEntry_t* currentScheduleEntry;
-   frameLength_t    frameLength;
+   scheduleEntry_t* currentScheduleEntry;    // cell used in the current slot
+   slotframeEntry_t slotframes[MAXSLOTFRAMES];
+   uint8_t          numSlotframes;
+   asn_t            asn;                     // ASN of the current slot
+   frameLength_t    slotsToNextActive;       // as returned by schedule_getNextActiveSlotOffset()
+   scheduleEntry_t* neighborCells[SCHEDULE_NEIGHBOR_HASHSIZE]; // cells, by neighbor
    frameLength_t    maxActiveSlots;
-   uint8_t          frameHandle;
-   uint8_t          frameNumber;
    uint8_t          backoffExponent;
    uint8_t          backoff;
    uint8_t          debugPrintRow;
+   uint16_t         debugDigest[MAXACTIVESLOTS]; // of each row, when last printed
 } schedule_vars_t;
 
 //=========================== prototypes ======================================
@@ -139,8 +176,17 @@ bool               debugPrint_backoff(void);
 // from 6top
 void               schedule_setFrameLength(frameLength_t newFrameLength);
 void               schedule_setFrameHandle(uint8_t frameHandle);
-void               schedule_setFrameNumber(uint8_t frameNumber);
+owerror_t          schedule_addSlotframe(
+   uint8_t              frameHandle,
+   frameLength_t        frameLength
+);
+void               schedule_getSlotframeInfo(
+   uint8_t              index,
+   uint8_t*             frameHandle,
+   frameLength_t*       frameLength
+);
 owerror_t          schedule_addActiveSlot(
+   uint8_t              slotframeHandle,
    slotOffset_t         slotOffset,
    cellType_t           type,
    bool                 shared,
@@ -149,6 +195,7 @@ owerror_t          schedule_addActiveSlot(
 );
 
 void               schedule_getSlotInfo(
+   uint8_t              slotframeHandle,
    slotOffset_t         slotOffset,                      
    open_addr_t*         neighbor,
    slotinfo_element_t*  info
@@ -157,10 +204,14 @@ void               schedule_getSlotInfo(
 uint16_t           schedule_getMaxActiveSlots(void);
 
 owerror_t          schedule_removeActiveSlot(
+   uint8_t              slotframeHandle,
    slotOffset_t         slotOffset,
    open_addr_t*         neighbor
 );
-bool               schedule_isSlotOffsetAvailable(uint16_t slotOffset);
+bool               schedule_isSlotOffsetAvailable(
+   uint8_t              slotframeHandle,
+   uint16_t             slotOffset
+);
 // return the slot info which has a poor quality
 scheduleEntry_t*  schedule_statistic_poorLinkQuality(void);
 uint16_t          schedule_getCellsCounts(
@@ -173,9 +224,13 @@ void              schedule_removeAllCells(
    open_addr_t*   previousHop
 );
 scheduleEntry_t*  schedule_getCurrentScheduleEntry();
+scheduleEntry_t*  schedule_getNextNeighborCell(
+   open_addr_t*      neighbor,
+   scheduleEntry_t*  previous
+);
 
 // from IEEE802154E
-void               schedule_syncSlotOffset(slotOffset_t targetSlotOffset);
+void               schedule_syncAsn(asn_t* asn);
 void               schedule_advanceSlot(void);
 slotOffset_t       schedule_getNextActiveSlotOffset(void);
 frameLength_t      schedule_getFrameLength(void);
@@ -4,7 +4,7 @@
 #include "openqueue.h"
 #include "neighbors.h"
 #include "IEEE802154E.h"
-#include "iphc.h"
+#include "frag.h"
 #include "otf.h"
 #include "packetfunctions.h"
 #include "openrandom.h"
@@ -367,7 +367,7 @@ void sixtop_addORremoveCellByInfo(uint8_t code,open_addr_t* neighbor,cellInfo_ht
 void sixtop_maintaining(uint16_t slotOffset,open_addr_t* neighbor){
     slotinfo_element_t info;
     cellInfo_ht linkInfo;
-    schedule_getSlotInfo(slotOffset,neighbor,&info);
+    schedule_getSlotInfo(schedule_getFrameHandle(),slotOffset,neighbor,&info);
     if(info.link_type != CELLTYPE_OFF){
         linkInfo.tsNum       = slotOffset;
         linkInfo.choffset    = info.channelOffset;
@@ -478,7 +478,7 @@ void task_sixtopNotifSendDone() {
       
       default:
          // send the rest up the stack
-         iphc_sendDone(msg,msg->l2_sendDoneError);
+         frag_sendDone(msg,msg->l2_sendDoneError);
          break;
    }
 }
@@ -536,7 +536,7 @@ void task_sixtopNotifReceive() {
     case IEEE154_TYPE_CMD:
         if (msg->length>0) {
             // send to upper layer
-            iphc_receive(msg);
+            frag_receive(msg);
         } else {
             // free up the RAM
             openqueue_freePacketBuffer(msg);
@@ -573,8 +573,7 @@ bool debugPrint_myDAGrank() {
    output = 0;
    
    output = neighbors_getMyDAGrank();
-   openserial_printStatus(STATUS_DAGRANK,(uint8_t*)&output,sizeof(uint16_t));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_DAGRANK,(uint8_t*)&output,sizeof(uint16_t));
 }
 
 /**
@@ -590,12 +589,11 @@ bool debugPrint_kaPeriod() {
    
    output = sixtop_vars.kaPeriod;
    
-   openserial_printStatus(
+   return openserial_printStatusOnChange(
        STATUS_KAPERIOD,
        (uint8_t*)&output,
        sizeof(output)
    );
-   return TRUE;
 }
 
 void sixtop_setIsResponseEnabled(bool isEnabled){
@@ -645,7 +643,7 @@ owerror_t sixtop_send_internal(
                             &(msg->l2_nextORpreviousHop)
                             );
    // change owner to IEEE802154E fetches it from queue
-   msg->owner  = COMPONENT_SIXTOP_TO_IEEE802154E;
+   openqueue_sixtopPutDataPacket(msg);
    return E_SUCCESS;
 }
 
@@ -814,7 +812,7 @@ port_INLINE void sixtop_sendKA() {
    // if I get here, I will send a KA
    
    // get a free packet buffer
-   kaPkt = openqueue_getFreePacketBuffer(COMPONENT_SIXTOP);
+   kaPkt = openqueue_getFreeSmallPacketBuffer(COMPONENT_SIXTOP);
    if (kaPkt==NULL) {
       openserial_printError(COMPONENT_SIXTOP,ERR_NO_FREE_PACKET_BUFFER,
                             (errorparameter_t)1,
@@ -1274,29 +1272,23 @@ uint8_t sixtop_getCelllist(
     ){
     uint8_t          i=0;
     scheduleEntry_t* scheduleWalker;
-    scheduleEntry_t* currentEntry;
    
     INTERRUPT_DECLARATION();
     DISABLE_INTERRUPTS();
     
-    if (frameID != SCHEDULE_MINIMAL_6TISCH_DEFAULT_SLOTFRAME_HANDLE){
-        ENABLE_INTERRUPTS();
-        return 0;
-    }
-    
     memset(cellList,0,SCHEDULEIEMAXNUMCELLS*sizeof(cellInfo_ht));
    
-    scheduleWalker = schedule_getCurrentScheduleEntry();
-    currentEntry   = scheduleWalker;
-    do {
-       if(packetfunctions_sameAddress(&(scheduleWalker->neighbor),neighbor)){
-           cellList[i].tsNum        = scheduleWalker->slotOffset;
-           cellList[i].choffset     = scheduleWalker->channelOffset;
-           cellList[i].linkoptions  = scheduleWalker->type;
-           i++;
+    // only walk the cells scheduled with that neighbor
+    scheduleWalker = schedule_getNextNeighborCell(neighbor,NULL);
+    while (scheduleWalker!=NULL && i!=SCHEDULEIEMAXNUMCELLS) {
+       if (scheduleWalker->slotframeHandle==frameID) {
+          cellList[i].tsNum        = scheduleWalker->slotOffset;
+          cellList[i].choffset     = scheduleWalker->channelOffset;
+          cellList[i].linkoptions  = scheduleWalker->type;
+          i++;
        }
-       scheduleWalker = scheduleWalker->next;
-    }while(scheduleWalker!=currentEntry && i!=SCHEDULEIEMAXNUMCELLS);
+       scheduleWalker = schedule_getNextNeighborCell(neighbor,scheduleWalker);
+    }
    
     ENABLE_INTERRUPTS();
     return i;
@@ -1318,7 +1310,7 @@ bool sixtop_candidateAddCellList(
    numCandCells=0;
    for(counter=0;counter<SCHEDULEIEMAXNUMCELLS;counter++){
       i = openrandom_get16b()%schedule_getFrameLength();
-      if(schedule_isSlotOffsetAvailable(i)==TRUE){
+      if(schedule_isSlotOffsetAvailable(*frameID,i)==TRUE){
          cellList[numCandCells].tsNum       = i;
          cellList[numCandCells].choffset    = 0;
          cellList[numCandCells].linkoptions = CELLTYPE_TX;
@@ -1347,7 +1339,7 @@ bool sixtop_candidateRemoveCellList(
   
    numCandCells    = 0;
    for(i=0;i<schedule_getFrameLength();i++){
-      schedule_getSlotInfo(i,neighbor,&info);
+      schedule_getSlotInfo(*frameID,i,neighbor,&info);
       if(info.link_type == CELLTYPE_TX){
          cellList[numCandCells].tsNum       = i;
          cellList[numCandCells].choffset    = info.channelOffset;
@@ -1385,6 +1377,7 @@ void sixtop_addCellsByState(
                memcpy(&temp_neighbor,previousHop,sizeof(open_addr_t));
                //add a RX link
                schedule_addActiveSlot(
+                  slotframeID,
                   cellList[i].tsNum,
                   CELLTYPE_RX,
                   FALSE,
@@ -1397,6 +1390,7 @@ void sixtop_addCellsByState(
                memcpy(&temp_neighbor,previousHop,sizeof(open_addr_t));
                //add a TX link
                schedule_addActiveSlot(
+                  slotframeID,
                   cellList[i].tsNum,
                   CELLTYPE_TX,
                   FALSE,
@@ -1422,6 +1416,7 @@ void sixtop_removeCellsByState(
    for(i=0;i<SCHEDULEIEMAXNUMCELLS;i++){   
       if(cellList[i].linkoptions != CELLTYPE_OFF){
          schedule_removeActiveSlot(
+            slotframeID,
             cellList[i].tsNum,
             previousHop
          );
@@ -1448,7 +1443,7 @@ bool sixtop_areAvailableCellsToBeScheduled(
       available = FALSE;
    } else {
       do {
-         if(schedule_isSlotOffsetAvailable(cellList[i].tsNum) == TRUE){
+         if(schedule_isSlotOffsetAvailable(frameID,cellList[i].tsNum) == TRUE){
             bw--;
          } else {
             cellList[i].linkoptions = CELLTYPE_OFF;
@@ -1493,7 +1488,7 @@ bool sixtop_areAvailableCellsToBeRemoved(
       available = FALSE;
    } else {
       do {
-          schedule_getSlotInfo(cellList[i].tsNum,neighbor,&info);
+          schedule_getSlotInfo(frameID,cellList[i].tsNum,neighbor,&info);
           if(info.link_type == CELLTYPE_RX){
               bw--;
           } else {
@@ -0,0 +1,672 @@
+#include "opendefs.h"
+#include "frag.h"
+#include "iphc.h"
+#include "sixtop.h"
+#include "openqueue.h"
+#include "openserial.h"
+#include "openrandom.h"
+#include "packetfunctions.h"
+#include "IEEE802154E.h"
+#include "scheduler.h"
+
+//=========================== variables =======================================
+
+frag_vars_t frag_vars;
+
+//=========================== prototypes ======================================
+
+owerror_t frag_sendFragment(uint8_t row);
+owerror_t frag_relayFirst(OpenQueueEntry_t* msg);
+void      frag_receiveFirst(OpenQueueEntry_t* msg, uint16_t size, uint16_t tag);
+void      frag_receiveNext(OpenQueueEntry_t* msg, uint16_t size, uint16_t tag, uint16_t offset);
+uint8_t   frag_startReassembly(
+   OpenQueueEntry_t*    first,
+   uint8_t              size,
+   uint16_t             tag,
+   open_addr_t*         prevHop,
+   uint8_t              firstLength,
+   bool                 relay
+);
+bool      frag_markReceived(uint8_t row, uint8_t offset, uint8_t length);
+uint8_t   frag_getReassemblyRow(open_addr_t* prevHop, uint16_t tag);
+uint8_t   frag_getVrbRow(open_addr_t* prevHop, uint16_t tag);
+void      frag_purgeExpired(void);
+void      frag_armTimer(void);
+void      frag_timer_cb(opentimer_id_t id);
+void      frag_timer_task(void);
+void      frag_writeHeader(OpenQueueEntry_t* msg, uint8_t dispatch, uint16_t size, uint16_t tag);
+
+//=========================== public ==========================================
+
+/**
+\brief Initialize this module.
+*/
+void frag_init() {
+   memset(&frag_vars,0,sizeof(frag_vars_t));
+   frag_vars.tag     = openrandom_get16b();
+   frag_vars.timerId = TOO_MANY_TIMERS_ERROR;
+}
+
+/**
+\brief Trigger this module to print status information, over serial.
+
+debugPrint_* functions are used by the openserial module to continuously print
+status information about several modules in the OpenWSN stack.
+
+\returns TRUE if this function printed something, FALSE otherwise.
+*/
+bool debugPrint_frag() {
+   return openserial_printStatusOnChange(
+      STATUS_FRAG,
+      (uint8_t*)&frag_vars.stats,
+      sizeof(frag_stats_t)
+   );
+}
+
+//======= from upper layer
+
+/**
+\brief Send a datagram, in fragments if it does not fit in a frame.
+
+Fragments are handed to sixtop one at a time, the next one when the previous
+one is sent, so they reach the next hop in order and use a single frame
+buffer. Offsets and sizes count the bytes of the compressed datagram.
+
+A datagram in a datagram buffer which fits in a frame is sent the same way,
+as a single unfragmented frame: the MAC only handles frame buffers.
+
+\param[in] msg The datagram, with its 6LoWPAN headers.
+
+\returns E_SUCCESS if the datagram was handed over, E_FAIL otherwise, in which
+   case the caller still owns it.
+*/
+owerror_t frag_send(OpenQueueEntry_t* msg) {
+   uint8_t row;
+
+   if (msg==frag_vars.relayMsg) {
+      // first fragment of a datagram I relay, back from forwarding
+      return frag_relayFirst(msg);
+   }
+
+   if (msg->length<=FRAG_MAX_FRAME_PAYLOAD && msg->packetSize<=LENGTH_PACKET) {
+      // fits in a single frame, and is in a frame buffer
+      return sixtop_send(msg);
+   }
+
+   for (row=0;row<FRAG_MAX_TX;row++) {
+      if (frag_vars.tx[row].msg==NULL) {
+         break;
+      }
+   }
+   if (row==FRAG_MAX_TX) {
+      frag_vars.stats.numNoBuffer++;
+      openserial_printError(COMPONENT_FRAG,ERR_FRAG_NO_BUFFER,
+                            (errorparameter_t)frag_vars.tag,
+                            (errorparameter_t)msg->length);
+      return E_FAIL;
+   }
+
+   msg->owner                     = COMPONENT_FRAG;
+   frag_vars.tx[row].msg          = msg;
+   frag_vars.tx[row].tag          = frag_vars.tag++;
+   frag_vars.tx[row].offset       = 0;
+   if (frag_sendFragment(row)==E_FAIL) {
+      frag_vars.tx[row].msg       = NULL;
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+//======= from lower layer
+
+/**
+\brief Indicate a frame was sent, or could not be sent.
+
+Fragments are mine, the other frames are passed on to IPHC.
+*/
+void frag_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
+   OpenQueueEntry_t* datagram;
+   uint8_t           row;
+
+   if (msg->creator!=COMPONENT_FRAG) {
+      iphc_sendDone(msg,error);
+      return;
+   }
+   msg->owner = COMPONENT_FRAG;
+
+   for (row=0;row<FRAG_MAX_TX;row++) {
+      if (frag_vars.tx[row].msg!=NULL && frag_vars.tx[row].fragment==msg) {
+         break;
+      }
+   }
+   openqueue_freePacketBuffer(msg);
+   if (row==FRAG_MAX_TX) {
+      // a fragment relayed through the VRB
+      return;
+   }
+
+   frag_vars.tx[row].fragment = NULL;
+   if (
+         error==E_SUCCESS &&
+         frag_vars.tx[row].offset<frag_vars.tx[row].msg->length
+      ) {
+      error = frag_sendFragment(row);
+      if (error==E_SUCCESS) {
+         return;
+      }
+   }
+
+   // the datagram is sent, or a fragment could not be
+   datagram                   = frag_vars.tx[row].msg;
+   frag_vars.tx[row].msg      = NULL;
+   iphc_sendDone(datagram,error);
+}
+
+/**
+\brief Receive a frame from sixtop.
+
+Frames other than fragments are passed on to IPHC.
+*/
+void frag_receive(OpenQueueEntry_t* msg) {
+   uint8_t  dispatch;
+   uint16_t size;
+   uint16_t tag;
+   uint16_t offset;
+
+   msg->owner = COMPONENT_FRAG;
+
+   dispatch = msg->payload[0] & FRAG_DISPATCH_MASK;
+   if (dispatch!=FRAG_DISPATCH_FRAG1 && dispatch!=FRAG_DISPATCH_FRAGN) {
+      iphc_receive(msg);
+      return;
+   }
+
+   frag_purgeExpired();
+
+   if (msg->length<=FRAGN_HEADER_LEN) {
+      frag_vars.stats.numDropped++;
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+
+   size = ((uint16_t)(msg->payload[0] & FRAG_SIZE_MASK)<<8) | msg->payload[1];
+   tag  = ((uint16_t)msg->payload[2]<<8) | msg->payload[3];
+   if (dispatch==FRAG_DISPATCH_FRAG1) {
+      packetfunctions_tossHeader(msg,FRAG1_HEADER_LEN);
+      frag_receiveFirst(msg,size,tag);
+   } else {
+      offset = 8*(uint16_t)msg->payload[4];
+      packetfunctions_tossHeader(msg,FRAGN_HEADER_LEN);
+      frag_receiveNext(msg,size,tag,offset);
+   }
+}
+
+//=========================== private =========================================
+
+/**
+\brief Hand the next fragment of a datagram to sixtop.
+
+All fragments but the last carry a multiple of 8 bytes. A datagram which fits
+in a frame is copied whole into the frame buffer.
+*/
+owerror_t frag_sendFragment(uint8_t row) {
+   frag_tx_t*        tx;
+   OpenQueueEntry_t* fragment;
+   uint8_t           remaining;
+   uint8_t           length;
+
+   tx        = &frag_vars.tx[row];
+   remaining = tx->msg->length-tx->offset;
+
+   fragment = openqueue_getFreePacketBuffer(COMPONENT_FRAG);
+   if (fragment==NULL) {
+      frag_vars.stats.numNoBuffer++;
+      openserial_printError(COMPONENT_FRAG,ERR_FRAG_NO_BUFFER,
+                            (errorparameter_t)tx->tag,
+                            (errorparameter_t)tx->msg->length);
+      return E_FAIL;
+   }
+   fragment->owner = COMPONENT_FRAG;
+
+   if (tx->offset==0 && remaining<=FRAG_MAX_FRAME_PAYLOAD) {
+      // the whole datagram, moved out of its datagram buffer
+      length = remaining;
+   } else if (tx->offset==0) {
+      length = (FRAG_MAX_FRAME_PAYLOAD-FRAG1_HEADER_LEN) & ~0x07;
+   } else if (remaining<=FRAG_MAX_FRAME_PAYLOAD-FRAGN_HEADER_LEN) {
+      length = remaining;
+   } else {
+      length = (FRAG_MAX_FRAME_PAYLOAD-FRAGN_HEADER_LEN) & ~0x07;
+   }
+
+   packetfunctions_reserveHeaderSize(fragment,length);
+   memcpy(fragment->payload,&tx->msg->payload[tx->offset],length);
+   // fragments carry a header, a whole datagram goes without
+   if (tx->offset>0) {
+      packetfunctions_reserveHeaderSize(fragment,FRAGN_HEADER_LEN);
+      frag_writeHeader(fragment,FRAG_DISPATCH_FRAGN,tx->msg->length,tx->tag);
+      fragment->payload[4] = tx->offset/8;
+   } else if (length<tx->msg->length) {
+      packetfunctions_reserveHeaderSize(fragment,FRAG1_HEADER_LEN);
+      frag_writeHeader(fragment,FRAG_DISPATCH_FRAG1,tx->msg->length,tx->tag);
+   }
+   memcpy(&fragment->l2_nextORpreviousHop,&tx->msg->l2_nextORpreviousHop,sizeof(open_addr_t));
+   memcpy(&fragment->l3_destinationAdd,&tx->msg->l3_destinationAdd,sizeof(open_addr_t));
+   memcpy(&fragment->l3_sourceAdd,&tx->msg->l3_sourceAdd,sizeof(open_addr_t));
+
+   tx->fragment  = fragment;
+   tx->offset   += length;
+   if (sixtop_send(fragment)==E_FAIL) {
+      tx->fragment = NULL;
+      openqueue_freePacketBuffer(fragment);
+      return E_FAIL;
+   }
+   return E_SUCCESS;
+}
+
+/**
+\brief Send the first fragment of a datagram I relay, after forwarding.
+
+Forwarding may have changed the length of the headers by delta bytes. When
+delta is a multiple of 8 and the fragment still fits in a frame, the offsets
+of the next fragments only need shifting: the fragment is sent on right away
+and a VRB row remembers how to relay the next ones. Otherwise the datagram is
+reassembled here and fragmented again once complete.
+*/
+owerror_t frag_relayFirst(OpenQueueEntry_t* msg) {
+   frag_vrb_t* vrb;
+   int16_t     delta;
+   uint8_t     row;
+
+   frag_vars.relayMsg = NULL;
+   delta = (int16_t)msg->length-(int16_t)frag_vars.relayLength;
+
+   if (
+         (delta & 0x07)==0 &&
+         msg->length+FRAG1_HEADER_LEN<=FRAG_MAX_FRAME_PAYLOAD
+      ) {
+      for (row=0;row<FRAG_MAX_VRB;row++) {
+         if (frag_vars.vrb[row].used==FALSE) {
+            break;
+         }
+      }
+      if (row<FRAG_MAX_VRB) {
+         vrb            = &frag_vars.vrb[row];
+         vrb->used      = TRUE;
+         memcpy(&vrb->prevHop,&frag_vars.relayPrevHop,sizeof(open_addr_t));
+         vrb->inTag     = frag_vars.relayTag;
+         memcpy(&vrb->nextHop,&msg->l2_nextORpreviousHop,sizeof(open_addr_t));
+         vrb->outTag    = frag_vars.tag++;
+         vrb->size      = frag_vars.relaySize;
+         vrb->delta     = delta;
+         vrb->lastHeard = ieee154e_getCoarseAsn();
+
+         packetfunctions_reserveHeaderSize(msg,FRAG1_HEADER_LEN);
+         frag_writeHeader(msg,FRAG_DISPATCH_FRAG1,vrb->size+delta,vrb->outTag);
+         frag_vars.stats.numRelayed++;
+         frag_armTimer();
+         return sixtop_send(msg);
+      }
+   }
+
+   // reassemble the datagram here, forward it once complete
+   row = frag_startReassembly(
+      msg,
+      frag_vars.relaySize,
+      frag_vars.relayTag,
+      &frag_vars.relayPrevHop,
+      frag_vars.relayLength,
+      TRUE
+   );
+   if (row==FRAG_NONE) {
+      return E_FAIL;
+   }
+   openqueue_freePacketBuffer(msg);
+   return E_SUCCESS;
+}
+
+/**
+\brief Receive the first fragment of a datagram, its header tossed.
+*/
+void frag_receiveFirst(OpenQueueEntry_t* msg, uint16_t size, uint16_t tag) {
+   if (size<msg->length) {
+      // malformed
+      frag_vars.stats.numDropped++;
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+   if (size==msg->length) {
+      // the whole datagram
+      iphc_receive(msg);
+      return;
+   }
+   if (
+         frag_getReassemblyRow(&msg->l2_nextORpreviousHop,tag)!=FRAG_NONE ||
+         frag_getVrbRow(&msg->l2_nextORpreviousHop,tag)!=FRAG_NONE
+      ) {
+      // duplicate
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+   if (size>FRAG_MAX_DATAGRAM) {
+      frag_vars.stats.numNoBuffer++;
+      openserial_printError(COMPONENT_FRAG,ERR_FRAG_NO_BUFFER,
+                            (errorparameter_t)tag,
+                            (errorparameter_t)size);
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+
+   if (iphc_isRelayed(msg)) {
+      // forward the first fragment, frag_send() is called back with it
+      frag_vars.relayMsg    = msg;
+      memcpy(&frag_vars.relayPrevHop,&msg->l2_nextORpreviousHop,sizeof(open_addr_t));
+      frag_vars.relayTag    = tag;
+      frag_vars.relaySize   = size;
+      frag_vars.relayLength = msg->length;
+      iphc_receive(msg);
+      frag_vars.relayMsg    = NULL;
+      return;
+   }
+
+   frag_startReassembly(msg,size,tag,&msg->l2_nextORpreviousHop,msg->length,FALSE);
+   openqueue_freePacketBuffer(msg);
+}
+
+/**
+\brief Receive a subsequent fragment of a datagram, its header tossed.
+*/
+void frag_receiveNext(OpenQueueEntry_t* msg, uint16_t size, uint16_t tag, uint16_t offset) {
+   frag_reassembly_t* reassembly;
+   frag_vrb_t*        vrb;
+   OpenQueueEntry_t*  datagram;
+   uint8_t            row;
+
+   row = frag_getReassemblyRow(&msg->l2_nextORpreviousHop,tag);
+   if (row!=FRAG_NONE) {
+      reassembly = &frag_vars.reassembly[row];
+      if (
+            size!=reassembly->size ||
+            offset==0 ||
+            offset+msg->length>reassembly->size
+         ) {
+         frag_vars.stats.numDropped++;
+         openqueue_freePacketBuffer(msg);
+         return;
+      }
+      memcpy(&reassembly->msg->payload[offset+reassembly->delta],msg->payload,msg->length);
+      reassembly->lastHeard = ieee154e_getCoarseAsn();
+      if (frag_markReceived(row,offset,msg->length)==FALSE) {
+         openqueue_freePacketBuffer(msg);
+         return;
+      }
+      openqueue_freePacketBuffer(msg);
+
+      // the datagram is complete
+      datagram        = reassembly->msg;
+      reassembly->msg = NULL;
+      if (reassembly->relay) {
+         if (frag_send(datagram)==E_FAIL) {
+            openqueue_freePacketBuffer(datagram);
+         }
+      } else {
+         frag_vars.stats.numReassembled++;
+         iphc_receive(datagram);
+      }
+      return;
+   }
+
+   row = frag_getVrbRow(&msg->l2_nextORpreviousHop,tag);
+   if (row!=FRAG_NONE) {
+      vrb = &frag_vars.vrb[row];
+      if (
+            size!=vrb->size ||
+            offset==0 ||
+            offset+msg->length>vrb->size
+         ) {
+         frag_vars.stats.numDropped++;
+         openqueue_freePacketBuffer(msg);
+         return;
+      }
+      vrb->lastHeard = ieee154e_getCoarseAsn();
+      if (offset+msg->length==vrb->size) {
+         // last fragment
+         vrb->used = FALSE;
+      }
+
+      // relay to the same next hop, shifted by the change of the headers
+      packetfunctions_reserveHeaderSize(msg,FRAGN_HEADER_LEN);
+      frag_writeHeader(msg,FRAG_DISPATCH_FRAGN,vrb->size+vrb->delta,vrb->outTag);
+      msg->payload[4]            = (offset+vrb->delta)/8;
+      msg->creator               = COMPONENT_FRAG;
+      msg->l2_payloadIEpresent   = FALSE;
+      memcpy(&msg->l2_nextORpreviousHop,&vrb->nextHop,sizeof(open_addr_t));
+      if (sixtop_send(msg)==E_FAIL) {
+         openqueue_freePacketBuffer(msg);
+      }
+      return;
+   }
+
+   // unknown datagram, its first fragment was lost or its row timed out
+   frag_vars.stats.numDropped++;
+   openqueue_freePacketBuffer(msg);
+}
+
+/**
+\brief Start reassembling a datagram from its first fragment.
+
+The first fragment is copied into a datagram buffer; the caller still owns it.
+
+\param[in] first       The first fragment, its header tossed, possibly forwarded.
+\param[in] size        The datagram_size, as sent by the previous hop.
+\param[in] tag         The datagram_tag, as sent by the previous hop.
+\param[in] prevHop     The previous hop.
+\param[in] firstLength The length of the first fragment, as sent by the previous hop.
+\param[in] relay       Whether to forward the datagram once reassembled.
+
+\returns The row of the reassembly, FRAG_NONE if there is no room for it.
+*/
+uint8_t frag_startReassembly(
+      OpenQueueEntry_t*    first,
+      uint8_t              size,
+      uint16_t             tag,
+      open_addr_t*         prevHop,
+      uint8_t              firstLength,
+      bool                 relay
+   ) {
+   frag_reassembly_t* reassembly;
+   OpenQueueEntry_t*  datagram;
+   int16_t            delta;
+   uint8_t            row;
+
+   delta    = (int16_t)first->length-(int16_t)firstLength;
+   datagram = NULL;
+   for (row=0;row<FRAG_MAX_REASSEMBLY;row++) {
+      if (frag_vars.reassembly[row].msg==NULL) {
+         break;
+      }
+   }
+   if (row<FRAG_MAX_REASSEMBLY) {
+      datagram = openqueue_getFreeDatagramBuffer(COMPONENT_FRAG);
+   }
+   if (
+         datagram!=NULL &&
+         size+delta>datagram->payload-datagram->packet
+      ) {
+      openqueue_freePacketBuffer(datagram);
+      datagram = NULL;
+   }
+   if (datagram==NULL) {
+      frag_vars.stats.numNoBuffer++;
+      openserial_printError(COMPONENT_FRAG,ERR_FRAG_NO_BUFFER,
+                            (errorparameter_t)tag,
+                            (errorparameter_t)size);
+      return FRAG_NONE;
+   }
+
+   datagram->creator                 = first->creator;
+   datagram->owner                   = COMPONENT_FRAG;
+   datagram->l2_frameType            = first->l2_frameType;
+   datagram->l1_rssi                 = first->l1_rssi;
+   datagram->l1_lqi                  = first->l1_lqi;
+   datagram->l1_crc                  = first->l1_crc;
+   datagram->l4_protocol             = first->l4_protocol;
+   datagram->l4_protocol_compressed  = first->l4_protocol_compressed;
+   memcpy(&datagram->l2_asn,&first->l2_asn,sizeof(asn_t));
+   memcpy(&datagram->l2_nextORpreviousHop,&first->l2_nextORpreviousHop,sizeof(open_addr_t));
+   memcpy(&datagram->l3_destinationAdd,&first->l3_destinationAdd,sizeof(open_addr_t));
+   memcpy(&datagram->l3_sourceAdd,&first->l3_sourceAdd,sizeof(open_addr_t));
+   packetfunctions_reserveHeaderSize(datagram,size+delta);
+   memcpy(datagram->payload,first->payload,first->length);
+
+   reassembly            = &frag_vars.reassembly[row];
+   reassembly->msg       = datagram;
+   memcpy(&reassembly->prevHop,prevHop,sizeof(open_addr_t));
+   reassembly->tag       = tag;
+   reassembly->size      = size;
+   reassembly->delta     = delta;
+   reassembly->received  = 0;
+   reassembly->lastHeard = ieee154e_getCoarseAsn();
+   reassembly->relay     = relay;
+   frag_markReceived(row,0,firstLength);
+   frag_armTimer();
+   return row;
+}
+
+/**
+\brief Record the reception of bytes of a datagram being reassembled.
+
+\returns TRUE if the datagram is complete, FALSE otherwise.
+*/
+bool frag_markReceived(uint8_t row, uint8_t offset, uint8_t length) {
+   frag_reassembly_t* reassembly;
+   uint8_t            block;
+   uint8_t            numBlocks;
+
+   reassembly = &frag_vars.reassembly[row];
+   for (block=offset/8;block<(offset+length+7)/8;block++) {
+      reassembly->received |= (uint32_t)1<<block;
+   }
+   numBlocks = (reassembly->size+7)/8;
+   if (numBlocks==32) {
+      return reassembly->received==0xffffffff;
+   }
+   return reassembly->received==((uint32_t)1<<numBlocks)-1;
+}
+
+uint8_t frag_getReassemblyRow(open_addr_t* prevHop, uint16_t tag) {
+   uint8_t row;
+
+   for (row=0;row<FRAG_MAX_REASSEMBLY;row++) {
+      if (
+            frag_vars.reassembly[row].msg!=NULL &&
+            frag_vars.reassembly[row].tag==tag &&
+            packetfunctions_sameAddress(&frag_vars.reassembly[row].prevHop,prevHop)
+         ) {
+         return row;
+      }
+   }
+   return FRAG_NONE;
+}
+
+uint8_t frag_getVrbRow(open_addr_t* prevHop, uint16_t tag) {
+   uint8_t row;
+
+   for (row=0;row<FRAG_MAX_VRB;row++) {
+      if (
+            frag_vars.vrb[row].used &&
+            frag_vars.vrb[row].inTag==tag &&
+            packetfunctions_sameAddress(&frag_vars.vrb[row].prevHop,prevHop)
+         ) {
+         return row;
+      }
+   }
+   return FRAG_NONE;
+}
+
+/**
+\brief Free the reassembly buffers and VRB rows not heard of for FRAG_TIMEOUT.
+*/
+void frag_purgeExpired() {
+   uint16_t now;
+   uint8_t  row;
+
+   now = ieee154e_getCoarseAsn();
+   for (row=0;row<FRAG_MAX_REASSEMBLY;row++) {
+      if (
+            frag_vars.reassembly[row].msg!=NULL &&
+            (uint16_t)(now-frag_vars.reassembly[row].lastHeard)>FRAG_TIMEOUT
+         ) {
+         frag_vars.stats.numTimeouts++;
+         openserial_printError(COMPONENT_FRAG,ERR_FRAG_REASSEMBLY_TIMEOUT,
+                               (errorparameter_t)frag_vars.reassembly[row].tag,
+                               (errorparameter_t)frag_vars.reassembly[row].size);
+         openqueue_freePacketBuffer(frag_vars.reassembly[row].msg);
+         frag_vars.reassembly[row].msg = NULL;
+      }
+   }
+   for (row=0;row<FRAG_MAX_VRB;row++) {
+      if (
+            frag_vars.vrb[row].used &&
+            (uint16_t)(now-frag_vars.vrb[row].lastHeard)>FRAG_TIMEOUT
+         ) {
+         frag_vars.stats.numTimeouts++;
+         frag_vars.vrb[row].used = FALSE;
+      }
+   }
+}
+
+/**
+\brief Arm the purge timer, if not armed already.
+
+Without a timer, rows are only purged when a fragment is received.
+*/
+void frag_armTimer() {
+   if (frag_vars.timerId==TOO_MANY_TIMERS_ERROR) {
+      frag_vars.timerId = opentimers_start(
+         FRAG_TIMER_PERIOD,
+         TIMER_ONESHOT,
+         TIME_MS,
+         frag_timer_cb
+      );
+   }
+}
+
+void frag_timer_cb(opentimer_id_t id) {
+   scheduler_push_task(frag_timer_task,TASKPRIO_FRAG_TIMEOUT);
+}
+
+/**
+\brief Purge the expired rows, and keep purging while some are in use.
+*/
+void frag_timer_task() {
+   uint8_t row;
+
+   // the one-shot timer is over
+   frag_vars.timerId = TOO_MANY_TIMERS_ERROR;
+
+   frag_purgeExpired();
+
+   for (row=0;row<FRAG_MAX_REASSEMBLY;row++) {
+      if (frag_vars.reassembly[row].msg!=NULL) {
+         frag_armTimer();
+         return;
+      }
+   }
+   for (row=0;row<FRAG_MAX_VRB;row++) {
+      if (frag_vars.vrb[row].used) {
+         frag_armTimer();
+         return;
+      }
+   }
+}
+
+/**
+\brief Write the 4 first bytes of a fragment header, room for it reserved.
+*/
+void frag_writeHeader(OpenQueueEntry_t* msg, uint8_t dispatch, uint16_t size, uint16_t tag) {
+   msg->payload[0] = dispatch | ((size>>8) & FRAG_SIZE_MASK);
+   msg->payload[1] = size & 0xff;
+   msg->payload[2] = (tag>>8) & 0xff;
+   msg->payload[3] = tag & 0xff;
+}
@@ -0,0 +1,134 @@
+#ifndef __FRAG_H
+#define __FRAG_H
+
+/**
+\addtogroup LoWPAN
+\{
+\addtogroup Frag
+\{
+*/
+
+#include "opendefs.h"
+#include "opentimers.h"
+
+//=========================== define ==========================================
+
+// 6LoWPAN bytes in a data frame: 127B, minus the MAC header with 64-bit
+// addresses (21B), the CRC (2B) and the auxiliary security header and MIC
+#ifndef FRAG_MAX_FRAME_PAYLOAD
+#ifdef L2_SECURITY_ACTIVE
+#define FRAG_MAX_FRAME_PAYLOAD    96
+#else
+#define FRAG_MAX_FRAME_PAYLOAD    104
+#endif
+#endif
+
+#ifndef FRAG_MAX_REASSEMBLY
+#define FRAG_MAX_REASSEMBLY       2      // datagrams reassembled at the same time
+#endif
+#ifndef FRAG_MAX_VRB
+#define FRAG_MAX_VRB              4      // datagrams relayed fragment by fragment
+#endif
+#define FRAG_MAX_TX               2      // datagrams fragmented at the same time
+#define FRAG_TIMEOUT              16     // in units of 256 slots, about 60s
+#define FRAG_TIMER_PERIOD         4000   // in ms, purge period while rows are in use
+#define FRAG_MAX_DATAGRAM         255    // longest datagram, lengths are 8-bit
+#define FRAG_NONE                 0xff   // no row
+
+enum FRAG_enums {
+   FRAG_DISPATCH_MASK        = 0xf8,
+   FRAG_DISPATCH_FRAG1       = 0xc0,     // 11000xxx
+   FRAG_DISPATCH_FRAGN       = 0xe0,     // 11100xxx
+   FRAG_SIZE_MASK            = 0x07,     // high bits of the 11-bit datagram_size
+   FRAG1_HEADER_LEN          = 4,
+   FRAGN_HEADER_LEN          = 5,
+};
+
+//=========================== typedef =========================================
+
+/**
+\brief A datagram being reassembled.
+
+The first fragment may have been forwarded, and its headers rewritten, before
+the datagram is reassembled: byte x of the datagram as sent by the previous
+hop is at payload[x+delta] in the reassembly buffer.
+*/
+typedef struct {
+   OpenQueueEntry_t*    msg;                ///< reassembly buffer, NULL if the row is free.
+   open_addr_t          prevHop;
+   uint16_t             tag;                ///< datagram_tag chosen by the previous hop.
+   uint8_t              size;               ///< datagram_size, as sent by the previous hop.
+   int16_t              delta;
+   uint32_t             received;           ///< bitmap of the 8-byte blocks received.
+   uint16_t             lastHeard;          ///< ASN of the last fragment, in units of 256 slots.
+   bool                 relay;              ///< forward the datagram once reassembled.
+} frag_reassembly_t;
+
+/**
+\brief A datagram relayed fragment by fragment (Virtual Reassembly Buffer).
+
+Only the first fragment goes through forwarding, the next ones are sent to the
+same next hop, with the same change of length.
+*/
+typedef struct {
+   bool                 used;
+   open_addr_t          prevHop;
+   uint16_t             inTag;
+   open_addr_t          nextHop;
+   uint16_t             outTag;
+   uint8_t              size;               ///< datagram_size, as sent by the previous hop.
+   int16_t              delta;              ///< change of datagram_size, multiple of 8.
+   uint16_t             lastHeard;          ///< ASN of the last fragment, in units of 256 slots.
+} frag_vrb_t;
+
+/**
+\brief A datagram being fragmented, one fragment at a time.
+*/
+typedef struct {
+   OpenQueueEntry_t*    msg;                ///< datagram, NULL if the row is free.
+   OpenQueueEntry_t*    fragment;           ///< fragment handed to sixtop.
+   uint16_t             tag;
+   uint8_t              offset;             ///< bytes of the datagram already handed to sixtop.
+} frag_tx_t;
+
+typedef struct {
+   uint16_t             numReassembled;     ///< datagrams reassembled for me
+   uint16_t             numRelayed;         ///< datagrams relayed fragment by fragment
+   uint16_t             numTimeouts;        ///< reassemblies and relays which timed out
+   uint16_t             numNoBuffer;        ///< datagrams dropped, no buffer or no free row
+   uint16_t             numDropped;         ///< fragments dropped, unknown or malformed
+} frag_stats_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+   frag_reassembly_t    reassembly[FRAG_MAX_REASSEMBLY];
+   frag_vrb_t           vrb[FRAG_MAX_VRB];
+   frag_tx_t            tx[FRAG_MAX_TX];
+   uint16_t             tag;                // datagram_tag of the next datagram I send
+   // first fragment being relayed, while it goes through forwarding
+   OpenQueueEntry_t*    relayMsg;
+   open_addr_t          relayPrevHop;
+   uint16_t             relayTag;
+   uint8_t              relaySize;
+   uint8_t              relayLength;        // its length before forwarding
+   opentimer_id_t       timerId;            // one-shot purge timer, TOO_MANY_TIMERS_ERROR when not armed
+   frag_stats_t         stats;
+} frag_vars_t;
+
+//=========================== prototypes ======================================
+
+void      frag_init(void);
+bool      debugPrint_frag(void);
+// from upper layer
+owerror_t frag_send(OpenQueueEntry_t* msg);
+// from lower layer
+void      frag_sendDone(OpenQueueEntry_t* msg, owerror_t error);
+void      frag_receive(OpenQueueEntry_t* msg);
+
+/**
+\}
+\}
+*/
+
+#endif
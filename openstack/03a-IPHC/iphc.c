@@ -3,14 +3,19 @@
 #include "packetfunctions.h"
 #include "idmanager.h"
 #include "openserial.h"
+#include "openqueue.h"
 #include "sixtop.h"
+#include "frag.h"
 #include "forwarding.h"
 #include "neighbors.h"
 #include "openbridge.h"
 #include "icmpv6rpl.h"
+#include "sourceroute.h"
 
 //=========================== variables =======================================
 
+iphc_vars_t iphc_vars;
+
 static const uint8_t dagroot[]   = {0x03,
    0xbb, 0xbb, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
@@ -19,13 +24,13 @@ static const uint8_t dagroot[]   = {0x03,
 //=========================== prototypes ======================================
 
 //===== IPv6 header
-void iphc_retrieveIPv6Header(
+owerror_t iphc_retrieveIPv6Header(
    OpenQueueEntry_t* msg, 
    ipv6_header_iht* ipv6_outer_header,
    ipv6_header_iht* ipv6_inner_header,
    uint8_t*         page_length
 );
-uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
+owerror_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
    open_addr_t*         temp_addr_64b,
    uint8_t*             dispatch,
    uint8_t*             tf,
@@ -49,9 +54,15 @@ uint8_t iphc_retrieveIPv6HopByHopHeader(
    rpl_option_ht*       rpl_option
 );
 
+//===== 6LoWPAN contexts
+uint8_t iphc_prefixMask(uint8_t prefixLength, uint8_t byte);
+bool iphc_matchContext(iphc_context_t* context, uint8_t* prefix);
+owerror_t iphc_applyContext(uint8_t cid, open_addr_t* address);
+
 //=========================== public ==========================================
 
 void      iphc_init() {
+   memset(&iphc_vars,0,sizeof(iphc_vars_t));
 }
 
 // send from upper layer: I need to add 6LoWPAN header
@@ -73,6 +84,7 @@ owerror_t iphc_sendFromForwarding(
     // take ownership over the packet
     msg->owner = COMPONENT_IPHC;
    
+#if !defined(DAGROOT_ROUTING) && !defined(RPL_STORING_MODE)
     // error checking
     if (idmanager_getIsDAGroot()==TRUE &&
         packetfunctions_isAllRoutersMulticast(&(msg->l3_destinationAdd))==FALSE) {
@@ -81,6 +93,7 @@ owerror_t iphc_sendFromForwarding(
                             (errorparameter_t)0);
         return E_FAIL;
     }
+#endif
    
     //discard the packet.. hop limit reached.
     if (ipv6_outer_header->src.type != ADDR_NONE){
@@ -126,6 +139,21 @@ owerror_t iphc_sendFromForwarding(
 
     //IPinIP 6LoRH will be added at here if necessary.
     if (packetfunctions_sameAddress(&temp_dest_prefix,&temp_src_prefix)){
+        if (rh3_length>0) {
+            // source routed by the DAG root, the RH3s are compressed against
+            // its address: keep it in the IPinIP 6LoRH
+            packetfunctions_ip128bToMac64b(&(ipv6_outer_header->src),&temp_src_prefix,&temp_src_mac64b);
+            packetfunctions_writeAddress(msg,&(temp_src_mac64b),OW_BIG_ENDIAN);
+            // hoplim
+            packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+            *((uint8_t*)(msg->payload)) = ipv6_outer_header->hop_limit;
+            // type
+            packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+            *((uint8_t*)(msg->payload)) = IPECAP_6LOTH_TYPE;
+            // length
+            packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+            *((uint8_t*)(msg->payload)) = ELECTIVE_6LoRH | 9;
+        }
         // same network, IPinIP is elided
     } else {
         if (packetfunctions_isBroadcastMulticast(&(msg->l3_destinationAdd))==FALSE){
@@ -193,7 +221,7 @@ owerror_t iphc_sendFromForwarding(
         *((uint8_t*)(msg->payload)) = PAGE_DISPATCH_NO_1;
     }
     
-    return sixtop_send(msg);
+    return frag_send(msg);
 }
 
 //send from bridge: 6LoWPAN header already added by OpenLBR, send as is
@@ -206,7 +234,7 @@ owerror_t iphc_sendFromBridge(OpenQueueEntry_t *msg) {
                             (errorparameter_t)0);
       return E_FAIL;
    }
-   return sixtop_send(msg);
+   return frag_send(msg);
 }
 
 void iphc_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
@@ -224,6 +252,9 @@ void iphc_receive(OpenQueueEntry_t* msg) {
     uint8_t              page_length;
     rpl_option_ht        rpl_option;
     uint8_t              rpi_length;
+#if defined(DAGROOT_ROUTING) || defined(RPL_STORING_MODE)
+    uint8_t*             l4;
+#endif
    
     msg->owner      = COMPONENT_IPHC;
    
@@ -232,12 +263,47 @@ void iphc_receive(OpenQueueEntry_t* msg) {
     memset(&rpl_option,0,sizeof(rpl_option_ht));
     
     // then regular header
-    iphc_retrieveIPv6Header(msg,&ipv6_outer_header,&ipv6_inner_header,&page_length);
+    if (iphc_retrieveIPv6Header(msg,&ipv6_outer_header,&ipv6_inner_header,&page_length)==E_FAIL) {
+        // an address could not be decompressed, or too many RH3s
+        openqueue_freePacketBuffer(msg);
+        return;
+    }
+    
+#if defined(DAGROOT_ROUTING) || defined(RPL_STORING_MODE)
+    // learn the downward routes from the DAOs reaching me
+    if (
+        idmanager_getIsDAGroot()==TRUE &&
+        idmanager_isMyAddress(&(ipv6_inner_header.dest)) &&
+        ipv6_inner_header.next_header==IANA_ICMPv6
+    ) {
+        l4 = msg->payload+page_length;
+        if (ipv6_outer_header.hopByhop_option != NULL) {
+            rpi_length = ipv6_outer_header.hopByhop_option-msg->payload;
+            packetfunctions_tossHeader(msg,rpi_length);
+            l4 = ipv6_outer_header.hopByhop_option+iphc_retrieveIPv6HopByHopHeader(msg,&rpl_option);
+            packetfunctions_reserveHeaderSize(msg,rpi_length);
+        }
+        if (ipv6_outer_header.src.type != ADDR_NONE) {
+            l4 += ipv6_outer_header.header_length;
+        }
+        l4 += ipv6_inner_header.header_length;
+        memcpy(&(msg->l3_sourceAdd),&(ipv6_inner_header.src),sizeof(open_addr_t));
+        icmpv6rpl_indicateRxDAO(msg,l4);
+    }
+#endif
     
     // if the address is broadcast address, the ipv6 header is the inner header
     if (
         idmanager_getIsDAGroot()==FALSE ||
         packetfunctions_isBroadcastMulticast(&(ipv6_inner_header.dest))
+#ifdef DAGROOT_ROUTING
+        // source routed to a node of my DODAG
+        || sourceroute_hasRoute(&(ipv6_inner_header.dest))
+#endif
+#ifdef RPL_STORING_MODE
+        // routed down to a node of my DODAG
+        || forwarding_hasRoute(&(ipv6_inner_header.dest))
+#endif
     ) {
         packetfunctions_tossHeader(msg,page_length);
         if (
@@ -269,12 +335,226 @@ void iphc_receive(OpenQueueEntry_t* msg) {
    }
 }
 
+/**
+\brief Tell whether a received packet is relayed rather than delivered to me.
+
+Used on the first fragment of a datagram, to relay it fragment by fragment
+instead of reassembling it. Same test as forwarding_receive(); the DAG root
+reassembles all datagrams.
+*/
+bool iphc_isRelayed(OpenQueueEntry_t* msg) {
+    ipv6_header_iht      ipv6_outer_header;
+    ipv6_header_iht      ipv6_inner_header;
+    uint8_t              page_length;
+    
+    if (idmanager_getIsDAGroot()==TRUE) {
+        return FALSE;
+    }
+    
+    memset(&ipv6_outer_header,0,sizeof(ipv6_header_iht));
+    memset(&ipv6_inner_header,0,sizeof(ipv6_header_iht));
+    if (iphc_retrieveIPv6Header(msg,&ipv6_outer_header,&ipv6_inner_header,&page_length)==E_FAIL) {
+        // reassembled, then dropped by iphc_receive()
+        return FALSE;
+    }
+    
+    return !(
+        (
+            idmanager_isMyAddress(&(ipv6_inner_header.dest)) ||
+            packetfunctions_isBroadcastMulticast(&(ipv6_inner_header.dest))
+        ) &&
+        ipv6_outer_header.next_header!=IANA_IPv6ROUTE
+    );
+}
+
+//===== 6LoWPAN contexts
+
+/**
+\brief Set or remove a 6LoWPAN context.
+
+\param[in] cid          The context identifier, 1 to 15, context 0 being my prefix.
+\param[in] prefix       The prefix, IPHC_CONTEXT_MAXLENGTH bits.
+\param[in] prefixLength The length of the prefix, in bits, 0 to remove the context.
+\param[in] compress     Whether to use the context to compress, or only to decompress.
+
+\returns E_SUCCESS if the context was set or removed, E_FAIL otherwise.
+*/
+owerror_t iphc_setContext(uint8_t cid, uint8_t* prefix, uint8_t prefixLength, bool compress) {
+   iphc_context_t* context;
+   
+   if (
+         cid==0                                 ||
+         cid>=IPHC_MAX_CONTEXTS                 ||
+         prefixLength>IPHC_CONTEXT_MAXLENGTH
+      ) {
+      return E_FAIL;
+   }
+   
+   context = &iphc_vars.contexts[cid];
+   if (prefixLength==0) {
+      memset(context,0,sizeof(iphc_context_t));
+      return E_SUCCESS;
+   }
+   context->used         = TRUE;
+   context->compress     = compress;
+   context->prefixLength = prefixLength;
+   memcpy(context->prefix,prefix,sizeof(context->prefix));
+   return E_SUCCESS;
+}
+
+/**
+\brief Get a 6LoWPAN context.
+
+Context 0 is always the prefix of my DODAG, as learnt from the DAG root. It
+is only used to compress with IPHC_CONTEXT0_COMPRESS.
+
+\returns A pointer to the context, or NULL if it is not set.
+*/
+iphc_context_t* iphc_getContext(uint8_t cid) {
+   if (cid>=IPHC_MAX_CONTEXTS) {
+      return NULL;
+   }
+   if (cid==0) {
+      iphc_vars.contexts[0].used         = TRUE;
+      iphc_vars.contexts[0].compress     = (IPHC_CONTEXT0_COMPRESS!=0);
+      iphc_vars.contexts[0].prefixLength = 64;
+      memcpy(iphc_vars.contexts[0].prefix,idmanager_getMyID(ADDR_PREFIX)->prefix,8);
+   }
+   if (iphc_vars.contexts[cid].used==FALSE) {
+      return NULL;
+   }
+   return &iphc_vars.contexts[cid];
+}
+
+/**
+\brief Set a 6LoWPAN context, as requested over serial by the bridge.
+
+The input buffer holds the context identifier (1B), the prefix length in bits
+(1B), whether to compress with it (1B) and the prefix (8B). The DAG root
+advertises the new context in its DIOs.
+*/
+void iphc_triggerSetContext() {
+   uint8_t         number_bytes_from_input_buffer;
+   uint8_t         input_buffer[11];
+   
+   //=== get command from OpenSerial
+   number_bytes_from_input_buffer = openserial_getInputBuffer(input_buffer,sizeof(input_buffer));
+   if (number_bytes_from_input_buffer!=sizeof(input_buffer)) {
+      openserial_printError(COMPONENT_IPHC,ERR_INPUTBUFFER_LENGTH,
+            (errorparameter_t)number_bytes_from_input_buffer,
+            (errorparameter_t)1);
+      return;
+   };
+   
+   //=== handle command
+   if (
+         iphc_setContext(
+            input_buffer[0],
+            &input_buffer[3],
+            input_buffer[1],
+            input_buffer[2]!=0
+         )==E_FAIL
+      ) {
+      openserial_printError(COMPONENT_IPHC,ERR_UNKNOWN_CONTEXT,
+            (errorparameter_t)input_buffer[0],
+            (errorparameter_t)input_buffer[1]);
+      return;
+   }
+   
+   // spread the news
+   icmpv6rpl_resetDIOTrickle();
+}
+
+/**
+\brief Find a context to compress an address with.
+
+A unicast address matches a context when it starts with the context prefix,
+followed by zeros up to its interface identifier. A multicast address matches
+when it is based on the context prefix (RFC3306).
+
+\param[in]  address The 128-bit address.
+\param[out] cid     The context identifier, context 0 first.
+
+\returns TRUE if a context matches, FALSE otherwise.
+*/
+bool iphc_lookupContext(open_addr_t* address, uint8_t* cid) {
+   iphc_context_t* context;
+   uint8_t         i;
+   
+   if (address->type!=ADDR_128B) {
+      return FALSE;
+   }
+   for (i=0;i<IPHC_MAX_CONTEXTS;i++) {
+      context = iphc_getContext(i);
+      if (context==NULL || context->compress==FALSE) {
+         continue;
+      }
+      if (address->addr_128b[0]==0xff) {
+         // ffXX:XXLL:PPPP:PPPP:PPPP:PPPP:XXXX:XXXX
+         if (
+               address->addr_128b[3]==context->prefixLength &&
+               iphc_matchContext(context,&address->addr_128b[4])
+            ) {
+            *cid = i;
+            return TRUE;
+         }
+      } else if (iphc_matchContext(context,&address->addr_128b[0])) {
+         *cid = i;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Pick the shortest encoding of a multicast destination address.
+
+\param[in]  dest The 128-bit multicast address.
+\param[out] dac  IPHC_DAC_STATEFUL if compressed against a context.
+\param[out] dam  The destination address mode, to use with IPHC_M_YES.
+\param[out] dci  The context identifier, when stateful.
+*/
+void iphc_compressMulticast(open_addr_t* dest, bool* dac, uint8_t* dam, uint8_t* dci) {
+   uint8_t i;
+   uint8_t zeros;
+   
+   *dac = IPHC_DAC_STATELESS;
+   *dci = 0;
+   
+   // number of zero bytes after the flags and scope
+   zeros = 0;
+   for (i=2;i<16 && dest->addr_128b[i]==0;i++) {
+      zeros++;
+   }
+   
+   if (dest->addr_128b[1]==0x02 && zeros>=13) {
+      // ff02::00XX
+      *dam = IPHC_DAM_ELIDED;
+   } else if (zeros>=11) {
+      // ffXX::00XX:XXXX
+      *dam = IPHC_DAM_16B;
+   } else if (zeros>=9) {
+      // ffXX::00XX:XXXX:XXXX
+      *dam = IPHC_DAM_64B;
+   } else if (iphc_lookupContext(dest,dci)) {
+      // ffXX:XXLL:PPPP:PPPP:PPPP:PPPP:XXXX:XXXX
+      *dac = IPHC_DAC_STATEFUL;
+      *dam = IPHC_DAM_128B;
+   } else {
+      *dam = IPHC_DAM_128B;
+   }
+}
+
 //=========================== private =========================================
 
 //===== IPv6 header
 
 /**
 \brief Prepend an IPv6 header to a message.
+
+\param[in] cid The CID octet (SCI<<4|DCI), IPHC_CID_NO to elide it, in which
+   case stateful addresses are compressed against context 0. With IPHC_DAC_STATEFUL
+   and IPHC_M_NO, the destination is passed as for the stateless modes.
 */
 owerror_t iphc_prependIPv6Header(
       OpenQueueEntry_t* msg,
@@ -284,7 +564,7 @@ owerror_t iphc_prependIPv6Header(
       uint8_t           value_nextHeader,
       uint8_t           hlim,
       uint8_t           value_hopLimit,
-      bool              cid,
+      uint8_t           cid,
       bool              sac,
       uint8_t           sam,
       bool              m,
@@ -309,7 +589,10 @@ owerror_t iphc_prependIPv6Header(
          break;
       case IPHC_DAM_16B:
          if (m == IPHC_M_YES){
-             // tengfei: to do
+             // ffXX::00XX:XXXX
+             packetfunctions_reserveHeaderSize(msg,4*sizeof(uint8_t));
+             msg->payload[0] = value_dest->addr_128b[1];
+             memcpy(&msg->payload[1],&value_dest->addr_128b[13],3);
          } else {
              if (value_dest->type!=ADDR_16B) {
                 openserial_printCritical(
@@ -325,7 +608,10 @@ owerror_t iphc_prependIPv6Header(
          break;
       case IPHC_DAM_64B:
          if (m == IPHC_M_YES){
-             // tengfei: to do
+             // ffXX::00XX:XXXX:XXXX
+             packetfunctions_reserveHeaderSize(msg,6*sizeof(uint8_t));
+             msg->payload[0] = value_dest->addr_128b[1];
+             memcpy(&msg->payload[1],&value_dest->addr_128b[11],5);
          } else {
              if (value_dest->type!=ADDR_64B) {
                 openserial_printCritical(
@@ -340,18 +626,22 @@ owerror_t iphc_prependIPv6Header(
          }
          break;
       case IPHC_DAM_128B:
-         if (m == IPHC_M_YES){
-             // tengfei: to do
+         if (value_dest->type!=ADDR_128B) {
+            openserial_printCritical(
+               COMPONENT_IPHC,
+               ERR_WRONG_ADDR_TYPE,
+               (errorparameter_t)value_dest->type,
+               (errorparameter_t)2
+            );
+            return E_FAIL;
+         };
+         if (m == IPHC_M_YES && dac == IPHC_DAC_STATEFUL){
+             // ffXX:XXLL:PPPP:PPPP:PPPP:PPPP:XXXX:XXXX, prefix from the context
+             packetfunctions_reserveHeaderSize(msg,6*sizeof(uint8_t));
+             msg->payload[0] = value_dest->addr_128b[1];
+             msg->payload[1] = value_dest->addr_128b[2];
+             memcpy(&msg->payload[2],&value_dest->addr_128b[12],4);
          } else {
-             if (value_dest->type!=ADDR_128B) {
-                openserial_printCritical(
-                   COMPONENT_IPHC,
-                   ERR_WRONG_ADDR_TYPE,
-                   (errorparameter_t)value_dest->type,
-                   (errorparameter_t)2
-                );
-                return E_FAIL;
-             };
              packetfunctions_writeAddress(msg,value_dest,OW_BIG_ENDIAN);
          }
          break;
@@ -496,9 +786,15 @@ owerror_t iphc_prependIPv6Header(
          return E_FAIL;
    }
    
+   // context identifiers
+   if (cid!=IPHC_CID_NO) {
+      packetfunctions_reserveHeaderSize(msg,sizeof(uint8_t));
+      *((uint8_t*)(msg->payload)) = cid;
+   }
+   
    // header
    temp_8b    = 0;
-   temp_8b   |= cid                    << IPHC_CID;
+   temp_8b   |= (cid!=IPHC_CID_NO)     << IPHC_CID;
    temp_8b   |= sac                    << IPHC_SAC;
    temp_8b   |= sam                    << IPHC_SAM;
    temp_8b   |= m                      << IPHC_M;
@@ -519,8 +815,12 @@ owerror_t iphc_prependIPv6Header(
 
 /**
 \brief Retrieve an IPv6 header from a message.
+
+\returns E_FAIL if an address is compressed against an unknown context or the
+   message carries more than MAXNUM_RH3 RH3s, in which case the message is to
+   be dropped, E_SUCCESS otherwise.
 */
-void iphc_retrieveIPv6Header(OpenQueueEntry_t* msg, ipv6_header_iht* ipv6_outer_header, ipv6_header_iht* ipv6_inner_header,uint8_t* page_length) {
+owerror_t iphc_retrieveIPv6Header(OpenQueueEntry_t* msg, ipv6_header_iht* ipv6_outer_header, ipv6_header_iht* ipv6_inner_header,uint8_t* page_length) {
     uint8_t         temp_8b;
     open_addr_t     temp_addr_16b;
     open_addr_t     temp_addr_64b;
@@ -572,7 +872,7 @@ void iphc_retrieveIPv6Header(OpenQueueEntry_t* msg, ipv6_header_iht* ipv6_outer_
                         (errorparameter_t)13,
                         (errorparameter_t)(rh3_index)
                     );
-                    return;
+                    return E_FAIL;
                 }
                 if (rh3_index==0){
                     if (ipv6_outer_header->hopByhop_option == NULL){
@@ -703,7 +1003,7 @@ void iphc_retrieveIPv6Header(OpenQueueEntry_t* msg, ipv6_header_iht* ipv6_outer_
           }
     }
     //======================= 4. IPHC inner header =============================
-    iphc_retrieveIphcHeader(
+    return iphc_retrieveIphcHeader(
         &temp_addr_16b, 
         &temp_addr_64b,
         &dispatch,
@@ -719,7 +1019,7 @@ void iphc_retrieveIPv6Header(OpenQueueEntry_t* msg, ipv6_header_iht* ipv6_outer_
     );
 }
 
-uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
+owerror_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
     open_addr_t*         temp_addr_64b,
     uint8_t*             dispatch,
     uint8_t*             tf,
@@ -735,6 +1035,13 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
     uint8_t page;
     uint8_t temp_8b;
     uint8_t ipinip_length;
+    uint8_t cid;
+    uint8_t sac;
+    uint8_t dac;
+    uint8_t sci;
+    uint8_t dci;
+    uint8_t* inline_addr;
+    iphc_context_t* context;
     
     temp_8b = *((uint8_t*)(msg->payload)+ipv6_header->header_length+previousLen);
     
@@ -757,15 +1064,24 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
         *hlim      = (temp_8b >> IPHC_HLIM)      & 0x03;   // 2b
         ipv6_header->header_length += sizeof(uint8_t);
         temp_8b    = *((uint8_t*)(msg->payload)+ipv6_header->header_length+previousLen);
-       // cid unused
-       // sac unused
+       cid        = (temp_8b >> IPHC_CID)       & 0x01;   // 1b
+       sac        = (temp_8b >> IPHC_SAC)       & 0x01;   // 1b
        *sam       = (temp_8b >> IPHC_SAM)       & 0x03;   // 2b
-       // m unused
        *m         = (temp_8b >> IPHC_M)         & 0x01;   // 1b
-       // dac unused
+       dac        = (temp_8b >> IPHC_DAC)       & 0x01;   // 1b
        *dam       = (temp_8b >> IPHC_DAM)       & 0x03;   // 2b
        ipv6_header->header_length += sizeof(uint8_t);
        
+       // context identifiers, context 0 if elided
+       sci        = 0;
+       dci        = 0;
+       if (cid==IPHC_CID_YES) {
+          temp_8b = *((uint8_t*)(msg->payload)+ipv6_header->header_length+previousLen);
+          sci     = (temp_8b >> 4) & 0x0f;
+          dci     = temp_8b        & 0x0f;
+          ipv6_header->header_length += sizeof(uint8_t);
+       }
+       
        // dispatch
        switch (*dispatch) {
           case IPHC_DISPATCH_IPHC:
@@ -861,37 +1177,98 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
        }
        
        // source address
-       switch (*sam) {
-          case IPHC_SAM_ELIDED:
-             packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),&(msg->l2_nextORpreviousHop),&ipv6_header->src);
-             break;
-          case IPHC_SAM_16B:
-             packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_16B,temp_addr_16b,OW_BIG_ENDIAN);
-             ipv6_header->header_length += 2*sizeof(uint8_t);
-             packetfunctions_mac16bToMac64b(temp_addr_16b,temp_addr_64b);
-             packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
-             break;
-          case IPHC_SAM_64B:
-             packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_64B,temp_addr_64b,OW_BIG_ENDIAN);
-             ipv6_header->header_length += 8*sizeof(uint8_t);
-             packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
-             break;
-          case IPHC_SAM_128B:
-             packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_128B,&ipv6_header->src,OW_BIG_ENDIAN);
-             ipv6_header->header_length += 16*sizeof(uint8_t);
-             break;
-          default:
-             openserial_printError(
-                COMPONENT_IPHC,
-                ERR_6LOWPAN_UNSUPPORTED,
-                (errorparameter_t)9,
-                (errorparameter_t)(*sam)
-             );
-             break;
+       if (sac==IPHC_SAC_STATEFUL) {
+          switch (*sam) {
+             case IPHC_SAM_128B:
+                // unspecified address
+                memset(&ipv6_header->src,0,sizeof(open_addr_t));
+                ipv6_header->src.type = ADDR_128B;
+                break;
+             case IPHC_SAM_64B:
+                packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_64B,temp_addr_64b,OW_BIG_ENDIAN);
+                ipv6_header->header_length += 8*sizeof(uint8_t);
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
+                break;
+             case IPHC_SAM_16B:
+                packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_16B,temp_addr_16b,OW_BIG_ENDIAN);
+                ipv6_header->header_length += 2*sizeof(uint8_t);
+                packetfunctions_mac16bToMac64b(temp_addr_16b,temp_addr_64b);
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
+                break;
+             case IPHC_SAM_ELIDED:
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),&(msg->l2_nextORpreviousHop),&ipv6_header->src);
+                break;
+          }
+          if (
+                *sam!=IPHC_SAM_128B &&
+                iphc_applyContext(sci,&ipv6_header->src)==E_FAIL
+             ) {
+             return E_FAIL;
+          }
+       } else {
+          switch (*sam) {
+             case IPHC_SAM_ELIDED:
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),&(msg->l2_nextORpreviousHop),&ipv6_header->src);
+                break;
+             case IPHC_SAM_16B:
+                packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_16B,temp_addr_16b,OW_BIG_ENDIAN);
+                ipv6_header->header_length += 2*sizeof(uint8_t);
+                packetfunctions_mac16bToMac64b(temp_addr_16b,temp_addr_64b);
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
+                break;
+             case IPHC_SAM_64B:
+                packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_64B,temp_addr_64b,OW_BIG_ENDIAN);
+                ipv6_header->header_length += 8*sizeof(uint8_t);
+                packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->src);
+                break;
+             case IPHC_SAM_128B:
+                packetfunctions_readAddress(((uint8_t*)(msg->payload+ipv6_header->header_length+previousLen)),ADDR_128B,&ipv6_header->src,OW_BIG_ENDIAN);
+                ipv6_header->header_length += 16*sizeof(uint8_t);
+                break;
+             default:
+                openserial_printError(
+                   COMPONENT_IPHC,
+                   ERR_6LOWPAN_UNSUPPORTED,
+                   (errorparameter_t)9,
+                   (errorparameter_t)(*sam)
+                );
+                break;
+          }
        }
        
        // destination address
-       if(*m == IPHC_M_YES) {
+       inline_addr = msg->payload+ipv6_header->header_length+previousLen;
+       if(*m == IPHC_M_YES && dac == IPHC_DAC_STATEFUL) {
+           if (*dam == IPHC_DAM_128B) {
+               // ffXX:XXLL:PPPP:PPPP:PPPP:PPPP:XXXX:XXXX, prefix from the context
+               memset(&ipv6_header->dest,0,sizeof(open_addr_t));
+               ipv6_header->dest.type          = ADDR_128B;
+               ipv6_header->dest.addr_128b[0]  = 0xff;
+               ipv6_header->dest.addr_128b[1]  = inline_addr[0];
+               ipv6_header->dest.addr_128b[2]  = inline_addr[1];
+               memcpy(&(ipv6_header->dest.addr_128b[12]),&inline_addr[2],4);
+               ipv6_header->header_length += 6*sizeof(uint8_t);
+               context = iphc_getContext(dci);
+               if (context==NULL) {
+                   openserial_printError(
+                      COMPONENT_IPHC,
+                      ERR_UNKNOWN_CONTEXT,
+                      (errorparameter_t)dci,
+                      (errorparameter_t)1
+                   );
+                   return E_FAIL;
+               }
+               ipv6_header->dest.addr_128b[3] = context->prefixLength;
+               memcpy(&(ipv6_header->dest.addr_128b[4]),context->prefix,8);
+           } else {
+               openserial_printError(
+                  COMPONENT_IPHC,
+                  ERR_6LOWPAN_UNSUPPORTED,
+                  (errorparameter_t)11,
+                  (errorparameter_t)(*dam)
+               );
+           }
+       } else if(*m == IPHC_M_YES) {
            switch (*dam) {
               case IPHC_DAM_ELIDED:
                  ipv6_header->dest.type = ADDR_128B;
@@ -900,13 +1277,26 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
                  ipv6_header->header_length += sizeof(uint8_t);
                  break;
               case IPHC_DAM_16B:
-                 // tengfei: todo
+                 // ffXX::00XX:XXXX
+                 memset(&ipv6_header->dest,0,sizeof(open_addr_t));
+                 ipv6_header->dest.type          = ADDR_128B;
+                 ipv6_header->dest.addr_128b[0]  = 0xff;
+                 ipv6_header->dest.addr_128b[1]  = inline_addr[0];
+                 memcpy(&(ipv6_header->dest.addr_128b[13]),&inline_addr[1],3);
+                 ipv6_header->header_length += 4*sizeof(uint8_t);
                  break;
               case IPHC_DAM_64B:
-                 // tengfei: todo
+                 // ffXX::00XX:XXXX:XXXX
+                 memset(&ipv6_header->dest,0,sizeof(open_addr_t));
+                 ipv6_header->dest.type          = ADDR_128B;
+                 ipv6_header->dest.addr_128b[0]  = 0xff;
+                 ipv6_header->dest.addr_128b[1]  = inline_addr[0];
+                 memcpy(&(ipv6_header->dest.addr_128b[11]),&inline_addr[1],5);
+                 ipv6_header->header_length += 6*sizeof(uint8_t);
                  break;
               case IPHC_DAM_128B:
-                 // tengfei: todo
+                 packetfunctions_readAddress(inline_addr,ADDR_128B,&ipv6_header->dest,OW_BIG_ENDIAN);
+                 ipv6_header->header_length += 16*sizeof(uint8_t);
                  break;
               default:
                  openserial_printError(
@@ -917,6 +1307,39 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
                  );
                  break;
            }
+       } else if (dac == IPHC_DAC_STATEFUL) {
+           switch (*dam) {
+              case IPHC_DAM_ELIDED:
+                 // derived from my link-layer address
+                 packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),idmanager_getMyID(ADDR_64B),&(ipv6_header->dest));
+                 break;
+              case IPHC_DAM_16B:
+                 packetfunctions_readAddress(inline_addr,ADDR_16B,temp_addr_16b,OW_BIG_ENDIAN);
+                 ipv6_header->header_length += 2*sizeof(uint8_t);
+                 packetfunctions_mac16bToMac64b(temp_addr_16b,temp_addr_64b);
+                 packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->dest);
+                 break;
+              case IPHC_DAM_64B:
+                 packetfunctions_readAddress(inline_addr,ADDR_64B,temp_addr_64b,OW_BIG_ENDIAN);
+                 ipv6_header->header_length += 8*sizeof(uint8_t);
+                 packetfunctions_mac64bToIp128b(idmanager_getMyID(ADDR_PREFIX),temp_addr_64b,&ipv6_header->dest);
+                 break;
+              default:
+                 // reserved
+                 openserial_printError(
+                    COMPONENT_IPHC,
+                    ERR_6LOWPAN_UNSUPPORTED,
+                    (errorparameter_t)11,
+                    (errorparameter_t)(*dam)
+                 );
+                 break;
+           }
+           if (
+                 *dam!=IPHC_DAM_128B &&
+                 iphc_applyContext(dci,&ipv6_header->dest)==E_FAIL
+              ) {
+              return E_FAIL;
+           }
        } else {
            switch (*dam) {
               case IPHC_DAM_ELIDED:
@@ -1004,7 +1427,7 @@ uint8_t iphc_retrieveIphcHeader(open_addr_t* temp_addr_16b,
             }
         }
     }
-    return page;
+    return E_SUCCESS;
 }
 
 //===== IPv6 hop-by-hop header
@@ -1107,3 +1530,65 @@ uint8_t iphc_retrieveIPv6HopByHopHeader(
    }
    return length;
 }
+
+//===== 6LoWPAN contexts
+
+/**
+\brief Bits of a byte of an address covered by a prefix.
+*/
+uint8_t iphc_prefixMask(uint8_t prefixLength, uint8_t byte) {
+   if (prefixLength>=8*(byte+1)) {
+      return 0xff;
+   }
+   if (prefixLength<=8*byte) {
+      return 0x00;
+   }
+   return (uint8_t)(0xff<<(8-(prefixLength-8*byte)));
+}
+
+/**
+\brief Tell whether 64 bits start with a context prefix, followed by zeros.
+*/
+bool iphc_matchContext(iphc_context_t* context, uint8_t* prefix) {
+   uint8_t i;
+   uint8_t mask;
+   
+   for (i=0;i<8;i++) {
+      mask = iphc_prefixMask(context->prefixLength,i);
+      if (
+            (prefix[i] & mask)!=(context->prefix[i] & mask) ||
+            (prefix[i] & ~mask)!=0
+         ) {
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+/**
+\brief Write the prefix of a context into the first 64 bits of an address.
+
+Bits past the prefix are zeroed, the interface identifier is left untouched.
+
+\returns E_FAIL if the context is unknown, E_SUCCESS otherwise.
+*/
+owerror_t iphc_applyContext(uint8_t cid, open_addr_t* address) {
+   iphc_context_t* context;
+   uint8_t         i;
+   
+   memset(&address->addr_128b[0],0,8);
+   context = iphc_getContext(cid);
+   if (context==NULL) {
+      openserial_printError(
+         COMPONENT_IPHC,
+         ERR_UNKNOWN_CONTEXT,
+         (errorparameter_t)cid,
+         (errorparameter_t)0
+      );
+      return E_FAIL;
+   }
+   for (i=0;i<8;i++) {
+      address->addr_128b[i] = context->prefix[i] & iphc_prefixMask(context->prefixLength,i);
+   }
+   return E_SUCCESS;
+}
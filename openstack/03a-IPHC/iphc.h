@@ -15,6 +15,14 @@
 #define IPHC_DEFAULT_HOP_LIMIT    65
 #define IPv6HOP_HDR_LEN           2  // tengfei: should be 2
 #define MAXNUM_RH3                3
+#define IPHC_MAX_CONTEXTS         16 // 6LoWPAN contexts, CID 0 to 15
+#define IPHC_CONTEXT_MAXLENGTH    64 // longest context prefix, in bits
+
+// compress the addresses of my DODAG prefix against context 0; off by default,
+// as the bridge of the DAG root does not decompress stateful addresses
+#ifndef IPHC_CONTEXT0_COMPRESS
+#define IPHC_CONTEXT0_COMPRESS    0
+#endif
 
 enum IPHC_enums {
    IPHC_DISPATCH             = 5,
@@ -213,6 +221,25 @@ typedef struct {
 } rpl_option_ht;
 END_PACK
 
+/**
+\brief A 6LoWPAN context (RFC6282 section 3.1.2).
+
+Context 0 is the prefix of my DODAG, see idmanager. The others are set by the
+DAG root through the bridge, and advertised in DIOs.
+*/
+typedef struct {
+   bool       used;
+   bool       compress;      ///< use to compress, not only to decompress
+   uint8_t    prefixLength;  ///< in bits
+   uint8_t    prefix[8];
+} iphc_context_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+   iphc_context_t contexts[IPHC_MAX_CONTEXTS]; // row 0 mirrors my prefix
+} iphc_vars_t;
+
 //=========================== variables =======================================
 
 //=========================== prototypes ======================================
@@ -231,6 +258,13 @@ owerror_t     iphc_sendFromForwarding(
 owerror_t     iphc_sendFromBridge(OpenQueueEntry_t *msg);
 void          iphc_sendDone(OpenQueueEntry_t *msg, owerror_t error);
 void          iphc_receive(OpenQueueEntry_t *msg);
+bool          iphc_isRelayed(OpenQueueEntry_t *msg);
+// 6LoWPAN contexts
+owerror_t     iphc_setContext(uint8_t cid, uint8_t* prefix, uint8_t prefixLength, bool compress);
+iphc_context_t* iphc_getContext(uint8_t cid);
+void          iphc_triggerSetContext(void);
+bool          iphc_lookupContext(open_addr_t* address, uint8_t* cid);
+void          iphc_compressMulticast(open_addr_t* dest, bool* dac, uint8_t* dam, uint8_t* dci);
 // called by forwarding when IPHC inner header required
 owerror_t iphc_prependIPv6Header(
    OpenQueueEntry_t*    msg,
@@ -240,7 +274,7 @@ owerror_t iphc_prependIPv6Header(
    uint8_t              value_nextHeader,
    uint8_t              hlim,
    uint8_t              value_hopLimit,
-   bool                 cid,
+   uint8_t              cid,
    bool                 sac,
    uint8_t              sam,
    bool                 m,
@@ -12,9 +12,15 @@
 #include "opentcp.h"
 #include "debugpins.h"
 #include "scheduler.h"
+#include "sourceroute.h"
+#include "IEEE802154E.h"
 
 //=========================== variables =======================================
 
+#ifdef RPL_STORING_MODE
+forwarding_vars_t forwarding_vars;
+#endif
+
 //=========================== prototypes ======================================
 
 void      forwarding_getNextHop(
@@ -39,6 +45,10 @@ void      forwarding_createRplOption(
    rpl_option_ht*       rpl_option,
    uint8_t              flags
 );
+#ifdef RPL_STORING_MODE
+uint8_t   forwarding_lookupRoute(open_addr_t* destination128b);
+bool      forwarding_isRouteExpired(uint8_t row);
+#endif
 
 
 //=========================== public ==========================================
@@ -47,6 +57,9 @@ void      forwarding_createRplOption(
 \brief Initialize this module.
 */
 void forwarding_init() {
+#ifdef RPL_STORING_MODE
+    memset(&forwarding_vars,0,sizeof(forwarding_vars_t));
+#endif
 }
 
 /**
@@ -74,11 +87,19 @@ owerror_t forwarding_send(OpenQueueEntry_t* msg) {
     uint8_t              sam;
     uint8_t              m;
     uint8_t              dam;
+    bool                 sac;
+    bool                 dac;
+    uint8_t              sci;
+    uint8_t              dci;
 
     // take ownership over the packet
     msg->owner                = COMPONENT_FORWARDING;
 
     m   = IPHC_M_NO;
+    sac = IPHC_SAC_STATELESS;
+    dac = IPHC_DAC_STATELESS;
+    sci = 0;
+    dci = 0;
 
     // retrieve my prefix and EUI64
     myprefix                  = idmanager_getMyID(ADDR_PREFIX);
@@ -128,13 +149,24 @@ owerror_t forwarding_send(OpenQueueEntry_t* msg) {
             ipv6_outer_header.src.type = ADDR_128B;
             memcpy(&ipv6_outer_header.src,p_src,sizeof(open_addr_t));
             ipv6_outer_header.hop_limit = IPHC_DEFAULT_HOP_LIMIT;
+            
+            // elide the prefixes known as 6LoWPAN contexts
+            if (iphc_lookupContext(&(msg->l3_sourceAdd),&sci)) {
+                sac = IPHC_SAC_STATEFUL;
+                sam = IPHC_SAM_64B;
+            }
+            if (iphc_lookupContext(&(msg->l3_destinationAdd),&dci)) {
+                dac = IPHC_DAC_STATEFUL;
+                dam = IPHC_DAM_64B;
+                p_dest = &temp_dest_mac64b;
+            }
         } else {
            // this is DIO, source address elided, multicast bit is set
             sam = IPHC_SAM_ELIDED;
             m   = IPHC_M_YES;
-            dam = IPHC_DAM_ELIDED;
             p_dest = &(msg->l3_destinationAdd);
             p_src = &(msg->l3_sourceAdd);
+            iphc_compressMulticast(&(msg->l3_destinationAdd),&dac,&dam,&dci);
         }
     }
     //IPHC inner header and NHC IPv6 header will be added at here
@@ -145,11 +177,11 @@ owerror_t forwarding_send(OpenQueueEntry_t* msg) {
                 msg->l4_protocol, 
                 IPHC_HLIM_64,
                 ipv6_outer_header.hop_limit,
-                IPHC_CID_NO,
-                IPHC_SAC_STATELESS,
+                (sci<<4)|dci,
+                sac,
                 sam,
                 m,
-                IPHC_DAC_STATELESS,
+                dac,
                 dam,
                 p_dest,
                 p_src,            
@@ -230,6 +262,10 @@ void forwarding_receive(
     ) {
     uint8_t flags;
     uint16_t senderRank;
+    bool down;
+#if DAO_AGGREGATION || defined(RPL_STORING_MODE)
+    uint8_t hlen;
+#endif
    
     // take ownership
     msg->owner                     = COMPONENT_FORWARDING;
@@ -288,6 +324,10 @@ void forwarding_receive(
         if (ipv6_outer_header->next_header!=IANA_IPv6ROUTE) {
             flags = rpl_option->flags;
             senderRank = rpl_option->senderRank;
+#ifdef RPL_STORING_MODE
+            // routed down from a route learnt from DAOs
+            down = (flags & O_FLAG)!=0;
+#else
             if ((flags & O_FLAG)!=0){
                 // wrong direction
                 // log error
@@ -298,7 +338,12 @@ void forwarding_receive(
                     (errorparameter_t)senderRank
                 );
             }
-            if (senderRank < neighbors_getMyDAGrank()){
+            down = FALSE;
+#endif
+            if (
+                (down==FALSE && senderRank < neighbors_getMyDAGrank()) ||
+                (down==TRUE  && senderRank > neighbors_getMyDAGrank())
+            ){
                 // loop detected
                 // set flag
                 rpl_option->flags |= R_FLAG;
@@ -311,6 +356,32 @@ void forwarding_receive(
                 );
             }
             forwarding_createRplOption(rpl_option, rpl_option->flags);
+#if DAO_AGGREGATION || defined(RPL_STORING_MODE)
+            hlen = ipv6_inner_header->header_length;
+            if (ipv6_outer_header->src.type != ADDR_NONE){
+                hlen += ipv6_outer_header->header_length;
+            }
+#endif
+#ifdef RPL_STORING_MODE
+            // the targets of the DAOs I relay are reachable through their sender
+            if (
+                msg->l4_protocol==IANA_ICMPv6 &&
+                hlen<msg->length
+            ) {
+                icmpv6rpl_indicateRxDAO(msg,msg->payload+hlen);
+            }
+#endif
+#if DAO_AGGREGATION
+            // DAOs are reported in mine rather than relayed
+            if (
+                msg->l4_protocol==IANA_ICMPv6 &&
+                hlen<msg->length &&
+                icmpv6rpl_aggregateDAO(msg,msg->payload+hlen)==TRUE
+            ) {
+                openqueue_freePacketBuffer(msg);
+                return;
+            }
+#endif
             // resend as if from upper layer
             if (
                 forwarding_send_internal_RoutingTable(
@@ -346,6 +417,85 @@ void forwarding_receive(
     }
 }
 
+#ifdef RPL_STORING_MODE
+/**
+\brief Add a downward route, or refresh it.
+
+\param[in] prefix       The prefix the route leads to.
+\param[in] prefixLength The length of that prefix, in bits.
+\param[in] nextHop      The 64-bit address of the neighbor to route through.
+*/
+void forwarding_addRoute(uint8_t* prefix, uint8_t prefixLength, open_addr_t* nextHop) {
+    uint8_t         i;
+    uint8_t         row;
+    uint8_t         prefixBuf[16];
+    
+    if (nextHop->type!=ADDR_64B || prefixLength>128) {
+        return;
+    }
+    if (
+        prefixLength==128 &&
+        memcmp(&prefix[8],idmanager_getMyID(ADDR_64B)->addr_64b,8)==0
+    ) {
+        // route to me
+        return;
+    }
+    
+    // only the bits of the prefix are carried
+    memset(prefixBuf,0,sizeof(prefixBuf));
+    memcpy(prefixBuf,prefix,(prefixLength+7)/8);
+    if (prefixLength%8!=0) {
+        prefixBuf[prefixLength/8] &= 0xff<<(8-prefixLength%8);
+    }
+    
+    // update the route if already there, else take a free or expired row
+    row = FORWARDING_MAXROUTES;
+    for (i=0;i<FORWARDING_MAXROUTES;i++) {
+        if (
+            forwarding_vars.routes[i].used==TRUE &&
+            forwarding_vars.routes[i].prefixLength==prefixLength &&
+            memcmp(forwarding_vars.routes[i].prefix,prefixBuf,16)==0
+        ) {
+            row = i;
+            break;
+        }
+        if (
+            row==FORWARDING_MAXROUTES &&
+            (
+                forwarding_vars.routes[i].used==FALSE ||
+                forwarding_isRouteExpired(i)==TRUE
+            )
+        ) {
+            row = i;
+        }
+    }
+    if (row==FORWARDING_MAXROUTES) {
+        openserial_printError(
+            COMPONENT_FORWARDING,
+            ERR_ROUTINGTABLE_FULL,
+            (errorparameter_t)FORWARDING_MAXROUTES,
+            (errorparameter_t)0
+        );
+        return;
+    }
+    
+    forwarding_vars.routes[row].used         = TRUE;
+    forwarding_vars.routes[row].prefixLength = prefixLength;
+    memcpy(forwarding_vars.routes[row].prefix,prefixBuf,16);
+    memcpy(forwarding_vars.routes[row].nextHop,nextHop->addr_64b,8);
+    forwarding_vars.routes[row].lastHeard    = ieee154e_getCoarseAsn();
+}
+
+/**
+\brief Indicate whether a downward route leads to a destination.
+
+\param[in] destination The IPv6 address of the destination.
+*/
+bool forwarding_hasRoute(open_addr_t* destination) {
+    return forwarding_lookupRoute(destination)!=FORWARDING_MAXROUTES;
+}
+#endif
+
 //=========================== private =========================================
 
 /**
@@ -357,6 +507,9 @@ void forwarding_receive(
 void forwarding_getNextHop(open_addr_t* destination128b, open_addr_t* addressToWrite64b) {
    uint8_t         i;
    open_addr_t     temp_prefix64btoWrite;
+#ifdef RPL_STORING_MODE
+   uint8_t         row;
+#endif
    
    if (packetfunctions_isBroadcastMulticast(destination128b)) {
       // IP destination is broadcast, send to 0xffffffffffffffff
@@ -367,6 +520,12 @@ void forwarding_getNextHop(open_addr_t* destination128b, open_addr_t* addressToW
    } else if (neighbors_isStableNeighbor(destination128b)) {
       // IP destination is 1-hop neighbor, send directly
       packetfunctions_ip128bToMac64b(destination128b,&temp_prefix64btoWrite,addressToWrite64b);
+#ifdef RPL_STORING_MODE
+   } else if ((row=forwarding_lookupRoute(destination128b))!=FORWARDING_MAXROUTES) {
+      // destination is below me, send to the child it was reported by
+      addressToWrite64b->type = ADDR_64B;
+      memcpy(addressToWrite64b->addr_64b,forwarding_vars.routes[row].nextHop,8);
+#endif
    } else {
       // destination is remote, send to preferred parent
       neighbors_getPreferredParentEui64(addressToWrite64b);
@@ -391,6 +550,57 @@ owerror_t forwarding_send_internal_RoutingTable(
       uint32_t*              flow_label,
       uint8_t                fw_SendOrfw_Rcv
    ) {
+#ifdef DAGROOT_ROUTING
+   uint8_t                   rh3[SOURCEROUTE_MAXHOPS*10];
+   uint8_t                   rh3_length;
+   
+   // as the DAG root, source route to nodes which are not my neighbors
+   if (
+         idmanager_getIsDAGroot()==TRUE &&
+         packetfunctions_isBroadcastMulticast(&(msg->l3_destinationAdd))==FALSE &&
+         neighbors_isStableNeighbor(&(msg->l3_destinationAdd))==FALSE
+      ) {
+      if (
+            sourceroute_getRoute(
+               &(msg->l3_destinationAdd),
+               &(msg->l2_nextORpreviousHop),
+               rh3,
+               &rh3_length
+            )==E_FAIL
+         ) {
+         openserial_printError(
+            COMPONENT_FORWARDING,
+            ERR_NO_NEXTHOP,
+            (errorparameter_t)1,
+            (errorparameter_t)0
+         );
+         return E_FAIL;
+      }
+      
+      if (ipv6_outer_header->src.type != ADDR_NONE){
+         packetfunctions_tossHeader(msg,ipv6_outer_header->header_length);
+      }
+      if (rh3_length>0) {
+         // encapsulate, from me
+         ipv6_outer_header->src.type = ADDR_128B;
+         memcpy(&(ipv6_outer_header->src.addr_128b[0]),idmanager_getMyID(ADDR_PREFIX)->prefix,8);
+         memcpy(&(ipv6_outer_header->src.addr_128b[8]),idmanager_getMyID(ADDR_64B)->addr_64b,8);
+         ipv6_outer_header->hop_limit = IPHC_DEFAULT_HOP_LIMIT;
+      }
+      rpl_option->flags |= O_FLAG;
+      
+      return iphc_sendFromForwarding(
+         msg,
+         ipv6_outer_header,
+         ipv6_inner_header,
+         rpl_option,
+         flow_label,
+         rh3,
+         rh3_length,
+         fw_SendOrfw_Rcv
+      );
+   }
+#endif
    
    // retrieve the next hop from the routing table
    forwarding_getNextHop(&(msg->l3_destinationAdd),&(msg->l2_nextORpreviousHop));
@@ -404,6 +614,15 @@ owerror_t forwarding_send_internal_RoutingTable(
       return E_FAIL;
    }
    
+#ifdef RPL_STORING_MODE
+   // anything but my parent is down the DODAG
+   if (neighbors_isPreferredParent(&(msg->l2_nextORpreviousHop))==TRUE) {
+      rpl_option->flags &= ~O_FLAG;
+   } else {
+      rpl_option->flags |= O_FLAG;
+   }
+#endif
+   
    if (ipv6_outer_header->src.type != ADDR_NONE){
       packetfunctions_tossHeader(msg,ipv6_outer_header->header_length);
    }
@@ -746,3 +965,57 @@ void forwarding_createRplOption(rpl_option_ht* rpl_option, uint8_t flags) {
     rpl_option->flags = (flags & ~I_FLAG & ~K_FLAG) | (I<<1) | K;
 }
 
+#ifdef RPL_STORING_MODE
+/**
+\brief Find the downward route with the longest prefix matching a destination.
+
+Expired routes met on the way are removed.
+
+\param[in] destination128b Final IPv6 destination address.
+
+\returns The row of the route, FORWARDING_MAXROUTES if there is none.
+*/
+uint8_t forwarding_lookupRoute(open_addr_t* destination128b) {
+    uint8_t         i;
+    uint8_t         row;
+    uint8_t         numBytes;
+    uint8_t         mask;
+    
+    row = FORWARDING_MAXROUTES;
+    if (destination128b->type!=ADDR_128B) {
+        return row;
+    }
+    for (i=0;i<FORWARDING_MAXROUTES;i++) {
+        if (
+            forwarding_vars.routes[i].used==FALSE ||
+            (
+                row!=FORWARDING_MAXROUTES &&
+                forwarding_vars.routes[i].prefixLength<=forwarding_vars.routes[row].prefixLength
+            )
+        ) {
+            continue;
+        }
+        numBytes = forwarding_vars.routes[i].prefixLength/8;
+        if (memcmp(forwarding_vars.routes[i].prefix,destination128b->addr_128b,numBytes)!=0) {
+            continue;
+        }
+        if (forwarding_vars.routes[i].prefixLength%8!=0) {
+            mask = 0xff<<(8-forwarding_vars.routes[i].prefixLength%8);
+            if ((destination128b->addr_128b[numBytes] & mask)!=forwarding_vars.routes[i].prefix[numBytes]) {
+                continue;
+            }
+        }
+        if (forwarding_isRouteExpired(i)==TRUE) {
+            forwarding_vars.routes[i].used = FALSE;
+            continue;
+        }
+        row = i;
+    }
+    return row;
+}
+
+bool forwarding_isRouteExpired(uint8_t row) {
+    return (uint16_t)(ieee154e_getCoarseAsn()-forwarding_vars.routes[row].lastHeard)>DAO_ROUTE_LIFETIME;
+}
+#endif
+
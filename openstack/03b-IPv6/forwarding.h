@@ -14,6 +14,10 @@
 
 #define RPL_HOPBYHOP_HEADER_OPTION_TYPE  0x63
 
+#ifndef FORWARDING_MAXROUTES
+#define FORWARDING_MAXROUTES      20     // downward routes, in storing mode
+#endif
+
 enum {
    PCKTFORWARD     = 1, // used by the node to indicate is forwarding a packet  -- either upstream or downstream
    PCKTSEND        = 2, // used by the node to indicate is sending a packet
@@ -47,8 +51,23 @@ typedef struct {
 } rpl_routing_ht;
 END_PACK
 
+/**
+\brief A downward route, learnt from the DAOs relayed in storing mode.
+*/
+typedef struct {
+   bool            used;
+   uint8_t         prefixLength;       ///< in bits, 128 for a route to a node.
+   uint8_t         prefix[16];
+   uint8_t         nextHop[8];         ///< EUI64 of the neighbor the DAO came from.
+   uint16_t        lastHeard;          ///< ASN of the last DAO, in units of 256 slots.
+} forwarding_route_t;
+
 //=========================== variables =======================================
 
+typedef struct {
+   forwarding_route_t   routes[FORWARDING_MAXROUTES];
+} forwarding_vars_t;
+
 //=========================== prototypes ======================================
 
 void      forwarding_init(void);
@@ -60,6 +79,14 @@ void      forwarding_receive(
    ipv6_header_iht*     ipv6_inner_header,
    rpl_option_ht*       rpl_option
 );
+#ifdef RPL_STORING_MODE
+void      forwarding_addRoute(
+   uint8_t*             prefix,
+   uint8_t              prefixLength,
+   open_addr_t*         nextHop
+);
+bool      forwarding_hasRoute(open_addr_t* destination);
+#endif
 
 /**
 \}
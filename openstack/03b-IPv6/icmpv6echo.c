@@ -4,6 +4,7 @@
 #include "openserial.h"
 #include "openqueue.h"
 #include "packetfunctions.h"
+#include "idmanager.h"
 #include "debugpins.h"
 
 //=========================== variables =======================================
@@ -93,6 +94,8 @@ void icmpv6echo_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
 
 void icmpv6echo_receive(OpenQueueEntry_t* msg) {
    OpenQueueEntry_t* reply;
+   open_addr_t       myAddress;
+   bool              samePseudoHeader;
    msg->owner = COMPONENT_ICMPv6ECHO;
    switch(msg->l4_sourcePortORicmpv6Type) {
       case IANA_ICMPv6_ECHO_REQUEST:
@@ -116,6 +119,14 @@ void icmpv6echo_receive(OpenQueueEntry_t* msg) {
          memcpy(reply->payload,msg->payload,msg->length);
          // copy source of msg in destination of reply
          memcpy(&(reply->l3_destinationAdd),&(msg->l3_sourceAdd),sizeof(open_addr_t));
+         // if msg was sent to my address, the pseudo-header of reply has the
+         // same addresses swapped, so only the type changes in the checksum
+         packetfunctions_mac64bToIp128b(
+            idmanager_getMyID(ADDR_PREFIX),
+            idmanager_getMyID(ADDR_64B),
+            &myAddress
+         );
+         samePseudoHeader = packetfunctions_sameAddress(&(msg->l3_destinationAdd),&myAddress);
          // free up msg
          openqueue_freePacketBuffer(msg);
          msg = NULL;
@@ -123,7 +134,15 @@ void icmpv6echo_receive(OpenQueueEntry_t* msg) {
          reply->l4_protocol                   = IANA_ICMPv6;
          reply->l4_sourcePortORicmpv6Type     = IANA_ICMPv6_ECHO_REPLY;
          ((ICMPv6_ht*)(reply->payload))->type = reply->l4_sourcePortORicmpv6Type;
-         packetfunctions_calculateChecksum(reply,(uint8_t*)&(((ICMPv6_ht*)(reply->payload))->checksum));//do last
+         if (samePseudoHeader==TRUE) {
+            packetfunctions_updateChecksum(
+               (uint8_t*)&(((ICMPv6_ht*)(reply->payload))->checksum),
+               (IANA_ICMPv6_ECHO_REQUEST<<8) | ((ICMPv6_ht*)(reply->payload))->code,
+               (IANA_ICMPv6_ECHO_REPLY<<8)   | ((ICMPv6_ht*)(reply->payload))->code
+            );
+         } else {
+            packetfunctions_calculateChecksum(reply,(uint8_t*)&(((ICMPv6_ht*)(reply->payload))->checksum));//do last
+         }
          icmpv6echo_vars.busySending = TRUE;
          if (icmpv6_send(reply)!=E_SUCCESS) {
             icmpv6echo_vars.busySending = FALSE;
@@ -10,6 +10,9 @@
 #include "idmanager.h"
 #include "opentimers.h"
 #include "IEEE802154E.h"
+#include "sourceroute.h"
+#include "forwarding.h"
+#include "iphc.h"
 
 //=========================== variables =======================================
 
@@ -20,11 +23,26 @@ icmpv6rpl_vars_t             icmpv6rpl_vars;
 // DIO-related
 void icmpv6rpl_timer_DIO_cb(opentimer_id_t id);
 void icmpv6rpl_timer_DIO_task(void);
+void startDIOInterval(void);
 void sendDIO(void);
+void sendDIS(void);
+void writeDIOContexts(OpenQueueEntry_t* msg);
+void parseDIOContexts(OpenQueueEntry_t* msg);
 // DAO-related
 void icmpv6rpl_timer_DAO_cb(opentimer_id_t id);
 void icmpv6rpl_timer_DAO_task(void);
 void sendDAO(void);
+uint8_t parseDAO(
+   OpenQueueEntry_t*    msg,
+   uint8_t*             dao,
+   uint8_t**            targets,
+   uint8_t*             prefixLengths,
+   uint8_t**            parents
+);
+#if DAO_AGGREGATION
+void writeDAOTargets(OpenQueueEntry_t* msg);
+void releaseDAOTargets(bool sent);
+#endif
 
 //=========================== public ==========================================
 
@@ -33,7 +51,6 @@ void sendDAO(void);
 */
 void icmpv6rpl_init() {
    uint8_t         dodagid[16];
-   uint32_t        dioPeriod;
    uint32_t        daoPeriod;
    
    // retrieve my prefix and EUI64
@@ -73,13 +90,14 @@ void icmpv6rpl_init() {
    memcpy(&icmpv6rpl_vars.dioDestination.addr_128b[0],all_routers_multicast,sizeof(all_routers_multicast));
    
    icmpv6rpl_vars.dioPeriod                 = TIMER_DIO_TIMEOUT;
-   dioPeriod                                = icmpv6rpl_vars.dioPeriod - 0x80 + (openrandom_get16b()&0xff);
+   icmpv6rpl_vars.dioInterval               = icmpv6rpl_vars.dioPeriod;
    icmpv6rpl_vars.timerIdDIO                = opentimers_start(
-                                                dioPeriod,
+                                                icmpv6rpl_vars.dioPeriod,
                                                 TIMER_PERIODIC,
                                                 TIME_MS,
                                                 icmpv6rpl_timer_DIO_cb
                                              );
+   startDIOInterval();
    
    //=== DAO
    
@@ -121,6 +139,7 @@ void icmpv6rpl_init() {
    icmpv6rpl_vars.dao_target.prefixLength = 0;
    
    icmpv6rpl_vars.daoPeriod                 = TIMER_DAO_TIMEOUT;
+   icmpv6rpl_vars.daoInterval               = icmpv6rpl_vars.daoPeriod;
    daoPeriod                                = icmpv6rpl_vars.daoPeriod - 0x80 + (openrandom_get16b()&0xff);
    icmpv6rpl_vars.timerIdDAO                = opentimers_start(
                                                 daoPeriod,
@@ -203,7 +222,16 @@ void icmpv6rpl_receive(OpenQueueEntry_t* msg) {
    // handle message
    switch (icmpv6code) {
       case IANA_ICMPv6_RPL_DIS:
-         icmpv6rpl_timer_DIO_task();
+         if (neighbors_getMyDAGrank()==DEFAULTDAGRANK) {
+            // no DODAG to advertise, and my own DIS are backed off
+            break;
+         }
+         if (packetfunctions_isBroadcastMulticast(&(msg->l3_destinationAdd))==TRUE) {
+            // a neighbor is looking for a DODAG, advertise it promptly
+            icmpv6rpl_resetDIOTrickle();
+         } else {
+            sendDIO();
+         }
          break;
       case IANA_ICMPv6_RPL_DIO:
          if (idmanager_getIsDAGroot()==TRUE) {
@@ -211,9 +239,20 @@ void icmpv6rpl_receive(OpenQueueEntry_t* msg) {
             break; // break, don't return
          }
          
+         // consistent DIO, unless it changes my routing state, in which case
+         // the neighbor table resets the Trickle timer
+         if (icmpv6rpl_vars.dioCounter<0xff) {
+            icmpv6rpl_vars.dioCounter++;
+         }
+         
          // update neighbor table
          neighbors_indicateRxDIO(msg);
          
+         // my 6LoWPAN contexts are those of my preferred parent
+         if (neighbors_isPreferredParent(&(msg->l2_nextORpreviousHop))==TRUE) {
+            parseDIOContexts(msg);
+         }
+         
          // write DODAGID in DIO and DAO
          icmpv6rpl_writeDODAGid(&(((icmpv6rpl_dio_ht*)(msg->payload))->DODAGID[0]));
          
@@ -247,6 +286,175 @@ void icmpv6rpl_receive(OpenQueueEntry_t* msg) {
    openqueue_freePacketBuffer(msg);
 }
 
+#if defined(DAGROOT_ROUTING) || defined(RPL_STORING_MODE)
+/**
+\brief Learn the downward routes from a DAO I am relaying or receiving.
+
+As the DAG root, the parents listed in the DAO are recorded to source route.
+In storing mode, the targets are routed through the neighbor the DAO came from.
+
+The DAO is not consumed, it is still relayed, or bridged to the OpenVisualizer
+by the DAG root.
+
+\param[in] msg    The DAO, with its source address and previous hop set.
+\param[in] icmpv6 Pointer to the ICMPv6 header in the packet.
+*/
+void icmpv6rpl_indicateRxDAO(OpenQueueEntry_t* msg, uint8_t* icmpv6) {
+   uint8_t*        targets[DAO_MAXTARGETS];
+   uint8_t         prefixLengths[DAO_MAXTARGETS];
+   uint8_t*        parents[DAO_MAXTARGETS];
+   uint8_t         numParents;
+   uint8_t         i;
+   
+   if (
+         msg->length<(icmpv6-msg->payload)+sizeof(ICMPv6_ht) ||
+         ((ICMPv6_ht*)icmpv6)->type!=IANA_ICMPv6_RPL ||
+         ((ICMPv6_ht*)icmpv6)->code!=IANA_ICMPv6_RPL_DAO
+      ) {
+      return;
+   }
+   
+   numParents = parseDAO(msg,icmpv6+sizeof(ICMPv6_ht),targets,prefixLengths,parents);
+   for (i=0;i<numParents;i++) {
+#ifdef DAGROOT_ROUTING
+      if (idmanager_getIsDAGroot()==TRUE && prefixLengths[i]==128) {
+         sourceroute_setParent(targets[i],parents[i]);
+      }
+#endif
+#ifdef RPL_STORING_MODE
+      forwarding_addRoute(targets[i],prefixLengths[i],&(msg->l2_nextORpreviousHop));
+#endif
+   }
+}
+#endif
+
+#if DAO_AGGREGATION
+/**
+\brief Absorb a DAO I am relaying, to report its targets in my next DAO.
+
+The DAO is absorbed only if all its targets fit in the targets table, and
+each one fits in a DAO of mine. With the default DAO_MAXLENGTH, only a
+target whose parent is me fits, so DAOs are aggregated over one hop.
+
+\param[in] msg    The DAO being relayed.
+\param[in] icmpv6 Pointer to the ICMPv6 header in the packet.
+
+\returns TRUE if the DAO was absorbed, and should not be relayed.
+*/
+bool icmpv6rpl_aggregateDAO(OpenQueueEntry_t* msg, uint8_t* icmpv6) {
+   uint8_t*        targets[DAO_MAXTARGETS];
+   uint8_t         prefixLengths[DAO_MAXTARGETS];
+   uint8_t*        parents[DAO_MAXTARGETS];
+   uint8_t         numParents;
+   uint8_t         numFree;
+   uint8_t         myAddress[16];
+   uint8_t         maxLength;
+   uint8_t         i,j;
+   
+   // only report targets if I can send DAOs myself
+   if (
+         idmanager_getIsDAGroot()==TRUE ||
+         neighbors_getMyDAGrank()==DEFAULTDAGRANK ||
+         ieee154e_isSynch()==FALSE
+      ) {
+      return FALSE;
+   }
+   
+   // only absorb DAOs to my DODAG root
+   if (
+         msg->l3_sourceAdd.type!=ADDR_128B ||
+         msg->l3_destinationAdd.type!=ADDR_128B ||
+         memcmp(msg->l3_destinationAdd.addr_128b,icmpv6rpl_vars.dao.DODAGID,16)!=0
+      ) {
+      return FALSE;
+   }
+   
+   if (
+         msg->length<(icmpv6-msg->payload)+sizeof(ICMPv6_ht) ||
+         ((ICMPv6_ht*)icmpv6)->type!=IANA_ICMPv6_RPL ||
+         ((ICMPv6_ht*)icmpv6)->code!=IANA_ICMPv6_RPL_DAO
+      ) {
+      return FALSE;
+   }
+   numParents = parseDAO(msg,icmpv6+sizeof(ICMPv6_ht),targets,prefixLengths,parents);
+   if (numParents==0) {
+      return FALSE;
+   }
+   
+   //===== store the targets, if they all fit
+   
+   // room left in my DAO, see writeDAOTargets()
+   memcpy(&myAddress[0],idmanager_getMyID(ADDR_PREFIX)->prefix,8);
+   memcpy(&myAddress[8],idmanager_getMyID(ADDR_64B)->addr_64b,8);
+   maxLength = DAO_MAXLENGTH-sizeof(icmpv6rpl_dao_ht)-
+               sizeof(icmpv6rpl_dao_transit_ht)-LENGTH_ADDR128b;
+   for (i=0;i<numParents;i++) {
+      if (prefixLengths[i]!=128) {
+         // only addresses are reported
+         return FALSE;
+      }
+      if (
+            memcmp(parents[i],myAddress,16)!=0 &&
+            2*LENGTH_ADDR128b+sizeof(icmpv6rpl_dao_target_ht)+
+            sizeof(icmpv6rpl_dao_transit_ht)>maxLength
+         ) {
+         return FALSE;
+      }
+   }
+   
+   numFree = 0;
+   for (j=0;j<DAO_AGGREGATION_MAXTARGETS;j++) {
+      if (icmpv6rpl_vars.daoTargets[j].used==FALSE) {
+         numFree++;
+      }
+   }
+   for (i=0;i<numParents;i++) {
+      for (j=0;j<DAO_AGGREGATION_MAXTARGETS;j++) {
+         if (
+               icmpv6rpl_vars.daoTargets[j].used==TRUE &&
+               memcmp(icmpv6rpl_vars.daoTargets[j].target,targets[i],16)==0
+            ) {
+            break;
+         }
+      }
+      if (j==DAO_AGGREGATION_MAXTARGETS) {
+         if (numFree==0) {
+            return FALSE;
+         }
+         numFree--;
+      }
+   }
+   
+   for (i=0;i<numParents;i++) {
+      // update the target if already there, else take a free entry
+      for (j=0;j<DAO_AGGREGATION_MAXTARGETS;j++) {
+         if (
+               icmpv6rpl_vars.daoTargets[j].used==TRUE &&
+               memcmp(icmpv6rpl_vars.daoTargets[j].target,targets[i],16)==0
+            ) {
+            break;
+         }
+      }
+      if (j==DAO_AGGREGATION_MAXTARGETS) {
+         for (j=0;j<DAO_AGGREGATION_MAXTARGETS;j++) {
+            if (icmpv6rpl_vars.daoTargets[j].used==FALSE) {
+               break;
+            }
+         }
+      }
+      icmpv6rpl_vars.daoTargets[j].used  = TRUE;
+      memcpy(icmpv6rpl_vars.daoTargets[j].target,targets[i],16);
+      memcpy(icmpv6rpl_vars.daoTargets[j].parent,parents[i],16);
+   }
+   icmpv6rpl_vars.numDAOaggregated++;
+   
+   // report them after the damping delay, along with other DAOs to come
+   icmpv6rpl_triggerDAO();
+   
+   return TRUE;
+}
+#endif
+
 //=========================== private =========================================
 
 //===== DIO-related
@@ -264,19 +472,79 @@ void icmpv6rpl_timer_DIO_cb(opentimer_id_t id) {
 /**
 \brief Handler for DIO timer event.
 
+The DIO timer follows the Trickle algorithm (RFC6206): it fires once at time
+t within the current interval I, where a DIO is sent unless k consistent ones
+were heard during the interval, then once at the end of the interval, which
+is doubled, up to Imax. Without a DAG rank, a DIS is sent instead of the DIO,
+and the interval is doubled up to Imin*2^DIS_INTERVAL_DOUBLINGS.
+
 \note This function is executed in task context, called by the scheduler.
 */
 void icmpv6rpl_timer_DIO_task() {
-   uint32_t        dioPeriod;
-   // send DIO
-   sendDIO();
+   if (icmpv6rpl_vars.dioIntervalEnding==FALSE) {
+      // t reached
+      if (
+            DIO_REDUNDANCY_CONSTANT==0 ||
+            icmpv6rpl_vars.dioCounter<DIO_REDUNDANCY_CONSTANT
+         ) {
+         sendDIO();
+      } else {
+         icmpv6rpl_vars.numDIOsuppressed++;
+      }
+      
+      // wait for the end of the interval
+      icmpv6rpl_vars.dioIntervalEnding = TRUE;
+      opentimers_setPeriod(
+         icmpv6rpl_vars.timerIdDIO,
+         TIME_MS,
+         icmpv6rpl_vars.dioInterval-icmpv6rpl_vars.dioTransmitTime
+      );
+   } else {
+      // end of the interval, double it, DIS back off less than DIOs
+      if (neighbors_getMyDAGrank()==DEFAULTDAGRANK) {
+         if (icmpv6rpl_vars.dioInterval<(icmpv6rpl_vars.dioPeriod<<DIS_INTERVAL_DOUBLINGS)) {
+            icmpv6rpl_vars.dioInterval *= 2;
+         }
+      } else if (icmpv6rpl_vars.dioInterval<(icmpv6rpl_vars.dioPeriod<<DIO_INTERVAL_DOUBLINGS)) {
+         icmpv6rpl_vars.dioInterval *= 2;
+      }
+      startDIOInterval();
+   }
+}
+
+/**
+\brief Reset the DIO Trickle timer to its minimum interval.
+
+Call this function when an inconsistency is detected, e.g. my preferred
+parent or my DAGRank changed, or a neighbor solicited DIOs. Nothing happens
+if the interval is already the minimum one (RFC6206, section 4.2).
+*/
+void icmpv6rpl_resetDIOTrickle() {
+   if (icmpv6rpl_vars.dioInterval==icmpv6rpl_vars.dioPeriod) {
+      return;
+   }
+   icmpv6rpl_vars.dioInterval = icmpv6rpl_vars.dioPeriod;
+   startDIOInterval();
+}
+
+/**
+\brief Start a new Trickle interval, picking t in [I/2, I).
+*/
+void startDIOInterval() {
+   uint32_t        halfInterval;
+   uint32_t        random;
+   
+   halfInterval = icmpv6rpl_vars.dioInterval/2;
+   random       = ((uint32_t)openrandom_get16b()<<16) | openrandom_get16b();
+   
+   icmpv6rpl_vars.dioCounter        = 0;
+   icmpv6rpl_vars.dioIntervalEnding = FALSE;
+   icmpv6rpl_vars.dioTransmitTime   = halfInterval + (halfInterval>0 ? random%halfInterval : 0);
    
-   // arm the DIO timer with this new value
-   dioPeriod = icmpv6rpl_vars.dioPeriod - 0x80 + (openrandom_get16b()&0xff);
    opentimers_setPeriod(
       icmpv6rpl_vars.timerIdDIO,
       TIME_MS,
-      dioPeriod
+      icmpv6rpl_vars.dioTransmitTime
    );
 }
 
@@ -299,13 +567,14 @@ void sendDIO() {
       return;
    }
    
-   // do not send DIO if I have the default DAG rank
-   if (neighbors_getMyDAGrank()==DEFAULTDAGRANK) {
+   // do not send DIO if I'm already busy sending
+   if (icmpv6rpl_vars.busySending==TRUE) {
       return;
    }
    
-   // do not send DIO if I'm already busy sending
-   if (icmpv6rpl_vars.busySending==TRUE) {
+   // do not send DIO if I have the default DAG rank, solicit one instead
+   if (neighbors_getMyDAGrank()==DEFAULTDAGRANK) {
+      sendDIS();
       return;
    }
    
@@ -336,6 +605,9 @@ void sendDIO() {
    // set DIO destination
    memcpy(&(msg->l3_destinationAdd),&icmpv6rpl_vars.dioDestination,sizeof(open_addr_t));
    
+   //===== DIO options
+   writeDIOContexts(msg);
+   
    //===== DIO payload
    // note: DIO is already mostly populated
    icmpv6rpl_vars.dio.rank                  = neighbors_getMyDAGrank();
@@ -362,11 +634,234 @@ void sendDIO() {
       openqueue_freePacketBuffer(msg);
    } else {
       icmpv6rpl_vars.busySending = FALSE; 
+      icmpv6rpl_vars.numDIOsent++;
+   }
+}
+
+/**
+\brief Prepare and a send a RPL DIS, to solicit DIOs from my neighbors.
+*/
+void sendDIS() {
+   OpenQueueEntry_t*    msg;
+   
+   // reserve a free packet buffer for DIS
+   msg = openqueue_getFreePacketBuffer(COMPONENT_ICMPv6RPL);
+   if (msg==NULL) {
+      openserial_printError(COMPONENT_ICMPv6RPL,ERR_NO_FREE_PACKET_BUFFER,
+                            (errorparameter_t)0,
+                            (errorparameter_t)0);
+      return;
+   }
+   
+   // take ownership
+   msg->creator                             = COMPONENT_ICMPv6RPL;
+   msg->owner                               = COMPONENT_ICMPv6RPL;
+   
+   // set transport information
+   msg->l4_protocol                         = IANA_ICMPv6;
+   msg->l4_sourcePortORicmpv6Type           = IANA_ICMPv6_RPL;
+   
+   // same destination as DIOs
+   memcpy(&(msg->l3_destinationAdd),&icmpv6rpl_vars.dioDestination,sizeof(open_addr_t));
+   
+   //===== DIS payload
+   packetfunctions_reserveHeaderSize(msg,sizeof(icmpv6rpl_dis_ht));
+   ((icmpv6rpl_dis_ht*)(msg->payload))->flags    = 0x00;
+   ((icmpv6rpl_dis_ht*)(msg->payload))->reserved = 0x00;
+   
+   //===== ICMPv6 header
+   packetfunctions_reserveHeaderSize(msg,sizeof(ICMPv6_ht));
+   ((ICMPv6_ht*)(msg->payload))->type       = msg->l4_sourcePortORicmpv6Type;
+   ((ICMPv6_ht*)(msg->payload))->code       = IANA_ICMPv6_RPL_DIS;
+   packetfunctions_calculateChecksum(msg,(uint8_t*)&(((ICMPv6_ht*)(msg->payload))->checksum));//call last
+   
+   //send
+   if (icmpv6_send(msg)!=E_SUCCESS) {
+      openqueue_freePacketBuffer(msg);
+   }
+}
+
+/**
+\brief Append the 6LoWPAN contexts I know of as options to the DIO.
+
+Context 0, the DODAG prefix, is not advertised: it is the DODAGID.
+
+\param[in,out] msg The DIO, before its base is written.
+*/
+void writeDIOContexts(OpenQueueEntry_t* msg) {
+   iphc_context_t* context;
+   uint8_t         cid;
+   
+   for (cid=IPHC_MAX_CONTEXTS-1;cid>0;cid--) {
+      context = iphc_getContext(cid);
+      if (context==NULL) {
+         continue;
+      }
+      packetfunctions_reserveHeaderSize(msg,DIO_CONTEXT_OPTION_LENGTH);
+      msg->payload[0] = OPTION_6LOWPAN_CONTEXT_TYPE;
+      msg->payload[1] = DIO_CONTEXT_OPTION_LENGTH-2;
+      msg->payload[2] = context->prefixLength;
+      msg->payload[3] = cid & DIO_CONTEXT_CID;
+      if (context->compress==TRUE) {
+         msg->payload[3] |= DIO_CONTEXT_C;
+      }
+      memcpy(&msg->payload[4],context->prefix,sizeof(context->prefix));
+   }
+}
+
+/**
+\brief Mirror the 6LoWPAN contexts advertised in a DIO of my preferred parent.
+
+Contexts not in the DIO are removed.
+
+\param[in] msg The DIO, its payload pointing at the DIO base.
+*/
+void parseDIOContexts(OpenQueueEntry_t* msg) {
+   uint8_t*        option;
+   int16_t         length;             // of the options left to parse
+   uint16_t        seen;               // bitmap of the contexts in the DIO
+   uint8_t         cid;
+   
+   if (msg->length<(int16_t)sizeof(icmpv6rpl_dio_ht)) {
+      return;
+   }
+   option = msg->payload+sizeof(icmpv6rpl_dio_ht);
+   length = msg->length-sizeof(icmpv6rpl_dio_ht);
+   seen   = 0;
+   while (length>0) {
+      if (option[0]==0x00) {
+         // Pad1
+         option++;
+         length--;
+         continue;
+      }
+      if (length<2 || length<2+option[1]) {
+         // malformed, keep my contexts
+         return;
+      }
+      if (
+            option[0]==OPTION_6LOWPAN_CONTEXT_TYPE &&
+            option[1]>=DIO_CONTEXT_OPTION_LENGTH-2
+         ) {
+         cid = option[3] & DIO_CONTEXT_CID;
+         if (
+               cid>0 &&
+               iphc_setContext(
+                  cid,
+                  &option[4],
+                  option[2],
+                  (option[3] & DIO_CONTEXT_C)!=0
+               )==E_SUCCESS
+            ) {
+            seen |= 1<<cid;
+         }
+      }
+      length -= 2+option[1];
+      option += 2+option[1];
+   }
+   
+   for (cid=1;cid<IPHC_MAX_CONTEXTS;cid++) {
+      if ((seen & (1<<cid))==0) {
+         iphc_setContext(cid,NULL,0,FALSE);
+      }
    }
 }
 
 //===== DAO-related
 
+/**
+\brief Retrieve the (target, parent) pairs listed in a DAO.
+
+Each Transit option of a DAO holds the parent of the Target options which
+precede it. The first Transit option holds the parent of the DAO's source, the
+Target options before it are ignored. A Transit option without a parent
+address designates the DAO's source as the parent.
+
+\param[in]  msg           The packet containing the DAO.
+\param[in]  dao           Pointer to the DAO header in the packet.
+\param[out] targets       The IPv6 prefixes of the targets, the DAO's source
+   first.
+\param[out] prefixLengths The length of these prefixes, in bits.
+\param[out] parents       The IPv6 addresses of their parents.
+
+\returns The number of pairs, 0 if the DAO is malformed or lists more than
+   DAO_MAXTARGETS targets.
+*/
+uint8_t parseDAO(
+      OpenQueueEntry_t* msg,
+      uint8_t*          dao,
+      uint8_t**         targets,
+      uint8_t*          prefixLengths,
+      uint8_t**         parents
+   ) {
+   uint8_t         numTargets;         // targets found so far
+   uint8_t         numParents;         // targets with a known parent
+   uint8_t*        option;
+   uint8_t         optionLength;
+   int16_t         length;             // of the options left to parse
+   
+   length = msg->length-(dao-msg->payload);
+   if (
+         msg->l3_sourceAdd.type!=ADDR_128B ||
+         length<(int16_t)sizeof(icmpv6rpl_dao_ht) ||
+         (((icmpv6rpl_dao_ht*)dao)->K_D_flags & D_DAO)==0
+      ) {
+      return 0;
+   }
+   option  = dao+sizeof(icmpv6rpl_dao_ht);
+   length -= sizeof(icmpv6rpl_dao_ht);
+   
+   targets[0]       = msg->l3_sourceAdd.addr_128b;
+   prefixLengths[0] = 128;
+   numTargets       = 1;
+   numParents = 0;
+   while (length>0) {
+      if (option[0]==0x00) {
+         // Pad1
+         option++;
+         length--;
+         continue;
+      }
+      if (length<2 || length<2+option[1]) {
+         return 0;
+      }
+      optionLength = 2+option[1];
+      switch (option[0]) {
+         case OPTION_TARGET_INFORMATION_TYPE:
+            if (numParents==0) {
+               // target of the source's own group
+               break;
+            }
+            if (
+                  option[3]>128 ||
+                  optionLength<sizeof(icmpv6rpl_dao_target_ht)+(option[3]+7)/8 ||
+                  numTargets==DAO_MAXTARGETS
+               ) {
+               return 0;
+            }
+            prefixLengths[numTargets] = option[3];
+            targets[numTargets++]     = option+sizeof(icmpv6rpl_dao_target_ht);
+            break;
+         case OPTION_TRANSIT_INFORMATION_TYPE:
+            for (;numParents<numTargets;numParents++) {
+               if (optionLength>=sizeof(icmpv6rpl_dao_transit_ht)+LENGTH_ADDR128b) {
+                  parents[numParents] = option+sizeof(icmpv6rpl_dao_transit_ht);
+               } else if (numParents>0) {
+                  parents[numParents] = msg->l3_sourceAdd.addr_128b;
+               } else {
+                  return 0;
+               }
+            }
+            break;
+         default:
+            break;
+      }
+      option += optionLength;
+      length -= optionLength;
+   }
+   return numParents;
+}
+
 /**
 \brief DAO timer callback function.
 
@@ -380,21 +875,73 @@ void icmpv6rpl_timer_DAO_cb(opentimer_id_t id) {
 /**
 \brief Handler for DAO timer event.
 
+The DAO timer fires either DAO_DAMPING_DELAY after a change (see
+icmpv6rpl_triggerDAO()), or to refresh the route. The refresh interval starts
+at daoPeriod after a change, and doubles at each refresh, up to
+daoPeriod*2^DAO_REFRESH_DOUBLINGS.
+
 \note This function is executed in task context, called by the scheduler.
 */
 void icmpv6rpl_timer_DAO_task() {
    uint32_t        daoPeriod;
+   bool            refresh;
+#if DAO_AGGREGATION
+   uint8_t         i;
+#endif
+   
+   refresh                   = !icmpv6rpl_vars.daoPending;
+   icmpv6rpl_vars.daoPending = FALSE;
    
    // send DAO
    sendDAO();
    
+   // back off the refresh interval
+   if (
+         refresh==TRUE &&
+         icmpv6rpl_vars.daoInterval<(icmpv6rpl_vars.daoPeriod<<DAO_REFRESH_DOUBLINGS)
+      ) {
+      icmpv6rpl_vars.daoInterval *= 2;
+   }
+   
    // arm the DAO timer with this new value
-   daoPeriod = icmpv6rpl_vars.daoPeriod - 0x80 + (openrandom_get16b()&0xff);
+   daoPeriod = icmpv6rpl_vars.daoInterval - 0x80 + (openrandom_get16b()&0xff);
    opentimers_setPeriod(
       icmpv6rpl_vars.timerIdDAO,
       TIME_MS,
       daoPeriod
    );
+   
+#if DAO_AGGREGATION
+   // report the targets which did not fit in this DAO promptly
+   for (i=0;i<DAO_AGGREGATION_MAXTARGETS;i++) {
+      if (icmpv6rpl_vars.daoTargets[i].used==TRUE) {
+         icmpv6rpl_triggerDAO();
+         break;
+      }
+   }
+#endif
+}
+
+/**
+\brief Schedule a DAO, DAO_DAMPING_DELAY from now.
+
+Call this function when the information in my DAO changed, e.g. my preferred
+parent changed. All changes until the DAO is sent are reported in that single
+DAO. The refresh interval restarts from daoPeriod.
+*/
+void icmpv6rpl_triggerDAO() {
+   // a DAO is already scheduled, it will report this change as well
+   if (icmpv6rpl_vars.daoPending==TRUE) {
+      return;
+   }
+   
+   icmpv6rpl_vars.daoPending  = TRUE;
+   icmpv6rpl_vars.daoInterval = icmpv6rpl_vars.daoPeriod;
+   opentimers_setPeriod(
+      icmpv6rpl_vars.timerIdDAO,
+      TIME_MS,
+      DAO_DAMPING_DELAY + (openrandom_get16b()&0xff)
+   );
 }
 
 /**
@@ -460,6 +1007,11 @@ void sendDAO() {
    
    //===== fill in packet
    
+#if DAO_AGGREGATION
+   // targets learnt from relayed DAOs, after my own Transit option
+   writeDAOTargets(msg);
+#endif
+   
    //NOTE: limit to preferrred parent only the number of DAO transit addresses to send
    
    //=== transit option -- from RFC 6550, page 55 - 1 transit information header per parent is required. 
@@ -496,6 +1048,14 @@ void sendDAO() {
       if ((neighbors_isNeighborWithHigherDAGrank(nbrIdx))==TRUE) {
          // this neighbor is of higher DAGrank as I am. so it is my child
          
+         // stop if the DAO would not fit in a frame
+         if (
+               msg->length+LENGTH_ADDR128b+sizeof(icmpv6rpl_dao_target_ht)+
+               sizeof(icmpv6rpl_dao_ht)>DAO_MAXLENGTH
+            ) {
+            break;
+         }
+         
          // write it's address in DAO RFC6550 page 80 check point 1.
          neighbors_getNeighbor(&address,ADDR_64B,nbrIdx); 
          packetfunctions_writeAddress(msg,&address,OW_BIG_ENDIAN);
@@ -530,6 +1090,9 @@ void sendDAO() {
    
    // stop here if no parents found
    if (numTransitParents==0) {
+#if DAO_AGGREGATION
+      releaseDAOTargets(FALSE);
+#endif
       openqueue_freePacketBuffer(msg);
       return;
    }
@@ -555,21 +1118,130 @@ void sendDAO() {
    //===== send
    if (icmpv6_send(msg)==E_SUCCESS) {
       icmpv6rpl_vars.busySending = TRUE;
+      icmpv6rpl_vars.numDAOsent++;
+#if DAO_AGGREGATION
+      releaseDAOTargets(TRUE);
+#endif
    } else {
+#if DAO_AGGREGATION
+      releaseDAOTargets(FALSE);
+#endif
       openqueue_freePacketBuffer(msg);
    }
 }
 
-void icmpv6rpl_setDIOPeriod(uint16_t dioPeriod){
-   uint32_t        dioPeriodRandom;
+#if DAO_AGGREGATION
+/**
+\brief Write the targets learnt from relayed DAOs into my DAO.
+
+Targets are grouped by parent: the Target options of a group are followed by
+a Transit option holding their parent's address. That address is omitted when
+the parent is me, the source of the DAO. Targets which do not fit in
+DAO_MAXLENGTH are left for my next DAO.
+
+\param[in,out] msg The DAO being built, before my own Transit option is
+   written.
+*/
+void writeDAOTargets(OpenQueueEntry_t* msg) {
+   uint8_t         myAddress[16];
+   uint8_t         maxLength;
+   uint8_t         transitLength;
+   uint8_t         i,j;
    
-   icmpv6rpl_vars.dioPeriod = dioPeriod;
-   dioPeriodRandom = icmpv6rpl_vars.dioPeriod - 0x80 + (openrandom_get16b()&0xff);
-   opentimers_setPeriod(
-       icmpv6rpl_vars.timerIdDIO,
-       TIME_MS,
-       dioPeriodRandom
-   );
+   memcpy(&myAddress[0],idmanager_getMyID(ADDR_PREFIX)->prefix,8);
+   memcpy(&myAddress[8],idmanager_getMyID(ADDR_64B)->addr_64b,8);
+   
+   // leave room for the DAO header and my own Transit option
+   maxLength = DAO_MAXLENGTH-sizeof(icmpv6rpl_dao_ht)-
+               sizeof(icmpv6rpl_dao_transit_ht)-LENGTH_ADDR128b;
+   
+   for (i=0;i<DAO_AGGREGATION_MAXTARGETS;i++) {
+      if (
+            icmpv6rpl_vars.daoTargets[i].used==FALSE ||
+            icmpv6rpl_vars.daoTargets[i].inDAO==TRUE
+         ) {
+         continue;
+      }
+      
+      transitLength = sizeof(icmpv6rpl_dao_transit_ht);
+      if (memcmp(icmpv6rpl_vars.daoTargets[i].parent,myAddress,16)!=0) {
+         transitLength += LENGTH_ADDR128b;
+      }
+      if (
+            msg->length+transitLength+
+            sizeof(icmpv6rpl_dao_target_ht)+LENGTH_ADDR128b>maxLength
+         ) {
+         // a group with a shorter Transit option might still fit
+         continue;
+      }
+      
+      // Transit option, written first since the packet is built backwards
+      if (transitLength>sizeof(icmpv6rpl_dao_transit_ht)) {
+         packetfunctions_reserveHeaderSize(msg,LENGTH_ADDR128b);
+         memcpy(msg->payload,icmpv6rpl_vars.daoTargets[i].parent,LENGTH_ADDR128b);
+      }
+      packetfunctions_reserveHeaderSize(msg,sizeof(icmpv6rpl_dao_transit_ht));
+      memcpy(
+         ((icmpv6rpl_dao_transit_ht*)(msg->payload)),
+         &(icmpv6rpl_vars.dao_transit),
+         sizeof(icmpv6rpl_dao_transit_ht)
+      );
+      ((icmpv6rpl_dao_transit_ht*)(msg->payload))->optionLength = transitLength-2;
+      ((icmpv6rpl_dao_transit_ht*)(msg->payload))->PathControl  = 0;
+      
+      // Target options of all the targets with that parent
+      for (j=i;j<DAO_AGGREGATION_MAXTARGETS;j++) {
+         if (
+               icmpv6rpl_vars.daoTargets[j].used==FALSE ||
+               icmpv6rpl_vars.daoTargets[j].inDAO==TRUE ||
+               memcmp(
+                  icmpv6rpl_vars.daoTargets[j].parent,
+                  icmpv6rpl_vars.daoTargets[i].parent,
+                  16
+               )!=0
+            ) {
+            continue;
+         }
+         if (msg->length+sizeof(icmpv6rpl_dao_target_ht)+LENGTH_ADDR128b>maxLength) {
+            break;
+         }
+         packetfunctions_reserveHeaderSize(msg,LENGTH_ADDR128b);
+         memcpy(msg->payload,icmpv6rpl_vars.daoTargets[j].target,LENGTH_ADDR128b);
+         packetfunctions_reserveHeaderSize(msg,sizeof(icmpv6rpl_dao_target_ht));
+         ((icmpv6rpl_dao_target_ht*)(msg->payload))->type          = OPTION_TARGET_INFORMATION_TYPE;
+         ((icmpv6rpl_dao_target_ht*)(msg->payload))->optionLength  = LENGTH_ADDR128b+sizeof(icmpv6rpl_dao_target_ht)-2;
+         ((icmpv6rpl_dao_target_ht*)(msg->payload))->flags         = 0;
+         ((icmpv6rpl_dao_target_ht*)(msg->payload))->prefixLength  = 128;
+         icmpv6rpl_vars.daoTargets[j].inDAO = TRUE;
+      }
+   }
+}
+
+/**
+\brief Forget the targets written in the last DAO, once it is sent.
+
+\param[in] sent TRUE if the DAO was sent, FALSE to report these targets again
+   in the next DAO.
+*/
+void releaseDAOTargets(bool sent) {
+   uint8_t         i;
+   
+   for (i=0;i<DAO_AGGREGATION_MAXTARGETS;i++) {
+      if (icmpv6rpl_vars.daoTargets[i].inDAO==TRUE) {
+         icmpv6rpl_vars.daoTargets[i].inDAO = FALSE;
+         if (sent==TRUE) {
+            icmpv6rpl_vars.daoTargets[i].used = FALSE;
+         }
+      }
+   }
+}
+#endif
+
+void icmpv6rpl_setDIOPeriod(uint16_t dioPeriod){
+   // new Imin, restart Trickle from there
+   icmpv6rpl_vars.dioPeriod   = dioPeriod;
+   icmpv6rpl_vars.dioInterval = icmpv6rpl_vars.dioPeriod;
+   startDIOInterval();
 }
 
 void icmpv6rpl_setDAOPeriod(uint16_t daoPeriod){
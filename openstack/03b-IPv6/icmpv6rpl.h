@@ -12,13 +12,57 @@
 
 //=========================== define ==========================================
 
-#define TIMER_DIO_TIMEOUT         10000
-#define TIMER_DAO_TIMEOUT         60000
+#define TIMER_DIO_TIMEOUT         10000 // Trickle Imin, in ms
+#define TIMER_DAO_TIMEOUT         60000 // DAO refresh period, in ms
 
+// DIO Trickle timer (RFC6206), Imax = Imin*2^DIO_INTERVAL_DOUBLINGS
+#define DIO_INTERVAL_DOUBLINGS    6
+#define DIO_REDUNDANCY_CONSTANT   10    // k, 0 disables suppression
+// without a DAG rank, the same timer sends DIS, backed off up to
+// Imin*2^DIS_INTERVAL_DOUBLINGS
+#define DIS_INTERVAL_DOUBLINGS    4
+
+// DAOs are sent DAO_DAMPING_DELAY after a change, then refreshed with an
+// interval doubling up to TIMER_DAO_TIMEOUT*2^DAO_REFRESH_DOUBLINGS
+#define DAO_DAMPING_DELAY         2000  // in ms
+#define DAO_REFRESH_DOUBLINGS     2
+
+// routes learnt from DAOs, by the DAG root and in storing mode, expire after
+// DAO_ROUTE_LIFETIME units of 256 slots (see ieee154e_getCoarseAsn()), over
+// 3 DAO refresh intervals at their longest
+#define DAO_ROUTE_LIFETIME        300
+
+// DAO aggregation: relayed DAOs are absorbed and reported in my next DAO
+#ifndef DAO_AGGREGATION
+#define DAO_AGGREGATION           0
+#endif
+#define DAO_AGGREGATION_MAXTARGETS 8    // targets waiting to be reported
+#define DAO_MAXTARGETS            8     // targets listed in a received DAO
+
+// DAO header and options in a single frame: the 6LoWPAN bytes of a frame
+// (104B, 96B secured, see FRAG_MAX_FRAME_PAYLOAD), minus the page dispatch,
+// RPI 6LoRH and IPHC header with 64-bit addresses (24B) and the ICMPv6 header
+// (4B). My own DAO takes 60B, which leaves room for a single absorbed target
+// whose parent is me: aggregation only saves the last hop of a child's DAO.
+#ifndef DAO_MAXLENGTH
+#ifdef L2_SECURITY_ACTIVE
+#define DAO_MAXLENGTH             68
+#else
+#define DAO_MAXLENGTH             76
+#endif
+#endif
+
+#ifdef RPL_STORING_MODE
+// Storing Mode of Operation with no multicast support (2)
+#define MOP_DIO_A                 0<<5
+#define MOP_DIO_B                 1<<4
+#define MOP_DIO_C                 0<<3
+#else
 // Non-Storing Mode of Operation (1)
 #define MOP_DIO_A                 0<<5
 #define MOP_DIO_B                 0<<4
 #define MOP_DIO_C                 1<<3
+#endif
 // least preferred (0)
 #define PRF_DIO_A                 0<<2
 #define PRF_DIO_B                 0<<1
@@ -61,8 +105,16 @@ enum{
   OPTION_DODAG_CONFIGURATION_TYPE = 0x04,
   OPTION_TARGET_INFORMATION_TYPE  = 0x05,
   OPTION_TRANSIT_INFORMATION_TYPE = 0x06,
+  // not assigned by IANA, reuses the number of the 6LoWPAN-ND context option
+  OPTION_6LOWPAN_CONTEXT_TYPE     = 0x22,
 };
 
+// 6LoWPAN context option in DIOs: type, length, context length in bits,
+// C flag and CID, 64-bit prefix
+#define DIO_CONTEXT_OPTION_LENGTH  12
+#define DIO_CONTEXT_C              0x10
+#define DIO_CONTEXT_CID            0x0f
+
 //=========================== static ==========================================
 
 /**
@@ -93,6 +145,18 @@ typedef struct {
 } icmpv6rpl_dio_ht;
 END_PACK
 
+//===== DIS
+
+/**
+\brief Header format of a RPL DIS packet.
+*/
+BEGIN_PACK
+typedef struct {
+   uint8_t         flags;
+   uint8_t         reserved;
+} icmpv6rpl_dis_ht;
+END_PACK
+
 //===== DAO
 
 /**
@@ -134,6 +198,16 @@ typedef struct {
 } icmpv6rpl_dao_target_ht;
 END_PACK
 
+/**
+\brief A target learnt from a relayed DAO, waiting to be reported.
+*/
+typedef struct {
+   bool            used;
+   bool            inDAO;              ///< written in the DAO being sent.
+   uint8_t         target[16];         ///< IPv6 address of the target.
+   uint8_t         parent[16];         ///< IPv6 address of its DODAG parent.
+} icmpv6rpl_daoTarget_t;
+
 //=========================== module variables ================================
 
 typedef struct {
@@ -143,7 +217,13 @@ typedef struct {
    // DIO-related
    icmpv6rpl_dio_ht          dio;                     ///< pre-populated DIO packet.
    open_addr_t               dioDestination;          ///< IPv6 destination address for DIOs.
-   uint32_t                  dioPeriod;               ///< duration, in ms, of a timerIdDIO timeout.
+   uint32_t                  dioPeriod;               ///< Trickle Imin, in ms.
+   uint32_t                  dioInterval;             ///< Trickle I, current interval, in ms.
+   uint32_t                  dioTransmitTime;         ///< Trickle t, in ms from the start of the interval.
+   uint8_t                   dioCounter;              ///< Trickle c, consistent DIOs heard during the interval.
+   bool                      dioIntervalEnding;       ///< TRUE once t is past, waiting for the end of the interval.
+   uint16_t                  numDIOsent;              ///< number of DIOs sent.
+   uint16_t                  numDIOsuppressed;        ///< number of DIOs not sent because k consistent ones were heard.
    opentimer_id_t            timerIdDIO;              ///< ID of the timer used to send DIOs.
    uint8_t                   delayDIO;                ///< number of timerIdDIO events before actually sending a DIO.
    // DAO-related
@@ -151,8 +231,15 @@ typedef struct {
    icmpv6rpl_dao_transit_ht  dao_transit;             ///< pre-populated DAO "Transit Info" option header.
    icmpv6rpl_dao_target_ht   dao_target;              ///< pre-populated DAO "Transit Info" option header.
    opentimer_id_t            timerIdDAO;              ///< ID of the timer used to send DAOs.
-   uint32_t                  daoPeriod;               ///< duration, in ms, of a timerIdDAO timeout.
+   uint32_t                  daoPeriod;               ///< DAO refresh period, in ms.
+   uint32_t                  daoInterval;             ///< current DAO refresh interval, in ms.
+   bool                      daoPending;              ///< a DAO is scheduled after a change.
+   uint16_t                  numDAOsent;              ///< number of DAOs sent.
    uint8_t                   delayDAO;                ///< number of timerIdDIO events before actually sending a DAO.
+#if DAO_AGGREGATION
+   icmpv6rpl_daoTarget_t     daoTargets[DAO_AGGREGATION_MAXTARGETS]; ///< targets to report in my next DAO.
+   uint16_t                  numDAOaggregated;        ///< number of relayed DAOs absorbed.
+#endif
 } icmpv6rpl_vars_t;
 
 //=========================== prototypes ======================================
@@ -164,7 +251,15 @@ void     icmpv6rpl_writeDODAGid(uint8_t* dodagid);
 uint8_t  icmpv6rpl_getRPLIntanceID(void);
 void     icmpv6rpl_getRPLDODAGid(uint8_t* address_128b);
 void     icmpv6rpl_setDIOPeriod(uint16_t dioPeriod);
+void     icmpv6rpl_resetDIOTrickle(void);
 void     icmpv6rpl_setDAOPeriod(uint16_t daoPeriod);
+void     icmpv6rpl_triggerDAO(void);
+#if defined(DAGROOT_ROUTING) || defined(RPL_STORING_MODE)
+void     icmpv6rpl_indicateRxDAO(OpenQueueEntry_t* msg, uint8_t* icmpv6);
+#endif
+#if DAO_AGGREGATION
+bool     icmpv6rpl_aggregateDAO(OpenQueueEntry_t* msg, uint8_t* icmpv6);
+#endif
 /**
 \}
 \}
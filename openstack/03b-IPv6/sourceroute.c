@@ -0,0 +1,412 @@
+#include "opendefs.h"
+#include "sourceroute.h"
+#include "iphc.h"
+#include "idmanager.h"
+#include "openserial.h"
+#include "IEEE802154E.h"
+#include "icmpv6rpl.h"
+
+#ifdef DAGROOT_ROUTING
+
+//=========================== define ==========================================
+
+#define NUMTYPES                  4      // RH3 types of addresses sharing my prefix
+
+//=========================== variables =======================================
+
+sourceroute_vars_t sourceroute_vars;
+
+static const uint8_t rh3TypeLength[NUMTYPES] = {1,2,4,8};
+
+//=========================== prototypes ======================================
+
+uint16_t  getNodeRow(uint8_t* address);
+uint16_t  addNode(uint8_t* address);
+void      removeNode(uint16_t row);
+uint16_t  nodeHash(uint8_t* eui64);
+bool      isOnMyPrefix(uint8_t* address);
+bool      isExpired(uint16_t row);
+uint8_t   getRH3Type(uint8_t* eui64, uint8_t* reference);
+uint8_t   writeRH3(uint16_t* path, uint8_t numHops, uint8_t* rh3);
+
+//=========================== public ==========================================
+
+/**
+\brief Initialize this module.
+*/
+void sourceroute_init() {
+   uint16_t i;
+
+   memset(&sourceroute_vars,0,sizeof(sourceroute_vars_t));
+   for (i=0;i<SOURCEROUTE_MAXNODES;i++) {
+      sourceroute_vars.nodes[i].parent = SOURCEROUTE_NONE;
+      sourceroute_vars.hashNext[i]     = SOURCEROUTE_NONE;
+   }
+   for (i=0;i<SOURCEROUTE_HASHSIZE;i++) {
+      sourceroute_vars.hashHead[i]     = SOURCEROUTE_NONE;
+   }
+}
+
+/**
+\brief Record the parent of a node, as reported in a DAO.
+
+\param[in] target The IPv6 address of the node.
+\param[in] parent The IPv6 address of its parent.
+*/
+void sourceroute_setParent(uint8_t* target, uint8_t* parent) {
+   uint16_t targetRow;
+   uint16_t parentRow;
+
+   if (
+         isOnMyPrefix(target)==FALSE ||
+         isOnMyPrefix(parent)==FALSE ||
+         memcmp(target,parent,16)==0
+      ) {
+      return;
+   }
+
+   targetRow = getNodeRow(target);
+   if (targetRow==SOURCEROUTE_NONE) {
+      targetRow = addNode(target);
+      if (targetRow==SOURCEROUTE_NONE) {
+         return;
+      }
+   }
+   sourceroute_vars.nodes[targetRow].lastHeard = ieee154e_getCoarseAsn();
+
+   if (memcmp(&parent[8],idmanager_getMyID(ADDR_64B)->addr_64b,8)==0) {
+      sourceroute_vars.nodes[targetRow].parent = SOURCEROUTE_ROOT;
+      return;
+   }
+
+   // the parent stays unknown until its own DAO is heard
+   parentRow = getNodeRow(parent);
+   if (parentRow==SOURCEROUTE_NONE) {
+      parentRow = addNode(parent);
+   }
+   if (parentRow==SOURCEROUTE_NONE) {
+      sourceroute_vars.nodes[targetRow].parent = SOURCEROUTE_UNKNOWN;
+   } else {
+      sourceroute_vars.nodes[targetRow].parent = parentRow;
+   }
+}
+
+/**
+\brief Indicate whether a destination is a node of my DODAG.
+
+\param[in] destination The IPv6 address of the destination.
+*/
+bool sourceroute_hasRoute(open_addr_t* destination) {
+   return destination->type==ADDR_128B &&
+          isOnMyPrefix(destination->addr_128b) &&
+          getNodeRow(destination->addr_128b)!=SOURCEROUTE_NONE;
+}
+
+/**
+\brief Build the source route to a node of my DODAG.
+
+The route is the chain of parents from the destination up to me. Its
+intermediate hops are written as RH3-6LoRH headers (RFC8138), from my child
+down to the parent of the destination.
+
+\param[in]  destination The IPv6 address of the destination.
+\param[out] nextHop     The EUI64 of the first hop.
+\param[out] rh3         Where to write the RH3-6LoRH headers, at least
+   SOURCEROUTE_MAXHOPS*10 bytes.
+\param[out] rh3_length  The length of the RH3-6LoRH headers, 0 if the
+   destination is my child.
+
+\returns E_SUCCESS if a route exists, E_FAIL otherwise.
+*/
+owerror_t sourceroute_getRoute(
+      open_addr_t*      destination,
+      open_addr_t*      nextHop,
+      uint8_t*          rh3,
+      uint8_t*          rh3_length
+   ) {
+   uint16_t  path[SOURCEROUTE_MAXHOPS];
+   uint8_t   numHops;
+   uint16_t  row;
+
+   *rh3_length = 0;
+   if (sourceroute_hasRoute(destination)==FALSE) {
+      return E_FAIL;
+   }
+
+   // walk up to me, path[0] being the destination
+   numHops = 0;
+   row     = getNodeRow(destination->addr_128b);
+   while (row!=SOURCEROUTE_ROOT) {
+      if (row==SOURCEROUTE_UNKNOWN || numHops==SOURCEROUTE_MAXHOPS) {
+         // broken chain, or loop
+         return E_FAIL;
+      }
+      if (isExpired(row)==TRUE) {
+         removeNode(row);
+         return E_FAIL;
+      }
+      path[numHops++] = row;
+      row = sourceroute_vars.nodes[row].parent;
+   }
+
+   nextHop->type = ADDR_64B;
+   memcpy(nextHop->addr_64b,sourceroute_vars.nodes[path[numHops-1]].eui64,8);
+
+   if (numHops>1) {
+      *rh3_length = writeRH3(&path[1],numHops-1,rh3);
+   }
+   return E_SUCCESS;
+}
+
+//=========================== private =========================================
+
+/**
+\brief Write the shortest RH3-6LoRH headers for a route.
+
+Each address is compressed against my address, as the first address of each
+RH3-6LoRH header is, and against the previous hop, as the next address is
+when a hop pops itself. All addresses of an RH3-6LoRH header share the same
+type, so a dynamic program picks, for each hop, the type which minimizes the
+total length, with at most MAXNUM_RH3 headers.
+
+\param[in]  path    The rows of the hops, last hop first.
+\param[in]  numHops The number of hops.
+\param[out] rh3     Where to write the RH3-6LoRH headers.
+
+\returns The number of bytes written.
+*/
+uint8_t writeRH3(uint16_t* path, uint8_t numHops, uint8_t* rh3) {
+   uint8_t   minType[SOURCEROUTE_MAXHOPS];
+   uint8_t   cost[NUMTYPES][MAXNUM_RH3];           // for the hops so far
+   uint8_t   newCost[NUMTYPES][MAXNUM_RH3];
+   uint8_t   prevType[SOURCEROUTE_MAXHOPS][NUMTYPES][MAXNUM_RH3];
+   uint8_t   types[SOURCEROUTE_MAXHOPS];
+   uint8_t*  myEui64;
+   uint8_t*  eui64;
+   uint8_t*  prevEui64;
+   uint8_t   bestType,bestHeaders;
+   uint8_t   i,t,p,h;
+   uint8_t   length;
+   uint8_t   start;
+
+   myEui64 = idmanager_getMyID(ADDR_64B)->addr_64b;
+
+   // smallest type of each hop, in the order of the route
+   prevEui64 = myEui64;
+   for (i=0;i<numHops;i++) {
+      eui64      = sourceroute_vars.nodes[path[numHops-1-i]].eui64;
+      minType[i] = getRH3Type(eui64,myEui64);
+      t          = getRH3Type(eui64,prevEui64);
+      if (t>minType[i]) {
+         minType[i] = t;
+      }
+      prevEui64  = eui64;
+   }
+
+   // cost[t][h]: length up to hop i, hop i of type t, in the (h+1)th header
+   memset(cost,0xff,sizeof(cost));
+   for (t=minType[0];t<NUMTYPES;t++) {
+      cost[t][0] = 2+rh3TypeLength[t];
+   }
+   for (i=1;i<numHops;i++) {
+      memset(newCost,0xff,sizeof(newCost));
+      for (t=minType[i];t<NUMTYPES;t++) {
+         for (h=0;h<MAXNUM_RH3;h++) {
+            // same header as the previous hop
+            if (cost[t][h]!=0xff) {
+               newCost[t][h]     = cost[t][h]+rh3TypeLength[t];
+               prevType[i][t][h] = t;
+            }
+            // new header
+            for (p=0;p<NUMTYPES && h>0;p++) {
+               if (
+                     p!=t &&
+                     cost[p][h-1]!=0xff &&
+                     cost[p][h-1]+2+rh3TypeLength[t]<newCost[t][h]
+                  ) {
+                  newCost[t][h]     = cost[p][h-1]+2+rh3TypeLength[t];
+                  prevType[i][t][h] = p;
+               }
+            }
+         }
+      }
+      memcpy(cost,newCost,sizeof(cost));
+   }
+
+   // pick the shortest, then walk back to the first hop
+   bestType    = NUMTYPES-1;
+   bestHeaders = 0;
+   for (t=0;t<NUMTYPES;t++) {
+      for (h=0;h<MAXNUM_RH3;h++) {
+         if (cost[t][h]<cost[bestType][bestHeaders]) {
+            bestType    = t;
+            bestHeaders = h;
+         }
+      }
+   }
+   for (i=numHops-1;;i--) {
+      types[i] = bestType;
+      if (i==0) {
+         break;
+      }
+      t = prevType[i][bestType][bestHeaders];
+      if (t!=bestType) {
+         bestHeaders--;
+      }
+      bestType = t;
+   }
+
+   // write one header per run of hops of the same type
+   length = 0;
+   start  = 0;
+   for (i=1;i<=numHops;i++) {
+      if (i<numHops && types[i]==types[start]) {
+         continue;
+      }
+      rh3[length++] = CRITICAL_6LORH | (i-start-1);
+      rh3[length++] = types[start];
+      for (;start<i;start++) {
+         eui64 = sourceroute_vars.nodes[path[numHops-1-start]].eui64;
+         memcpy(
+            &rh3[length],
+            &eui64[8-rh3TypeLength[types[start]]],
+            rh3TypeLength[types[start]]
+         );
+         length += rh3TypeLength[types[start]];
+      }
+   }
+   return length;
+}
+
+/**
+\brief Smallest RH3 type to compress an address against a reference address.
+
+Both addresses share my prefix, only the trailing bytes of the EUI64 which
+differ from the reference are carried.
+*/
+uint8_t getRH3Type(uint8_t* eui64, uint8_t* reference) {
+   uint8_t i;
+
+   for (i=0;i<8 && eui64[i]==reference[i];i++);
+   switch (8-i) {
+      case 0:
+      case 1:
+         return RH3_6LOTH_TYPE_0;
+      case 2:
+         return RH3_6LOTH_TYPE_1;
+      case 3:
+      case 4:
+         return RH3_6LOTH_TYPE_2;
+      default:
+         return RH3_6LOTH_TYPE_3;
+   }
+}
+
+uint16_t getNodeRow(uint8_t* address) {
+   uint16_t i;
+
+   i = sourceroute_vars.hashHead[nodeHash(&address[8])];
+   while (i!=SOURCEROUTE_NONE) {
+      if (memcmp(sourceroute_vars.nodes[i].eui64,&address[8],8)==0) {
+         return i;
+      }
+      i = sourceroute_vars.hashNext[i];
+   }
+   return SOURCEROUTE_NONE;
+}
+
+/**
+\brief Add a node, its parent unknown.
+
+When the table is full, the expired nodes are removed first.
+
+\returns The row of the node, SOURCEROUTE_NONE if the table is full.
+*/
+uint16_t addNode(uint8_t* address) {
+   uint16_t i;
+   uint16_t j;
+
+   if (sourceroute_vars.numNodes==SOURCEROUTE_MAXNODES) {
+      for (i=0;i<SOURCEROUTE_MAXNODES;i++) {
+         if (isExpired(i)==TRUE) {
+            removeNode(i);
+         }
+      }
+   }
+   for (i=0;i<SOURCEROUTE_MAXNODES;i++) {
+      if (sourceroute_vars.nodes[i].parent==SOURCEROUTE_NONE) {
+         break;
+      }
+   }
+   if (i==SOURCEROUTE_MAXNODES) {
+      openserial_printError(COMPONENT_FORWARDING,ERR_SOURCEROUTE_FULL,
+                            (errorparameter_t)SOURCEROUTE_MAXNODES,
+                            (errorparameter_t)0);
+      return SOURCEROUTE_NONE;
+   }
+
+   memcpy(sourceroute_vars.nodes[i].eui64,&address[8],8);
+   sourceroute_vars.nodes[i].parent    = SOURCEROUTE_UNKNOWN;
+   sourceroute_vars.nodes[i].lastHeard = ieee154e_getCoarseAsn();
+   // index this row by its address
+   j = nodeHash(&address[8]);
+   sourceroute_vars.hashNext[i] = sourceroute_vars.hashHead[j];
+   sourceroute_vars.hashHead[j] = i;
+   sourceroute_vars.numNodes++;
+   return i;
+}
+
+/**
+\brief Remove a node, its children becoming orphans until their next DAO.
+*/
+void removeNode(uint16_t row) {
+   uint16_t* link;
+   uint16_t  i;
+
+   if (sourceroute_vars.nodes[row].parent==SOURCEROUTE_NONE) {
+      return;
+   }
+
+   // unlink the row from its hash chain
+   link = &sourceroute_vars.hashHead[nodeHash(sourceroute_vars.nodes[row].eui64)];
+   while (*link!=SOURCEROUTE_NONE && *link!=row) {
+      link = &sourceroute_vars.hashNext[*link];
+   }
+   if (*link==row) {
+      *link = sourceroute_vars.hashNext[row];
+   }
+   sourceroute_vars.hashNext[row]      = SOURCEROUTE_NONE;
+   sourceroute_vars.nodes[row].parent  = SOURCEROUTE_NONE;
+   sourceroute_vars.numNodes--;
+
+   for (i=0;i<SOURCEROUTE_MAXNODES;i++) {
+      if (sourceroute_vars.nodes[i].parent==row) {
+         sourceroute_vars.nodes[i].parent = SOURCEROUTE_UNKNOWN;
+      }
+   }
+}
+
+/**
+\brief Hash bucket of an EUI64.
+
+EUI64s of motes in a deployment typically only differ in their last bytes.
+*/
+uint16_t nodeHash(uint8_t* eui64) {
+   return (eui64[6]^eui64[7])&(SOURCEROUTE_HASHSIZE-1);
+}
+
+bool isOnMyPrefix(uint8_t* address) {
+   return memcmp(address,idmanager_getMyID(ADDR_PREFIX)->prefix,8)==0;
+}
+
+bool isExpired(uint16_t row) {
+   return sourceroute_vars.nodes[row].parent!=SOURCEROUTE_NONE &&
+          (uint16_t)(ieee154e_getCoarseAsn()-sourceroute_vars.nodes[row].lastHeard)>DAO_ROUTE_LIFETIME;
+}
+
+#else
+
+void sourceroute_init() {
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __SOURCEROUTE_H
+#define __SOURCEROUTE_H
+
+/**
+\addtogroup IPv6
+\{
+\addtogroup SourceRoute
+\{
+*/
+
+#include "opendefs.h"
+
+//=========================== define ==========================================
+
+#ifndef SOURCEROUTE_MAXNODES
+#define SOURCEROUTE_MAXNODES      200    // nodes in my DODAG, other than me
+#endif
+#define SOURCEROUTE_HASHSIZE      64     // number of hash buckets, power of 2
+#define SOURCEROUTE_NONE          0xffff // free row, end of a hash chain
+#define SOURCEROUTE_ROOT          0xfffe // parent is me, the DAG root
+#define SOURCEROUTE_UNKNOWN       0xfffd // parent not known yet
+#define SOURCEROUTE_MAXHOPS       16     // longest route
+
+//=========================== typedef =========================================
+
+/**
+\brief A node of my DODAG, as reported by its DAOs.
+
+Nodes share my prefix, only their EUI64 is stored.
+*/
+typedef struct {
+   uint8_t         eui64[8];
+   uint16_t        parent;             ///< row of its parent, SOURCEROUTE_ROOT or SOURCEROUTE_UNKNOWN.
+   uint16_t        lastHeard;          ///< ASN of its last DAO, in units of 256 slots.
+} sourceroute_node_t;
+
+//=========================== module variables ================================
+
+typedef struct {
+   sourceroute_node_t   nodes[SOURCEROUTE_MAXNODES];
+   uint16_t             hashHead[SOURCEROUTE_HASHSIZE]; // first row of each bucket
+   uint16_t             hashNext[SOURCEROUTE_MAXNODES]; // next row in the same bucket
+   uint16_t             numNodes;
+} sourceroute_vars_t;
+
+//=========================== prototypes ======================================
+
+void      sourceroute_init(void);
+void      sourceroute_setParent(uint8_t* target, uint8_t* parent);
+bool      sourceroute_hasRoute(open_addr_t* destination);
+owerror_t sourceroute_getRoute(
+   open_addr_t*         destination,
+   open_addr_t*         nextHop,
+   uint8_t*             rh3,
+   uint8_t*             rh3_length
+);
+
+/**
+\}
+\}
+*/
+
+#endif
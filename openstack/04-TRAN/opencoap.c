@@ -17,6 +17,48 @@ opencoap_vars_t opencoap_vars;
 
 //=========================== prototype =======================================
 
+// Observe
+void      opencoap_handleObserve(
+   OpenQueueEntry_t*     msg,
+   coap_resource_desc_t* desc,
+   coap_header_iht*      coap_header,
+   uint32_t              observe
+);
+owerror_t opencoap_addObserve(OpenQueueEntry_t* msg);
+void      opencoap_task_notify(void);
+void      opencoap_sendNotification(coap_observer_t* observer);
+// Block
+owerror_t opencoap_prepareBlocks(coap_resource_desc_t* desc, coap_option_iht* coap_options);
+void      opencoap_addBlockOptions(
+   OpenQueueEntry_t*     msg,
+   coap_header_iht*      coap_header,
+   coap_option_iht*      coap_options
+);
+// options
+owerror_t opencoap_insertOption(
+   OpenQueueEntry_t*     msg,
+   coap_option_t         type,
+   uint8_t*              value,
+   uint8_t               length
+);
+uint8_t   opencoap_readOptionHeader(uint8_t* buf, uint16_t* delta, uint16_t* length);
+uint8_t   opencoap_writeOptionHeader(uint8_t* buf, uint16_t delta, uint16_t length);
+uint8_t   opencoap_optionHeaderLength(uint16_t delta, uint16_t length);
+uint8_t   opencoap_encodeUint(uint32_t value, uint8_t* buf);
+// confirmable messages
+coap_exchange_t* opencoap_newExchange(OpenQueueEntry_t* msg, coap_resource_desc_t* desc);
+void      opencoap_endExchange(coap_exchange_t* exchange, owerror_t outcome);
+void      opencoap_completeExchange(coap_exchange_t* exchange);
+void      opencoap_retransmit(coap_exchange_t* exchange);
+owerror_t opencoap_armTimer(void);
+void      opencoap_timer_cb(opentimer_id_t id);
+void      opencoap_timer_task(void);
+// replies
+void      opencoap_prepareReply(OpenQueueEntry_t* msg);
+void      opencoap_sendEmpty(OpenQueueEntry_t* msg, coap_type_t type, uint16_t messageID);
+coap_dedup_t* opencoap_dedupLookup(OpenQueueEntry_t* msg, uint16_t messageID);
+void      opencoap_dedupStore(OpenQueueEntry_t* msg, uint16_t messageID);
+
 //=========================== public ==========================================
 
 //===== from stack
@@ -25,11 +67,17 @@ opencoap_vars_t opencoap_vars;
 \brief Initialize this module.
 */
 void opencoap_init() {
+   // clear module variables
+   memset(&opencoap_vars,0,sizeof(opencoap_vars_t));
+   
    // initialize the resource linked list
    opencoap_vars.resources     = NULL;
    
    // initialize the messageID
    opencoap_vars.messageID     = openrandom_get16b();
+   
+   // the retransmission timer is only armed while exchanges are outstanding
+   opencoap_vars.timerId       = TOO_MANY_TIMERS_ERROR;
 }
 
 /**
@@ -43,13 +91,21 @@ received packetbuffer is reused to contain the response (or error code).
 \param[in] msg The received CoAP message.
 */
 void opencoap_receive(OpenQueueEntry_t* msg) {
-   uint16_t                  temp_l4_destination_port;
    uint8_t                   i;
-   uint8_t                   index;
+   uint16_t                  index;
+   uint8_t                   j;
    coap_option_t             last_option;
    coap_resource_desc_t*     temp_desc;
    bool                      found;
    owerror_t                 outcome = 0;
+   coap_type_t               request_type;
+   coap_code_t               request_code;
+   coap_dedup_t*             dedup;
+   coap_exchange_t*          exchange;
+   uint32_t                  observe;
+   uint16_t                  option_delta;
+   uint16_t                  option_length;
+   bool                      reserved;
    // local variables passed to the handlers (with msg)
    coap_header_iht           coap_header;
    coap_option_iht           coap_options[MAX_COAP_OPTIONS];
@@ -71,7 +127,11 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
    index+=2;
    
    // reject unsupported header
-   if (coap_header.Ver!=COAP_VERSION || coap_header.TKL>COAP_MAX_TKL) {
+   if (
+         coap_header.Ver!=COAP_VERSION     ||
+         coap_header.TKL>COAP_MAX_TKL      ||
+         msg->length<index+coap_header.TKL
+      ) {
       openserial_printError(
          COMPONENT_OPENCOAP,ERR_WRONG_TRAN_PROTOCOL,
          (errorparameter_t)0,
@@ -81,6 +141,23 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
       return;
    }
    
+   // answer a duplicate of a confirmable message with the reply it got
+   if (coap_header.T==COAP_TYPE_CON) {
+      dedup = opencoap_dedupLookup(msg,coap_header.messageID);
+      if (dedup!=NULL && dedup->length>0) {
+         msg->payload                  = &(msg->packet[127]);
+         msg->length                   = 0;
+         packetfunctions_reserveHeaderSize(msg,dedup->length);
+         memcpy(&msg->payload[0],&dedup->response[0],dedup->length);
+         msg->creator                  = COMPONENT_OPENCOAP;
+         opencoap_prepareReply(msg);
+         if ((openudp_send(msg))==E_FAIL) {
+            openqueue_freePacketBuffer(msg);
+         }
+         return;
+      }
+   }
+   
    // record the token
    memcpy(&coap_header.token[0], &msg->payload[index], coap_header.TKL);
    index += coap_header.TKL;
@@ -95,21 +172,57 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
    for (i=0;i<MAX_COAP_OPTIONS;i++) {
       
       // detect when done parsing options
+      if (msg->length<=index) {
+         // end of message, no payload
+         break;
+      }
       if (msg->payload[index]==COAP_PAYLOAD_MARKER) {
          // found the payload marker, done parsing options.
          index++; // skip marker and stop parsing options
          break;
       }
-      if (msg->length<=index) {
-         // end of message, no payload
-         break;
+      
+      // parse this option, with its extended delta and length
+      option_delta                = (msg->payload[index] & 0xf0) >> 4;
+      option_length               = (msg->payload[index] & 0x0f);
+      reserved                    = (option_delta==15 || option_length==15);
+      index++;
+      if (option_delta==13) {
+         option_delta             = 13+msg->payload[index];
+         index++;
+      } else if (option_delta==14) {
+         option_delta             = 269+msg->payload[index]*256+msg->payload[index+1];
+         index+=2;
+      }
+      if (option_length==13) {
+         option_length            = 13+msg->payload[index];
+         index++;
+      } else if (option_length==14) {
+         option_length            = 269+msg->payload[index]*256+msg->payload[index+1];
+         index+=2;
       }
       
-      // parse this option
-      coap_options[i].type        = (coap_option_t)((uint8_t)last_option+(uint8_t)((msg->payload[index] & 0xf0) >> 4));
+      // reject an option running past the message, or longer than we store
+      if (
+            reserved==TRUE                             ||
+            option_length>255                          ||
+            index+option_length>msg->length
+         ) {
+         openserial_printError(
+            COMPONENT_OPENCOAP,ERR_COAP_BAD_OPTION,
+            (errorparameter_t)((uint16_t)last_option+option_delta),
+            (errorparameter_t)option_length
+         );
+         if (coap_header.T==COAP_TYPE_CON) {
+            opencoap_sendEmpty(msg,COAP_TYPE_RES,coap_header.messageID);
+         } else {
+            openqueue_freePacketBuffer(msg);
+         }
+         return;
+      }
+      coap_options[i].type        = (coap_option_t)((uint16_t)last_option+option_delta);
       last_option                 = coap_options[i].type;
-      coap_options[i].length      = (msg->payload[index] & 0x0f);
-      index++;
+      coap_options[i].length      = (uint8_t)option_length;
       coap_options[i].pValue      = &(msg->payload[index]);
       index                      += coap_options[i].length; //includes length as well
    }
@@ -117,6 +230,26 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
    // remove the CoAP header+options
    packetfunctions_tossHeader(msg,index);
    
+   // pull the Observe option out, resources only see their Uri-Path options first
+   observe = COAP_OBSERVE_NONE;
+   for (i=0;i<MAX_COAP_OPTIONS && coap_options[i].type!=COAP_OPTION_NONE;i++) {
+      if (coap_options[i].type==COAP_OPTION_NUM_OBSERVE) {
+         observe = 0;
+         for (j=0;j<coap_options[i].length && j<3;j++) {
+            observe = (observe<<8) | coap_options[i].pValue[j];
+         }
+         if (observe!=COAP_OBSERVE_REGISTER && observe!=COAP_OBSERVE_DEREGISTER) {
+            // undefined in requests
+            observe = COAP_OBSERVE_NONE;
+         }
+         for (;i<MAX_COAP_OPTIONS-1;i++) {
+            coap_options[i] = coap_options[i+1];
+         }
+         coap_options[MAX_COAP_OPTIONS-1].type = COAP_OPTION_NONE;
+         break;
+      }
+   }
+   
    //=== step 2. find the resource to handle the packet
    
    // find the resource this applies to
@@ -183,11 +316,46 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
       // if an ack for a confirmable message, or a reset
       // find the resource which matches
       
-      // start with the first resource in the linked list
-      temp_desc = opencoap_vars.resources;
+      // an acknowledgment or a reset ends the exchange of a confirmable message
+      if (coap_header.T==COAP_TYPE_ACK || coap_header.T==COAP_TYPE_RES) {
+         for (i=0;i<COAP_MAX_EXCHANGES;i++) {
+            exchange = &opencoap_vars.exchanges[i];
+            if (
+                  exchange->msg!=NULL                                                            &&
+                  exchange->done==FALSE                                                          &&
+                  exchange->messageID==coap_header.messageID                                     &&
+                  packetfunctions_sameAddress(&exchange->msg->l3_destinationAdd,&msg->l3_sourceAdd)
+               ) {
+               opencoap_endExchange(
+                  exchange,
+                  coap_header.T==COAP_TYPE_ACK ? E_SUCCESS : E_FAIL
+               );
+            }
+         }
+      }
+      
+      // a reset to a notification cancels the observation
+      if (coap_header.T==COAP_TYPE_RES) {
+         for (i=0;i<COAP_MAX_OBSERVERS;i++) {
+            if (
+                  opencoap_vars.observers[i].desc!=NULL &&
+                  opencoap_vars.observers[i].messageID==coap_header.messageID
+               ) {
+               opencoap_vars.observers[i].desc = NULL;
+            }
+         }
+      }
+      
+      // start with the first resource in the linked list, an empty message
+      // is for none of them
+      if (coap_header.Code==COAP_CODE_EMPTY) {
+         temp_desc = NULL;
+      } else {
+         temp_desc = opencoap_vars.resources;
+      }
       
       // iterate until matching resource found, or no match
-      while (found==FALSE) {
+      while (found==FALSE && temp_desc!=NULL) {
          
          if (
                 coap_header.TKL==temp_desc->last_request.TKL                                       &&
@@ -218,6 +386,16 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
          }
       };
       
+      // acknowledge a confirmable (separate) response, reset a ping
+      if (coap_header.T==COAP_TYPE_CON) {
+         opencoap_sendEmpty(
+            msg,
+            coap_header.Code==COAP_CODE_EMPTY ? COAP_TYPE_RES : COAP_TYPE_ACK,
+            coap_header.messageID
+         );
+         return;
+      }
+      
       // free the received packet
       openqueue_freePacketBuffer(msg);
       
@@ -227,10 +405,28 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
    
    //=== step 3. ask the resource to prepare response
    
+   request_type = coap_header.T;
+   request_code = coap_header.Code;
    if (found==TRUE) {
       
-      // call the resource's callback
-      outcome = temp_desc->callbackRx(msg,&coap_header,&coap_options[0]);
+      if (opencoap_prepareBlocks(temp_desc,&coap_options[0])==E_FAIL) {
+         // the resource does not take requests block-wise
+         msg->payload                  = &(msg->packet[127]);
+         msg->length                   = 0;
+         coap_header.Code              = COAP_CODE_RESP_BADOPTION;
+      } else {
+         // call the resource's callback
+         outcome = temp_desc->callbackRx(msg,&coap_header,&coap_options[0]);
+         
+         if (outcome==E_SUCCESS) {
+            opencoap_addBlockOptions(msg,&coap_header,&coap_options[0]);
+         }
+         
+         // register or cancel an observation
+         if (outcome==E_SUCCESS && request_code==COAP_CODE_REQ_GET) {
+            opencoap_handleObserve(msg,temp_desc,&coap_header,observe);
+         }
+      }
    } else {
       // reset packet payload (DO NOT DELETE, we will reuse same buffer for response)
       msg->payload                     = &(msg->packet[127]);
@@ -257,25 +453,35 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
    } else {
       msg->creator                     = COMPONENT_OPENCOAP;
    }
-   msg->l4_protocol                    = IANA_UDP;
-   temp_l4_destination_port            = msg->l4_destination_port;
-   msg->l4_destination_port            = msg->l4_sourcePortORicmpv6Type;
-   msg->l4_sourcePortORicmpv6Type      = temp_l4_destination_port;
+   opencoap_prepareReply(msg);
    
-   // set destination address as the current source
-   msg->l3_destinationAdd.type         = ADDR_128B;
-   memcpy(&msg->l3_destinationAdd.addr_128b[0],&msg->l3_sourceAdd.addr_128b[0],LENGTH_ADDR128b);
+   // piggy-back the response on the acknowledgment of a confirmable request,
+   // answer a non-confirmable one with a non-confirmable message
+   if (request_type==COAP_TYPE_CON) {
+      coap_header.T                    = COAP_TYPE_ACK;
+   } else {
+      coap_header.T                    = COAP_TYPE_NON;
+      if (opencoap_vars.messageID++ == 0xffff) {
+         opencoap_vars.messageID = 0;
+      }
+      coap_header.messageID            = opencoap_vars.messageID;
+   }
    
    // fill in CoAP header
    packetfunctions_reserveHeaderSize(msg,4+coap_header.TKL);
    msg->payload[0]                  = (COAP_VERSION    << 6) |
-                                      (COAP_TYPE_ACK   << 4) |
+                                      (coap_header.T   << 4) |
                                       (coap_header.TKL << 0);
    msg->payload[1]                  = coap_header.Code;
    msg->payload[2]                  = coap_header.messageID/256;
    msg->payload[3]                  = coap_header.messageID%256;
    memcpy(&msg->payload[4], &coap_header.token[0], coap_header.TKL);
    
+   // remember the response, for duplicates of the request
+   if (request_type==COAP_TYPE_CON) {
+      opencoap_dedupStore(msg,coap_header.messageID);
+   }
+   
    if ((openudp_send(msg))==E_FAIL) {
       openqueue_freePacketBuffer(msg);
    }
@@ -289,10 +495,22 @@ void opencoap_receive(OpenQueueEntry_t* msg) {
 */
 void opencoap_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
    coap_resource_desc_t* temp_resource;
+   uint8_t               i;
    
    // take ownership over that packet
    msg->owner = COMPONENT_OPENCOAP;
    
+   //=== confirmable, kept until its exchange completes
+   for (i=0;i<COAP_MAX_EXCHANGES;i++) {
+      if (opencoap_vars.exchanges[i].msg==msg) {
+         opencoap_vars.exchanges[i].busy = FALSE;
+         if (opencoap_vars.exchanges[i].done==TRUE) {
+            opencoap_completeExchange(&opencoap_vars.exchanges[i]);
+         }
+         return;
+      }
+   }
+   
    // indicate sendDone to creator of that packet
    //=== mine
    if (msg->creator==COMPONENT_OPENCOAP) {
@@ -327,16 +545,23 @@ void opencoap_sendDone(OpenQueueEntry_t* msg, owerror_t error) {
 /**
 \brief Writes the links to all the resources on this mote into the message.
 
-\param[out] msg The messge to write the links to.
+The links are written as the block of the link-format document requested,
+with the payload marker if the block is not empty.
+
+\param[out] msg The messge to write the links to, with an empty payload.
 \param[in] componentID The componentID calling this function.
 
-\post After this function returns, the msg contains 
+\post After this function returns, the msg contains the payload of the response.
 */
 void opencoap_writeLinks(OpenQueueEntry_t* msg, uint8_t componentID) {
    coap_resource_desc_t* temp_resource;
+   bool                  first;
+   
+   opencoap_startBlock2(msg);
    
    // start with the first resource in the linked list
    temp_resource = opencoap_vars.resources;
+   first         = TRUE;
    
    // iterate through all resources
    while (temp_resource!=NULL) {
@@ -349,37 +574,35 @@ void opencoap_writeLinks(OpenQueueEntry_t* msg, uint8_t componentID) {
                ((componentID==temp_resource->componentID) && (temp_resource->path1len!=0))
             )
          ) {
-          
-         // write ending '>'
-         packetfunctions_reserveHeaderSize(msg,1);
-         msg->payload[0] = '>';
+         
+         // write separator between links
+         if (first==FALSE) {
+            opencoap_writeBlock2((uint8_t*)",",1);
+         }
+         first = FALSE;
+         
+         // write opening '<' and path0
+         opencoap_writeBlock2((uint8_t*)"</",2);
+         opencoap_writeBlock2(temp_resource->path0val,temp_resource->path0len);
          
          // write path1
          if (temp_resource->path1len>0) {
-            packetfunctions_reserveHeaderSize(msg,temp_resource->path1len);
-            memcpy(&msg->payload[0],temp_resource->path1val,temp_resource->path1len);
-            packetfunctions_reserveHeaderSize(msg,1);
-            msg->payload[0] = '/';
+            opencoap_writeBlock2((uint8_t*)"/",1);
+            opencoap_writeBlock2(temp_resource->path1val,temp_resource->path1len);
          }
          
-         // write path0
-         packetfunctions_reserveHeaderSize(msg,temp_resource->path0len);
-         memcpy(msg->payload,temp_resource->path0val,temp_resource->path0len);
-         packetfunctions_reserveHeaderSize(msg,2);
-         msg->payload[1] = '/';
-         
-         // write opening '>'
-         msg->payload[0] = '<';
+         // write ending '>'
+         opencoap_writeBlock2((uint8_t*)">",1);
          
-         // write separator between links
-         if (temp_resource->next!=NULL) {
-            packetfunctions_reserveHeaderSize(msg,1);
-            msg->payload[0] = ',';
+         if (temp_resource->observable==TRUE) {
+            opencoap_writeBlock2((uint8_t*)";obs",4);
          }
       }
       // iterate to next resource
       temp_resource = temp_resource->next;
    }
+   
+   opencoap_endBlock2(msg);
 }
 
 /**
@@ -414,6 +637,165 @@ void opencoap_register(coap_resource_desc_t* desc) {
    last_elem->next = desc;
 }
 
+/**
+\brief Notify the observers of a resource that its state changed.
+
+Called by an observable CoAP resource. The notifications are sent from a task,
+each carrying the representation the resource returns to a GET request, so
+several changes in a row result in a single notification.
+
+\param[in] desc The description of the CoAP resource which changed.
+*/
+void opencoap_notify(coap_resource_desc_t* desc) {
+   uint8_t i;
+   bool    found;
+   
+   found = FALSE;
+   for (i=0;i<COAP_MAX_OBSERVERS;i++) {
+      if (opencoap_vars.observers[i].desc==desc) {
+         opencoap_vars.observers[i].pending = TRUE;
+         found = TRUE;
+      }
+   }
+   if (found==TRUE && opencoap_vars.notifyPosted==FALSE) {
+      opencoap_vars.notifyPosted = TRUE;
+      scheduler_push_task(opencoap_task_notify,TASKPRIO_COAP);
+   }
+}
+
+/**
+\brief Whether a resource has observers.
+
+Lets an observable resource only sample its state while being observed.
+
+\param[in] desc The description of the CoAP resource.
+
+\returns TRUE if at least one client observes the resource.
+*/
+bool opencoap_isObserved(coap_resource_desc_t* desc) {
+   uint8_t i;
+   
+   for (i=0;i<COAP_MAX_OBSERVERS;i++) {
+      if (opencoap_vars.observers[i].desc==desc) {
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Read a Block1 or Block2 option.
+
+\param[in]  coap_options The options of a message.
+\param[in]  type         COAP_OPTION_NUM_BLOCK1 or COAP_OPTION_NUM_BLOCK2.
+\param[out] num          The block number.
+\param[out] more         Whether more blocks follow.
+\param[out] szx          The block size, 2^(szx+4) bytes.
+
+\returns TRUE if the option is present and valid, FALSE otherwise.
+*/
+bool opencoap_parseBlock(
+      coap_option_iht*  coap_options,
+      coap_option_t     type,
+      uint32_t*         num,
+      bool*             more,
+      uint8_t*          szx
+   ) {
+   uint32_t value;
+   uint8_t  i;
+   uint8_t  j;
+   
+   for (i=0;i<MAX_COAP_OPTIONS && coap_options[i].type!=COAP_OPTION_NONE;i++) {
+      if (coap_options[i].type==type) {
+         if (coap_options[i].length>3) {
+            return FALSE;
+         }
+         value = 0;
+         for (j=0;j<coap_options[i].length;j++) {
+            value = (value<<8) | coap_options[i].pValue[j];
+         }
+         if ((value & COAP_BLOCK_SZX)==COAP_BLOCK_SZX) {
+            // reserved
+            return FALSE;
+         }
+         *num  = value>>4;
+         *more = (value & COAP_BLOCK_M)!=0;
+         *szx  = value & COAP_BLOCK_SZX;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/**
+\brief Start writing the representation of a resource as a stream.
+
+Called by a resource answering a GET, once it has reset the payload of the
+message. Only the block requested, or the first block, is written into the
+message, so a representation can be longer than a packet. The Block2 option
+is added by opencoap, if needed.
+
+\param[in,out] msg The response, with an empty payload.
+*/
+void opencoap_startBlock2(OpenQueueEntry_t* msg) {
+   packetfunctions_reserveHeaderSize(msg,COAP_BLOCK_SIZE(opencoap_vars.block2.szx));
+   opencoap_vars.block2.buf    = msg->payload;
+   opencoap_vars.block2.length = 0;
+   opencoap_vars.block2.offset = 0;
+}
+
+/**
+\brief Write the next bytes of the representation.
+
+\param[in] data   The bytes, only those in the block are copied.
+\param[in] length The number of bytes.
+*/
+void opencoap_writeBlock2(uint8_t* data, uint8_t length) {
+   uint32_t start;
+   uint32_t end;
+   uint32_t from;
+   uint32_t to;
+   
+   if (opencoap_vars.block2.buf==NULL) {
+      return;
+   }
+   
+   start = opencoap_vars.block2.num << (opencoap_vars.block2.szx+4);
+   end   = start+COAP_BLOCK_SIZE(opencoap_vars.block2.szx);
+   
+   // part of the block in [offset,offset+length)
+   from  = opencoap_vars.block2.offset>start ? opencoap_vars.block2.offset : start;
+   to    = opencoap_vars.block2.offset+length<end ? opencoap_vars.block2.offset+length : end;
+   if (from<to) {
+      memcpy(
+         &opencoap_vars.block2.buf[from-start],
+         &data[from-opencoap_vars.block2.offset],
+         to-from
+      );
+      opencoap_vars.block2.length = to-start;
+   }
+   opencoap_vars.block2.offset += length;
+}
+
+/**
+\brief Finish writing the representation.
+
+The message is trimmed to the bytes written, preceded by the payload marker
+if any.
+
+\param[in,out] msg The response.
+*/
+void opencoap_endBlock2(OpenQueueEntry_t* msg) {
+   packetfunctions_tossFooter(
+      msg,
+      COAP_BLOCK_SIZE(opencoap_vars.block2.szx)-opencoap_vars.block2.length
+   );
+   if (opencoap_vars.block2.length>0) {
+      packetfunctions_reserveHeaderSize(msg,1);
+      msg->payload[0] = COAP_PAYLOAD_MARKER;
+   }
+}
+
 /**
 \brief Send a CoAP request.
 
@@ -428,6 +810,12 @@ This function is NOT called for a response.
 \param[out] descSender A pointer to the description of the calling CoAP
    resource.
 
+A confirmable message is kept by this module and retransmitted until it is
+acknowledged, descSender's sendDone is called once it is acknowledged (E_SUCCESS)
+or reset, or once all retransmissions timed out (E_FAIL). It is refused when
+COAP_NSTART exchanges with its destination, or COAP_MAX_EXCHANGES in total, are
+outstanding.
+
 \post After returning, this function will have written the messageID and TOKEN
    used in the descSender parameter.
 
@@ -443,6 +831,17 @@ owerror_t opencoap_send(
    uint16_t token;
    uint8_t tokenPos=0;
    coap_header_iht* request;
+   coap_exchange_t* exchange;
+   owerror_t outcome;
+   
+   // a confirmable message needs an exchange to be retransmitted from
+   exchange = NULL;
+   if (type==COAP_TYPE_CON) {
+      exchange = opencoap_newExchange(msg,descSender);
+      if (exchange==NULL) {
+         return E_FAIL;
+      }
+   }
    
    // increment the (global) messageID
    if (opencoap_vars.messageID++ == 0xffff) {
@@ -479,7 +878,847 @@ owerror_t opencoap_send(
 
    memcpy(&msg->payload[4],&token,request->TKL);
    
-   return openudp_send(msg);
+   if (exchange!=NULL) {
+      exchange->messageID           = request->messageID;
+   }
+   
+   outcome = openudp_send(msg);
+   if (outcome==E_FAIL && exchange!=NULL) {
+      // the caller frees the message
+      exchange->msg                 = NULL;
+   }
+   return outcome;
 }
 
 //=========================== private =========================================
+
+//===== Observe
+
+/**
+\brief Register or cancel an observation of a resource (RFC7641).
+
+Called once the resource prepared its response to a GET. A registration is
+accepted if the resource is observable, the response is successful and a row
+is free, in which case an Observe option is added to the response. Any other
+GET from the same client, with the same token, cancels its observation.
+
+\param[in,out] msg     The response, still with the addresses of the request.
+\param[in] desc        The resource the request is for.
+\param[in] coap_header The header of the response.
+\param[in] observe     The value of the Observe option of the request,
+   COAP_OBSERVE_NONE if absent.
+*/
+void opencoap_handleObserve(
+      OpenQueueEntry_t*     msg,
+      coap_resource_desc_t* desc,
+      coap_header_iht*      coap_header,
+      uint32_t              observe
+   ) {
+   coap_observer_t*     observer;
+   coap_observer_t*     freeRow;
+   uint8_t              i;
+   
+   // find the observation, or a free row
+   observer = NULL;
+   freeRow  = NULL;
+   for (i=0;i<COAP_MAX_OBSERVERS;i++) {
+      if (opencoap_vars.observers[i].desc==NULL) {
+         if (freeRow==NULL) {
+            freeRow = &opencoap_vars.observers[i];
+         }
+      } else if (
+            opencoap_vars.observers[i].desc==desc                                            &&
+            opencoap_vars.observers[i].port==msg->l4_sourcePortORicmpv6Type                  &&
+            opencoap_vars.observers[i].TKL==coap_header->TKL                                 &&
+            memcmp(opencoap_vars.observers[i].token,coap_header->token,coap_header->TKL)==0 &&
+            packetfunctions_sameAddress(&opencoap_vars.observers[i].address,&msg->l3_sourceAdd)
+         ) {
+         observer = &opencoap_vars.observers[i];
+      }
+   }
+   
+   if (
+         observe==COAP_OBSERVE_DEREGISTER             ||
+         observe==COAP_OBSERVE_NONE                   ||
+         desc->observable==FALSE                      ||
+         coap_header->Code!=COAP_CODE_RESP_CONTENT
+      ) {
+      // not, or no longer, observing
+      if (observer!=NULL) {
+         observer->desc = NULL;
+      }
+      return;
+   }
+   
+   if (observer==NULL) {
+      if (freeRow==NULL) {
+         // answer as to a plain GET
+         openserial_printError(
+            COMPONENT_OPENCOAP,ERR_COAP_NO_FREE_OBSERVER,
+            (errorparameter_t)desc->componentID,
+            (errorparameter_t)0
+         );
+         return;
+      }
+      observer                 = freeRow;
+      observer->desc           = desc;
+      memcpy(&observer->address,&msg->l3_sourceAdd,sizeof(open_addr_t));
+      observer->port           = msg->l4_sourcePortORicmpv6Type;
+      observer->TKL            = coap_header->TKL;
+      memcpy(observer->token,coap_header->token,coap_header->TKL);
+   }
+   observer->messageID         = coap_header->messageID;
+   observer->pending           = FALSE;
+   
+   if (opencoap_addObserve(msg)==E_FAIL) {
+      observer->desc           = NULL;
+   }
+}
+
+/**
+\brief Add an Observe option to a response, with the next sequence number.
+
+\param[in,out] msg The response, its payload pointing at its options.
+
+\returns The outcome of inserting the option.
+*/
+owerror_t opencoap_addObserve(OpenQueueEntry_t* msg) {
+   uint8_t              value[4];
+   
+   opencoap_vars.observeSeq = (opencoap_vars.observeSeq+1) & COAP_OBSERVE_MAXSEQ;
+   
+   return opencoap_insertOption(
+      msg,
+      COAP_OPTION_NUM_OBSERVE,
+      value,
+      opencoap_encodeUint(opencoap_vars.observeSeq,value)
+   );
+}
+
+/**
+\brief Send the pending notifications.
+*/
+void opencoap_task_notify() {
+   uint8_t i;
+   
+   opencoap_vars.notifyPosted = FALSE;
+   
+   for (i=0;i<COAP_MAX_OBSERVERS;i++) {
+      if (
+            opencoap_vars.observers[i].desc!=NULL &&
+            opencoap_vars.observers[i].pending==TRUE
+         ) {
+         opencoap_sendNotification(&opencoap_vars.observers[i]);
+      }
+   }
+}
+
+/**
+\brief Send a notification to an observer.
+
+The representation is written by the resource, as for a GET. A resource which
+fails or returns an error ends the observation, after a last notification
+without Observe option in the latter case.
+
+\param[in] observer The observer to notify.
+*/
+void opencoap_sendNotification(coap_observer_t* observer) {
+   OpenQueueEntry_t*         msg;
+   coap_resource_desc_t*     desc;
+   coap_header_iht           coap_header;
+   coap_option_iht           coap_options[MAX_COAP_OPTIONS];
+   owerror_t                 outcome;
+   uint8_t                   i;
+   
+   desc = observer->desc;
+   
+   msg = openqueue_getFreePacketBuffer(COMPONENT_OPENCOAP);
+   if (msg==NULL) {
+      // still pending, sent at the next change
+      openserial_printError(
+         COMPONENT_OPENCOAP,ERR_NO_FREE_PACKET_BUFFER,
+         (errorparameter_t)0,
+         (errorparameter_t)0
+      );
+      return;
+   }
+   observer->pending                   = FALSE;
+   
+   // take ownership over that packet
+   msg->creator                        = COMPONENT_OPENCOAP;
+   msg->owner                          = COMPONENT_OPENCOAP;
+   
+   // have the resource write its representation, as for a GET
+   memset(&coap_header,0,sizeof(coap_header_iht));
+   coap_header.Ver                     = COAP_VERSION;
+   coap_header.T                       = COAP_TYPE_NON;
+   coap_header.Code                    = COAP_CODE_REQ_GET;
+   coap_header.TKL                     = observer->TKL;
+   memcpy(coap_header.token,observer->token,observer->TKL);
+   for (i=0;i<MAX_COAP_OPTIONS;i++) {
+      coap_options[i].type             = COAP_OPTION_NONE;
+   }
+   opencoap_prepareBlocks(desc,&coap_options[0]);
+   coap_options[0].type                = COAP_OPTION_NUM_URIPATH;
+   coap_options[0].length              = desc->path0len;
+   coap_options[0].pValue              = desc->path0val;
+   if (desc->path1len>0) {
+      coap_options[1].type             = COAP_OPTION_NUM_URIPATH;
+      coap_options[1].length           = desc->path1len;
+      coap_options[1].pValue           = desc->path1val;
+   }
+   outcome = desc->callbackRx(msg,&coap_header,&coap_options[0]);
+   if (outcome==E_FAIL) {
+      observer->desc                   = NULL;
+      openqueue_freePacketBuffer(msg);
+      return;
+   }
+   opencoap_addBlockOptions(msg,&coap_header,&coap_options[0]);
+   if (
+         coap_header.Code!=COAP_CODE_RESP_CONTENT ||
+         opencoap_addObserve(msg)==E_FAIL
+      ) {
+      observer->desc                   = NULL;
+   }
+   
+   // increment the (global) messageID
+   if (opencoap_vars.messageID++ == 0xffff) {
+      opencoap_vars.messageID = 0;
+   }
+   observer->messageID                 = opencoap_vars.messageID;
+   
+   // fill in packet metadata
+   msg->l4_protocol                    = IANA_UDP;
+   msg->l4_sourcePortORicmpv6Type      = WKP_UDP_COAP;
+   msg->l4_destination_port            = observer->port;
+   memcpy(&msg->l3_destinationAdd,&observer->address,sizeof(open_addr_t));
+   
+   // fill in CoAP header
+   packetfunctions_reserveHeaderSize(msg,4+coap_header.TKL);
+   msg->payload[0]                     = (COAP_VERSION    << 6) |
+                                         (COAP_TYPE_NON   << 4) |
+                                         (coap_header.TKL << 0);
+   msg->payload[1]                     = coap_header.Code;
+   msg->payload[2]                     = (observer->messageID>>8) & 0xff;
+   msg->payload[3]                     = (observer->messageID>>0) & 0xff;
+   memcpy(&msg->payload[4],&coap_header.token[0],coap_header.TKL);
+   
+   if ((openudp_send(msg))==E_FAIL) {
+      openqueue_freePacketBuffer(msg);
+   }
+}
+
+//===== Block
+
+/**
+\brief Prepare the block of the response to a request (RFC7959).
+
+By default, a response which does not fit in a block of COAP_MAX_SZX is sent
+block-wise. A client asking for larger blocks gets the same bytes, in blocks
+of COAP_MAX_SZX.
+
+A request sent block-wise is refused unless the resource reassembles it, as
+indicated by the "blockwise" field of its description (RFC7959, section 2.3).
+
+\param[in] desc         The resource the request is for.
+\param[in] coap_options The options of the request.
+
+\returns E_FAIL if the request carries a Block1 option the resource does not
+   accept, E_SUCCESS otherwise.
+*/
+owerror_t opencoap_prepareBlocks(coap_resource_desc_t* desc, coap_option_iht* coap_options) {
+   coap_block_iht*      block;
+   uint32_t             num;
+   bool                 more;
+   uint8_t              szx;
+   uint8_t              i;
+   
+   if (
+         desc->blockwise==FALSE &&
+         opencoap_parseBlock(coap_options,COAP_OPTION_NUM_BLOCK1,&num,&more,&szx)==TRUE
+      ) {
+      return E_FAIL;
+   }
+   
+   block = &opencoap_vars.block2;
+   memset(block,0,sizeof(coap_block_iht));
+   block->szx = COAP_MAX_SZX;
+   
+   if (opencoap_parseBlock(coap_options,COAP_OPTION_NUM_BLOCK2,&block->num,&more,&block->szx)==TRUE) {
+      block->requested = TRUE;
+      if (block->szx>COAP_MAX_SZX) {
+         block->num <<= block->szx-COAP_MAX_SZX;
+         block->szx   = COAP_MAX_SZX;
+      }
+   }
+   
+   for (i=0;i<MAX_COAP_OPTIONS && coap_options[i].type!=COAP_OPTION_NONE;i++) {
+      if (coap_options[i].type==COAP_OPTION_NUM_SIZE2) {
+         block->size2 = TRUE;
+      }
+   }
+   
+   return E_SUCCESS;
+}
+
+/**
+\brief Add the Block1, Block2 and Size2 options to a response.
+
+A successful response to a block of a request which is not the last one is
+turned into a 2.31 (Continue), for the client to send the next block. Only
+resources which take requests block-wise get this far with a Block1 option,
+they find the block they received with opencoap_parseBlock().
+
+\param[in,out] msg     The response, its payload pointing at its options.
+\param[in,out] coap_header  The header of the response.
+\param[in] coap_options     The options of the request.
+*/
+void opencoap_addBlockOptions(
+      OpenQueueEntry_t* msg,
+      coap_header_iht*  coap_header,
+      coap_option_iht*  coap_options
+   ) {
+   coap_block_iht*      block;
+   uint32_t             num;
+   bool                 more;
+   uint8_t              szx;
+   uint8_t              value[4];
+   
+   // Block1: acknowledge the block received
+   if (
+         opencoap_parseBlock(coap_options,COAP_OPTION_NUM_BLOCK1,&num,&more,&szx)==TRUE &&
+         coap_header->Code>=COAP_CODE_RESP_CREATED                                       &&
+         coap_header->Code<=COAP_CODE_RESP_CONTINUE
+      ) {
+      if (more==TRUE) {
+         coap_header->Code = COAP_CODE_RESP_CONTINUE;
+      }
+      opencoap_insertOption(
+         msg,
+         COAP_OPTION_NUM_BLOCK1,
+         value,
+         opencoap_encodeUint((num<<4) | (more==TRUE ? COAP_BLOCK_M : 0) | szx,value)
+      );
+   }
+   
+   // Block2: the block of the representation written by the resource
+   block = &opencoap_vars.block2;
+   if (block->buf==NULL) {
+      return;
+   }
+   block->buf = NULL;
+   
+   if (block->length==0 && block->num>0) {
+      // past the end of the representation
+      packetfunctions_tossHeader(msg,msg->length);
+      coap_header->Code = COAP_CODE_RESP_BADOPTION;
+      return;
+   }
+   
+   more = block->offset>((block->num+1) << (block->szx+4));
+   if (block->requested==TRUE || more==TRUE) {
+      opencoap_insertOption(
+         msg,
+         COAP_OPTION_NUM_BLOCK2,
+         value,
+         opencoap_encodeUint((block->num<<4) | (more==TRUE ? COAP_BLOCK_M : 0) | block->szx,value)
+      );
+   }
+   if (block->size2==TRUE) {
+      opencoap_insertOption(
+         msg,
+         COAP_OPTION_NUM_SIZE2,
+         value,
+         opencoap_encodeUint(block->offset,value)
+      );
+   }
+}
+
+//===== options
+
+/**
+\brief Insert an option among the options of a message.
+
+Resources write their options from option 0. The option is inserted in order,
+and the delta of the option following it is rewritten.
+
+\param[in,out] msg The message, its payload pointing at its options.
+\param[in] type    The number of the option.
+\param[in] value   The value of the option.
+\param[in] length  The length of the value.
+
+\returns E_FAIL if the options of the message are malformed, E_SUCCESS
+   otherwise.
+*/
+owerror_t opencoap_insertOption(
+      OpenQueueEntry_t* msg,
+      coap_option_t     type,
+      uint8_t*          value,
+      uint8_t           length
+   ) {
+   uint16_t             number;        // of the last option before the new one
+   uint16_t             delta;
+   uint16_t             optionLength;
+   uint8_t              index;         // of the first option after the new one
+   uint8_t              headerOld;     // length of its header
+   uint8_t              headerNew;
+   uint8_t              newLength;     // length of the new option
+   uint8_t              shift;
+   
+   // find where to insert
+   number    = 0;
+   index     = 0;
+   headerOld = 0;
+   while (index<msg->length && msg->payload[index]!=COAP_PAYLOAD_MARKER) {
+      headerOld = opencoap_readOptionHeader(&msg->payload[index],&delta,&optionLength);
+      if (index+headerOld+optionLength>msg->length) {
+         return E_FAIL;
+      }
+      if (number+delta>(uint16_t)type) {
+         break;
+      }
+      number   += delta;
+      index    += headerOld+optionLength;
+      headerOld = 0;
+   }
+   
+   // the next option's delta becomes relative to the new option
+   newLength = opencoap_optionHeaderLength(type-number,length)+length;
+   headerNew = 0;
+   if (headerOld>0) {
+      delta     = number+delta-type;
+      headerNew = opencoap_optionHeaderLength(delta,optionLength);
+   }
+   
+   // make room, the options before the new one move to the front
+   shift = newLength+headerNew-headerOld;
+   packetfunctions_reserveHeaderSize(msg,shift);
+   memmove(msg->payload,msg->payload+shift,index);
+   
+   opencoap_writeOptionHeader(&msg->payload[index],type-number,length);
+   memcpy(&msg->payload[index+newLength-length],value,length);
+   if (headerOld>0) {
+      opencoap_writeOptionHeader(&msg->payload[index+newLength],delta,optionLength);
+   }
+   
+   return E_SUCCESS;
+}
+
+/**
+\brief Read the header of an option, with its extended delta and length.
+
+\returns The length of the header.
+*/
+uint8_t opencoap_readOptionHeader(uint8_t* buf, uint16_t* delta, uint16_t* length) {
+   uint8_t i;
+   
+   *delta  = buf[0] >> 4;
+   *length = buf[0] & 0x0f;
+   i       = 1;
+   if (*delta==13) {
+      *delta   = 13+buf[i];
+      i       += 1;
+   } else if (*delta==14) {
+      *delta   = 269+buf[i]*256+buf[i+1];
+      i       += 2;
+   }
+   if (*length==13) {
+      *length  = 13+buf[i];
+      i       += 1;
+   } else if (*length==14) {
+      *length  = 269+buf[i]*256+buf[i+1];
+      i       += 2;
+   }
+   return i;
+}
+
+/**
+\brief Write the header of an option, with its extended delta and length.
+
+\returns The length of the header.
+*/
+uint8_t opencoap_writeOptionHeader(uint8_t* buf, uint16_t delta, uint16_t length) {
+   uint8_t i;
+   
+   i = 1;
+   if (delta<13) {
+      buf[0]    = delta << 4;
+   } else if (delta<269) {
+      buf[0]    = 13 << 4;
+      buf[i++]  = delta-13;
+   } else {
+      buf[0]    = 14 << 4;
+      buf[i++]  = (delta-269) >> 8;
+      buf[i++]  = (delta-269) & 0xff;
+   }
+   if (length<13) {
+      buf[0]   |= length;
+   } else if (length<269) {
+      buf[0]   |= 13;
+      buf[i++]  = length-13;
+   } else {
+      buf[0]   |= 14;
+      buf[i++]  = (length-269) >> 8;
+      buf[i++]  = (length-269) & 0xff;
+   }
+   return i;
+}
+
+/**
+\brief The length of the header of an option.
+*/
+uint8_t opencoap_optionHeaderLength(uint16_t delta, uint16_t length) {
+   uint8_t len;
+   
+   len = 1;
+   if (delta>=269) {
+      len += 2;
+   } else if (delta>=13) {
+      len += 1;
+   }
+   if (length>=269) {
+      len += 2;
+   } else if (length>=13) {
+      len += 1;
+   }
+   return len;
+}
+
+/**
+\brief Encode an unsigned integer option value, in as few bytes as possible.
+
+\param[in]  value The value.
+\param[out] buf   At least 4 bytes, the value in network order.
+
+\returns The length of the encoded value, 0 for value 0.
+*/
+uint8_t opencoap_encodeUint(uint32_t value, uint8_t* buf) {
+   uint8_t  length;
+   uint8_t  i;
+   uint32_t temp;
+   
+   length = 0;
+   for (temp=value;temp>0;temp>>=8) {
+      length++;
+   }
+   for (i=0;i<length;i++) {
+      buf[i] = (value >> (8*(length-1-i))) & 0xff;
+   }
+   return length;
+}
+
+//===== confirmable messages
+
+/**
+\brief Start the exchange of a confirmable message (RFC7252, section 4.2).
+
+\param[in] msg  The message, with its destination filled in.
+\param[in] desc The resource sending it.
+
+\returns The exchange, NULL if NSTART is reached or no row is free.
+*/
+coap_exchange_t* opencoap_newExchange(OpenQueueEntry_t* msg, coap_resource_desc_t* desc) {
+   coap_exchange_t* exchange;
+   uint8_t          numOutstanding;
+   uint32_t         timeout;
+   uint8_t          i;
+   
+   exchange       = NULL;
+   numOutstanding = 0;
+   for (i=0;i<COAP_MAX_EXCHANGES;i++) {
+      if (opencoap_vars.exchanges[i].msg==NULL) {
+         if (exchange==NULL) {
+            exchange = &opencoap_vars.exchanges[i];
+         }
+      } else if (
+            packetfunctions_sameAddress(
+               &opencoap_vars.exchanges[i].msg->l3_destinationAdd,
+               &msg->l3_destinationAdd
+            )
+         ) {
+         numOutstanding++;
+      }
+   }
+   if (
+         exchange==NULL                  ||
+         numOutstanding>=COAP_NSTART     ||
+         opencoap_armTimer()==E_FAIL
+      ) {
+      openserial_printError(
+         COMPONENT_OPENCOAP,ERR_COAP_NO_FREE_EXCHANGE,
+         (errorparameter_t)desc->componentID,
+         (errorparameter_t)numOutstanding
+      );
+      return NULL;
+   }
+   
+   // initial timeout, random between ACK_TIMEOUT and ACK_TIMEOUT*ACK_RANDOM_FACTOR
+   timeout  = (uint32_t)COAP_ACK_TIMEOUT*(COAP_ACK_RANDOM_FACTOR-100)/100;
+   timeout  = COAP_ACK_TIMEOUT+openrandom_get16b()%(timeout+1);
+   
+   exchange->msg                 = msg;
+   exchange->desc                = desc;
+   exchange->retransmissions     = 0;
+   exchange->timeout             = (uint16_t)((timeout+COAP_TIMER_PERIOD-1)/COAP_TIMER_PERIOD);
+   exchange->ticksLeft           = exchange->timeout;
+   exchange->busy                = TRUE;
+   exchange->done                = FALSE;
+   exchange->outcome             = E_SUCCESS;
+   return exchange;
+}
+
+/**
+\brief The exchange is over, complete it once the message is back.
+
+\param[in] exchange The exchange.
+\param[in] outcome  E_SUCCESS if acknowledged, E_FAIL if reset or timed out.
+*/
+void opencoap_endExchange(coap_exchange_t* exchange, owerror_t outcome) {
+   exchange->done    = TRUE;
+   exchange->outcome = outcome;
+   if (exchange->busy==FALSE) {
+      opencoap_completeExchange(exchange);
+   }
+}
+
+/**
+\brief Hand the message back to its resource, and free the exchange.
+*/
+void opencoap_completeExchange(coap_exchange_t* exchange) {
+   OpenQueueEntry_t* msg;
+   
+   msg           = exchange->msg;
+   exchange->msg = NULL;
+   if (exchange->desc->callbackSendDone!=NULL) {
+      exchange->desc->callbackSendDone(msg,exchange->outcome);
+   } else {
+      openqueue_freePacketBuffer(msg);
+   }
+}
+
+/**
+\brief Send a copy of a confirmable message.
+
+The message itself may still be in the lower layers, the copy is freed once
+sent. A copy which cannot be sent counts as a retransmission.
+*/
+void opencoap_retransmit(coap_exchange_t* exchange) {
+   OpenQueueEntry_t* msg;
+   
+   msg = openqueue_getFreePacketBufferForLength(COMPONENT_OPENCOAP,exchange->msg->l4_length);
+   if (msg==NULL) {
+      openserial_printError(
+         COMPONENT_OPENCOAP,ERR_NO_FREE_PACKET_BUFFER,
+         (errorparameter_t)0,
+         (errorparameter_t)0
+      );
+      return;
+   }
+   
+   // take ownership over that packet
+   msg->creator                        = COMPONENT_OPENCOAP;
+   msg->owner                          = COMPONENT_OPENCOAP;
+   
+   // fill in packet metadata
+   msg->l4_protocol                    = IANA_UDP;
+   msg->l4_sourcePortORicmpv6Type      = exchange->msg->l4_sourcePortORicmpv6Type;
+   msg->l4_destination_port            = exchange->msg->l4_destination_port;
+   memcpy(&msg->l3_destinationAdd,&exchange->msg->l3_destinationAdd,sizeof(open_addr_t));
+   
+   // copy the CoAP message
+   packetfunctions_reserveHeaderSize(msg,exchange->msg->l4_length);
+   memcpy(&msg->payload[0],exchange->msg->l4_payload,exchange->msg->l4_length);
+   
+   if ((openudp_send(msg))==E_FAIL) {
+      openqueue_freePacketBuffer(msg);
+   }
+}
+
+/**
+\brief Arm the retransmission timer, if not armed already.
+
+\returns E_FAIL if no timer is available.
+*/
+owerror_t opencoap_armTimer() {
+   if (opencoap_vars.timerId==TOO_MANY_TIMERS_ERROR) {
+      opencoap_vars.timerId = opentimers_start(
+         COAP_TIMER_PERIOD,
+         TIMER_ONESHOT,
+         TIME_MS,
+         opencoap_timer_cb
+      );
+      if (opencoap_vars.timerId==TOO_MANY_TIMERS_ERROR) {
+         return E_FAIL;
+      }
+   }
+   return E_SUCCESS;
+}
+
+void opencoap_timer_cb(opentimer_id_t id) {
+   scheduler_push_task(opencoap_timer_task,TASKPRIO_COAP);
+}
+
+/**
+\brief Retransmit the confirmable messages whose timeout expired.
+
+The timeout doubles at each retransmission, an exchange fails once the timeout
+after the last of COAP_MAX_RETRANSMIT retransmissions expires.
+*/
+void opencoap_timer_task() {
+   coap_exchange_t* exchange;
+   bool             outstanding;
+   uint8_t          i;
+   
+   // the one-shot timer is over
+   opencoap_vars.timerId = TOO_MANY_TIMERS_ERROR;
+   
+   outstanding = FALSE;
+   for (i=0;i<COAP_MAX_EXCHANGES;i++) {
+      exchange = &opencoap_vars.exchanges[i];
+      if (exchange->msg==NULL || exchange->done==TRUE) {
+         continue;
+      }
+      if (exchange->ticksLeft>0) {
+         exchange->ticksLeft--;
+      }
+      if (exchange->ticksLeft==0) {
+         if (exchange->retransmissions<COAP_MAX_RETRANSMIT) {
+            opencoap_retransmit(exchange);
+            exchange->retransmissions++;
+            exchange->timeout   *= 2;
+            exchange->ticksLeft  = exchange->timeout;
+         } else {
+            opencoap_endExchange(exchange,E_FAIL);
+            continue;
+         }
+      }
+      outstanding = TRUE;
+   }
+   
+   if (outstanding==FALSE || opencoap_armTimer()==E_SUCCESS) {
+      return;
+   }
+   
+   // without a timer, the exchanges would never time out
+   for (i=0;i<COAP_MAX_EXCHANGES;i++) {
+      exchange = &opencoap_vars.exchanges[i];
+      if (exchange->msg!=NULL && exchange->done==FALSE) {
+         opencoap_endExchange(exchange,E_FAIL);
+      }
+   }
+}
+
+//===== replies
+
+/**
+\brief Address a received message back to its sender.
+*/
+void opencoap_prepareReply(OpenQueueEntry_t* msg) {
+   uint16_t temp_l4_destination_port;
+   
+   msg->l4_protocol                    = IANA_UDP;
+   temp_l4_destination_port            = msg->l4_destination_port;
+   msg->l4_destination_port            = msg->l4_sourcePortORicmpv6Type;
+   msg->l4_sourcePortORicmpv6Type      = temp_l4_destination_port;
+   
+   // set destination address as the current source
+   msg->l3_destinationAdd.type         = ADDR_128B;
+   memcpy(&msg->l3_destinationAdd.addr_128b[0],&msg->l3_sourceAdd.addr_128b[0],LENGTH_ADDR128b);
+}
+
+/**
+\brief Answer a received message with an empty ACK or RST, in the same buffer.
+
+\param[in] msg       The received message.
+\param[in] type      COAP_TYPE_ACK or COAP_TYPE_RES.
+\param[in] messageID The messageID of the received message.
+*/
+void opencoap_sendEmpty(OpenQueueEntry_t* msg, coap_type_t type, uint16_t messageID) {
+   
+   // reset packet payload
+   msg->payload                        = &(msg->packet[127]);
+   msg->length                         = 0;
+   msg->creator                        = COMPONENT_OPENCOAP;
+   opencoap_prepareReply(msg);
+   
+   // fill in CoAP header, without token
+   packetfunctions_reserveHeaderSize(msg,4);
+   msg->payload[0]                     = (COAP_VERSION    << 6) |
+                                         (type            << 4);
+   msg->payload[1]                     = COAP_CODE_EMPTY;
+   msg->payload[2]                     = messageID/256;
+   msg->payload[3]                     = messageID%256;
+   
+   // remember it, for duplicates of the message
+   opencoap_dedupStore(msg,messageID);
+   
+   if ((openudp_send(msg))==E_FAIL) {
+      openqueue_freePacketBuffer(msg);
+   }
+}
+
+/**
+\brief Find the reply to an earlier copy of a received confirmable message.
+
+\param[in] msg       The received message.
+\param[in] messageID Its messageID.
+
+\returns The row, NULL if the message is not a duplicate.
+*/
+coap_dedup_t* opencoap_dedupLookup(OpenQueueEntry_t* msg, uint16_t messageID) {
+   uint8_t i;
+   
+   for (i=0;i<COAP_DEDUP_CACHE;i++) {
+      if (
+            opencoap_vars.dedup[i].used==TRUE                                        &&
+            opencoap_vars.dedup[i].messageID==messageID                              &&
+            opencoap_vars.dedup[i].port==msg->l4_sourcePortORicmpv6Type              &&
+            packetfunctions_sameAddress(&opencoap_vars.dedup[i].address,&msg->l3_sourceAdd)
+         ) {
+         return &opencoap_vars.dedup[i];
+      }
+   }
+   return NULL;
+}
+
+/**
+\brief Remember the reply to a confirmable message, replacing the oldest one.
+
+A reply longer than COAP_DEDUP_MAXLEN is not remembered, a duplicate of its
+message is handled again.
+
+\param[in] msg       The reply, addressed and with its CoAP header.
+\param[in] messageID The messageID of the confirmable message.
+*/
+void opencoap_dedupStore(OpenQueueEntry_t* msg, uint16_t messageID) {
+   coap_dedup_t* dedup;
+   uint8_t       i;
+   
+   // a message handled again keeps its row
+   dedup = NULL;
+   for (i=0;i<COAP_DEDUP_CACHE;i++) {
+      if (
+            opencoap_vars.dedup[i].used==TRUE                                        &&
+            opencoap_vars.dedup[i].messageID==messageID                              &&
+            opencoap_vars.dedup[i].port==msg->l4_destination_port                    &&
+            packetfunctions_sameAddress(&opencoap_vars.dedup[i].address,&msg->l3_destinationAdd)
+         ) {
+         dedup = &opencoap_vars.dedup[i];
+      }
+   }
+   if (dedup==NULL) {
+      dedup                            = &opencoap_vars.dedup[opencoap_vars.dedupNext];
+      opencoap_vars.dedupNext          = (opencoap_vars.dedupNext+1)%COAP_DEDUP_CACHE;
+   }
+   
+   dedup->used                         = TRUE;
+   dedup->messageID                    = messageID;
+   dedup->port                         = msg->l4_destination_port;
+   memcpy(&dedup->address,&msg->l3_destinationAdd,sizeof(open_addr_t));
+   if (msg->length<=COAP_DEDUP_MAXLEN) {
+      dedup->length                    = msg->length;
+      memcpy(&dedup->response[0],&msg->payload[0],msg->length);
+   } else {
+      dedup->length                    = 0;
+   }
+}
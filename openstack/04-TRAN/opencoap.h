@@ -37,6 +37,51 @@ static const uint8_t ipAddr_ringmaster[] = {0xbb, 0xbb, 0x00, 0x00, 0x00, 0x00,
 
 #define COAP_VERSION                   1
 
+// Observe (RFC7641)
+#ifndef COAP_MAX_OBSERVERS
+#define COAP_MAX_OBSERVERS             4 // observers of all resources, registered at the same time
+#endif
+#define COAP_OBSERVE_REGISTER          0
+#define COAP_OBSERVE_DEREGISTER        1
+#define COAP_OBSERVE_NONE              0xffffffff // no Observe option in the request
+#define COAP_OBSERVE_MAXSEQ            0x00ffffff // sequence numbers are 24-bit
+
+// Block-wise transfers (RFC7959), blocks of 2^(SZX+4) bytes
+#ifndef COAP_MAX_SZX
+#define COAP_MAX_SZX                   2 // largest block I send, 64B
+#endif
+#define COAP_BLOCK_SIZE(szx)           (1<<((szx)+4))
+#define COAP_BLOCK_M                   0x08
+#define COAP_BLOCK_SZX                 0x07
+
+// Confirmable messages (RFC7252, section 4.8), TSCH networks may need a larger ACK_TIMEOUT
+#ifndef COAP_ACK_TIMEOUT
+#define COAP_ACK_TIMEOUT               2000 // in ms
+#endif
+#ifndef COAP_ACK_RANDOM_FACTOR
+#define COAP_ACK_RANDOM_FACTOR         150  // in percent
+#endif
+#ifndef COAP_MAX_RETRANSMIT
+#define COAP_MAX_RETRANSMIT            4
+#endif
+#ifndef COAP_NSTART
+#define COAP_NSTART                    1    // outstanding exchanges with a same endpoint
+#endif
+#ifndef COAP_MAX_EXCHANGES
+#define COAP_MAX_EXCHANGES             2    // outstanding exchanges with all endpoints
+#endif
+#define COAP_TIMER_PERIOD              250  // in ms, granularity of the retransmission timeouts
+
+// responses to confirmable requests remembered, to answer duplicates
+#ifndef COAP_DEDUP_CACHE
+#define COAP_DEDUP_CACHE               2
+#endif
+// longest response remembered, in bytes: a header with the longest token, the
+// options opencoap and the resource add (16B) and a payload marker before a block
+#ifndef COAP_DEDUP_MAXLEN
+#define COAP_DEDUP_MAXLEN              (4+COAP_MAX_TKL+16+1+COAP_BLOCK_SIZE(COAP_MAX_SZX))
+#endif
+
 typedef enum {
    COAP_TYPE_CON                       = 0,
    COAP_TYPE_NON                       = 1,
@@ -58,6 +103,7 @@ typedef enum {
    COAP_CODE_RESP_VALID                = 67,
    COAP_CODE_RESP_CHANGED              = 68,
    COAP_CODE_RESP_CONTENT              = 69,
+   COAP_CODE_RESP_CONTINUE             = 95,
    // - not OK
    COAP_CODE_RESP_BADREQ               = 128,
    COAP_CODE_RESP_UNAUTHORIZED         = 129,
@@ -83,6 +129,7 @@ typedef enum {
    COAP_OPTION_NUM_URIHOST             = 3,
    COAP_OPTION_NUM_ETAG                = 4,
    COAP_OPTION_NUM_IFNONEMATCH         = 5,
+   COAP_OPTION_NUM_OBSERVE             = 6,
    COAP_OPTION_NUM_URIPORT             = 7,
    COAP_OPTION_NUM_LOCATIONPATH        = 8,
    COAP_OPTION_NUM_URIPATH             = 11,
@@ -91,6 +138,9 @@ typedef enum {
    COAP_OPTION_NUM_URIQUERY            = 15,
    COAP_OPTION_NUM_ACCEPT              = 16,
    COAP_OPTION_NUM_LOCATIONQUERY       = 20,
+   COAP_OPTION_NUM_BLOCK2              = 23,
+   COAP_OPTION_NUM_BLOCK1              = 27,
+   COAP_OPTION_NUM_SIZE2               = 28,
    COAP_OPTION_NUM_PROXYURI            = 35,
    COAP_OPTION_NUM_PROXYSCHEME         = 39,
 } coap_option_t;
@@ -127,6 +177,22 @@ typedef owerror_t (*callbackRx_cbt)(OpenQueueEntry_t* msg,
 typedef void (*callbackSendDone_cbt)(OpenQueueEntry_t* msg,
                                       owerror_t error);
 
+/**
+\brief The block of a representation being generated.
+
+The representation is generated as a stream, only the bytes of the requested
+block are written into the message.
+*/
+typedef struct {
+   uint32_t      num;              ///< block number.
+   uint8_t       szx;              ///< block size, 2^(szx+4) bytes.
+   bool          requested;        ///< the request carried a Block2 option.
+   bool          size2;            ///< the request asked for the size of the representation.
+   uint8_t*      buf;              ///< start of the block in the message, NULL if not generating.
+   uint8_t       length;           ///< bytes written into the block.
+   uint32_t      offset;           ///< bytes of the representation generated so far.
+} coap_block_iht;
+
 typedef struct coap_resource_desc_t coap_resource_desc_t;
 
 struct coap_resource_desc_t {
@@ -136,12 +202,58 @@ struct coap_resource_desc_t {
    uint8_t*              path1val;
    uint8_t               componentID;
    bool                  discoverable;
+   bool                  observable;       ///< accepts Observe registrations, call opencoap_notify() on change.
+   bool                  blockwise;        ///< accepts requests sent block-wise, reads their Block1 with opencoap_parseBlock().
    callbackRx_cbt        callbackRx;
    callbackSendDone_cbt  callbackSendDone;
    coap_header_iht       last_request;
    coap_resource_desc_t* next;
 };
 
+/**
+\brief A client observing a resource.
+*/
+typedef struct {
+   coap_resource_desc_t* desc;             ///< observed resource, NULL if the row is free.
+   open_addr_t           address;
+   uint16_t              port;
+   uint8_t               TKL;
+   uint8_t               token[COAP_MAX_TKL];
+   uint16_t              messageID;        ///< of the last notification, a reset to it cancels the observation.
+   bool                  pending;          ///< the resource changed since the last notification.
+} coap_observer_t;
+
+/**
+\brief A confirmable message waiting for its acknowledgment.
+
+The message is kept until the exchange completes, its retransmissions are
+copies. The resource which sent it gets its sendDone when the exchange
+completes.
+*/
+typedef struct {
+   OpenQueueEntry_t*     msg;              ///< the message, NULL if the row is free.
+   coap_resource_desc_t* desc;             ///< the resource which sent it.
+   uint16_t              messageID;
+   uint8_t               retransmissions;  ///< sent so far.
+   uint16_t              timeout;          ///< current timeout, in COAP_TIMER_PERIOD units.
+   uint16_t              ticksLeft;        ///< before the next retransmission.
+   bool                  busy;             ///< the message is in the lower layers.
+   bool                  done;             ///< acknowledged, reset or timed out.
+   owerror_t             outcome;
+} coap_exchange_t;
+
+/**
+\brief The response to a confirmable request, replayed to its duplicates.
+*/
+typedef struct {
+   bool                  used;
+   open_addr_t           address;
+   uint16_t              port;
+   uint16_t              messageID;
+   uint8_t               length;           ///< of the response, 0 if too long to be remembered.
+   uint8_t               response[COAP_DEDUP_MAXLEN];
+} coap_dedup_t;
+
 //=========================== module variables ================================
 
 typedef struct {
@@ -149,6 +261,14 @@ typedef struct {
    bool                  busySending;
    uint8_t               delayCounter;
    uint16_t              messageID;
+   coap_observer_t       observers[COAP_MAX_OBSERVERS];
+   uint32_t              observeSeq;       ///< last Observe sequence number sent
+   bool                  notifyPosted;     ///< opencoap_task_notify() is in the scheduler
+   coap_block_iht        block2;           ///< block of the response being prepared
+   coap_exchange_t       exchanges[COAP_MAX_EXCHANGES];
+   opentimer_id_t        timerId;          ///< one-shot retransmission timer, TOO_MANY_TIMERS_ERROR when not armed
+   coap_dedup_t          dedup[COAP_DEDUP_CACHE];
+   uint8_t               dedupNext;        ///< row replaced next
 } opencoap_vars_t;
 
 //=========================== prototypes ======================================
@@ -161,6 +281,18 @@ void          opencoap_sendDone(OpenQueueEntry_t* msg, owerror_t error);
 // from CoAP resources
 void          opencoap_writeLinks(OpenQueueEntry_t* msg, uint8_t componentID);
 void          opencoap_register(coap_resource_desc_t* desc);
+void          opencoap_notify(coap_resource_desc_t* desc);
+bool          opencoap_isObserved(coap_resource_desc_t* desc);
+bool          opencoap_parseBlock(
+    coap_option_iht*      coap_options,
+    coap_option_t         type,
+    uint32_t*             num,
+    bool*                 more,
+    uint8_t*              szx
+);
+void          opencoap_startBlock2(OpenQueueEntry_t* msg);
+void          opencoap_writeBlock2(uint8_t* data, uint8_t length);
+void          opencoap_endBlock2(OpenQueueEntry_t* msg);
 owerror_t     opencoap_send(
     OpenQueueEntry_t*     msg,
     coap_type_t           type,
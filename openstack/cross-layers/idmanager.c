@@ -52,6 +52,9 @@ void idmanager_init() {
 
    // my16bID
    packetfunctions_mac64bToMac16b(&idmanager_vars.my64bID,&idmanager_vars.my16bID);
+   
+   // my address changed, its pseudo-header sum needs to be recomputed
+   packetfunctions_invalidateChecksumCache();
 
 }
 
@@ -113,12 +116,14 @@ owerror_t idmanager_setMyID(open_addr_t* newID) {
         break;
      case ADDR_64B:
         memcpy(&idmanager_vars.my64bID,newID,sizeof(open_addr_t));
+        packetfunctions_invalidateChecksumCache();
         break;
      case ADDR_PANID:
         memcpy(&idmanager_vars.myPANID,newID,sizeof(open_addr_t));
         break;
      case ADDR_PREFIX:
         memcpy(&idmanager_vars.myPrefix,newID,sizeof(open_addr_t));
+        packetfunctions_invalidateChecksumCache();
         break;
      case ADDR_128B:
         //don't set 128b, but rather prefix and 64b
@@ -242,8 +247,7 @@ bool debugPrint_id() {
    memcpy(output.my64bID,idmanager_vars.my64bID.addr_64b,8);
    memcpy(output.myPrefix,idmanager_vars.myPrefix.prefix,8);
 
-   openserial_printStatus(STATUS_ID,(uint8_t*)&output,sizeof(debugIDManagerEntry_t));
-   return TRUE;
+   return openserial_printStatusOnChange(STATUS_ID,(uint8_t*)&output,sizeof(debugIDManagerEntry_t));
 }
 
 
@@ -11,7 +11,12 @@ openqueue_vars_t openqueue_vars;
 
 //=========================== prototypes ======================================
 
-void openqueue_reset_entry(OpenQueueEntry_t* entry);
+void    openqueue_reset_entry(OpenQueueEntry_t* entry);
+OpenQueueEntry_t* openqueue_getFreeEntry(uint8_t creator, uint8_t pool);
+void    openqueue_free_entry(uint8_t i);
+uint8_t openqueue_txBucket(open_addr_t* nextHop);
+void    openqueue_txLink(uint8_t i, bool atHead);
+void    openqueue_txUnlink(uint8_t i);
 
 //=========================== public ==========================================
 
@@ -22,9 +27,45 @@ void openqueue_reset_entry(OpenQueueEntry_t* entry);
 */
 void openqueue_init() {
    uint8_t i;
+   
+   memset(&openqueue_vars.stats[0],0,sizeof(openqueue_vars.stats));
+   
+   // the first QUEUELENGTH_LARGE entries use full-size frame buffers, the
+   // next QUEUELENGTH_SMALL small ones, the others datagram buffers
    for (i=0;i<QUEUELENGTH;i++){
+      if (i<QUEUELENGTH_LARGE) {
+         openqueue_vars.queue[i].packet     = openqueue_vars.largeBuffers[i];
+         openqueue_vars.queue[i].packetSize = LENGTH_PACKET;
+      } else if (i<QUEUELENGTH_LARGE+QUEUELENGTH_SMALL) {
+         openqueue_vars.queue[i].packet     = openqueue_vars.smallBuffers[i-QUEUELENGTH_LARGE];
+         openqueue_vars.queue[i].packetSize = OPENQUEUE_SMALL_BUFFER_SIZE;
+      } else {
+#if QUEUELENGTH_DATAGRAM>0
+         openqueue_vars.queue[i].packet     = openqueue_vars.datagramBuffers[i-QUEUELENGTH_LARGE-QUEUELENGTH_SMALL];
+         openqueue_vars.queue[i].packetSize = OPENQUEUE_DATAGRAM_BUFFER_SIZE;
+#endif
+      }
       openqueue_reset_entry(&(openqueue_vars.queue[i]));
+      // chain all entries of a pool into its free list
+      if (
+            i+1==QUEUELENGTH_LARGE                   ||
+            i+1==QUEUELENGTH_LARGE+QUEUELENGTH_SMALL ||
+            i+1==QUEUELENGTH
+         ) {
+         openqueue_vars.next[i]  = OPENQUEUE_NONE;
+      } else {
+         openqueue_vars.next[i]  = i+1;
+      }
+      openqueue_vars.txBucket[i] = OPENQUEUE_NONE;
    }
+   openqueue_vars.freeHead[OPENQUEUE_POOL_LARGE] = (QUEUELENGTH_LARGE>0)?0:OPENQUEUE_NONE;
+   openqueue_vars.freeHead[OPENQUEUE_POOL_SMALL] = (QUEUELENGTH_SMALL>0)?QUEUELENGTH_LARGE:OPENQUEUE_NONE;
+   openqueue_vars.freeHead[OPENQUEUE_POOL_DATAGRAM] = (QUEUELENGTH_DATAGRAM>0)?QUEUELENGTH_LARGE+QUEUELENGTH_SMALL:OPENQUEUE_NONE;
+   for (i=0;i<OPENQUEUE_TX_BUCKETS;i++){
+      openqueue_vars.txHead[i]   = OPENQUEUE_NONE;
+      openqueue_vars.txTail[i]   = OPENQUEUE_NONE;
+   }
+   openqueue_vars.txAnycastStart = 0;
 }
 
 /**
@@ -36,14 +77,18 @@ status information about several modules in the OpenWSN stack.
 \returns TRUE if this function printed something, FALSE otherwise.
 */
 bool debugPrint_queue() {
-   debugOpenQueueEntry_t output[QUEUELENGTH];
+   struct {
+      debugOpenQueueEntry_t entries[QUEUELENGTH];
+      debugOpenQueuePool_t  pools[OPENQUEUE_POOL_MAX];
+   } output;
    uint8_t i;
    for (i=0;i<QUEUELENGTH;i++) {
-      output[i].creator = openqueue_vars.queue[i].creator;
-      output[i].owner   = openqueue_vars.queue[i].owner;
+      output.entries[i].creator = openqueue_vars.queue[i].creator;
+      output.entries[i].owner   = openqueue_vars.queue[i].owner;
    }
-   openserial_printStatus(STATUS_QUEUE,(uint8_t*)&output,QUEUELENGTH*sizeof(debugOpenQueueEntry_t));
-   return TRUE;
+   // occupancy of the large, small and datagram pools follows the entries
+   memcpy(&output.pools[0],&openqueue_vars.stats[0],sizeof(output.pools));
+   return openserial_printStatusOnChange(STATUS_QUEUE,(uint8_t*)&output,sizeof(output));
 }
 
 //======= called by any component
@@ -61,7 +106,7 @@ get a new packet buffer to start creating a new packet.
          it could not be allocated (buffer full or not synchronized).
 */
 OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
-   uint8_t i;
+   OpenQueueEntry_t* pkt;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    
@@ -72,18 +117,93 @@ OpenQueueEntry_t* openqueue_getFreePacketBuffer(uint8_t creator) {
    }
    
    // if you get here, I will try to allocate a buffer for you
+   pkt = openqueue_getFreeEntry(creator,OPENQUEUE_POOL_LARGE);
+   ENABLE_INTERRUPTS(); 
+   return pkt;
+}
+
+/**
+\brief Request a new (free) packet buffer for a short frame.
+
+Same as openqueue_getFreePacketBuffer(), but the frame buffer only holds
+OPENQUEUE_SMALL_BUFFER_SIZE bytes. Use this for frames known to be short,
+such as ACKs and KAs. Falls back to a full-size buffer when no small one is
+available.
+
+\note The payload can not be set to an arbitrary place in packet[]: only
+      prepend headers starting from the initial payload pointer.
+
+\returns A pointer to the queue entry when it could be allocated, or NULL when
+         it could not be allocated (buffer full or not synchronized).
+*/
+OpenQueueEntry_t* openqueue_getFreeSmallPacketBuffer(uint8_t creator) {
+   OpenQueueEntry_t* pkt;
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
    
-   // walk through queue and find free entry
-   for (i=0;i<QUEUELENGTH;i++) {
-      if (openqueue_vars.queue[i].owner==COMPONENT_NULL) {
-         openqueue_vars.queue[i].creator=creator;
-         openqueue_vars.queue[i].owner=COMPONENT_OPENQUEUE;
-         ENABLE_INTERRUPTS(); 
-         return &openqueue_vars.queue[i];
-      }
+   // refuse to allocate if we're not in sync
+   if (ieee154e_isSynch()==FALSE && creator > COMPONENT_IEEE802154E){
+     ENABLE_INTERRUPTS();
+     return NULL;
    }
-   ENABLE_INTERRUPTS();
-   return NULL;
+   
+   pkt = openqueue_getFreeEntry(creator,OPENQUEUE_POOL_SMALL);
+   if (pkt==NULL) {
+      pkt = openqueue_getFreeEntry(creator,OPENQUEUE_POOL_LARGE);
+   }
+   ENABLE_INTERRUPTS(); 
+   return pkt;
+}
+
+/**
+\brief Request a new (free) packet buffer for a datagram.
+
+Same as openqueue_getFreePacketBuffer(), but the buffer holds
+OPENQUEUE_DATAGRAM_BUFFER_SIZE bytes, for 6LoWPAN datagrams which do not fit
+in a single frame. Such a datagram is fragmented before being handed to the
+MAC. There is no fallback to a full-size buffer.
+
+\returns A pointer to the queue entry when it could be allocated, or NULL when
+         it could not be allocated (buffer full or not synchronized).
+*/
+OpenQueueEntry_t* openqueue_getFreeDatagramBuffer(uint8_t creator) {
+   OpenQueueEntry_t* pkt;
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   
+   // refuse to allocate if we're not in sync
+   if (ieee154e_isSynch()==FALSE && creator > COMPONENT_IEEE802154E){
+     ENABLE_INTERRUPTS();
+     return NULL;
+   }
+   
+   pkt = openqueue_getFreeEntry(creator,OPENQUEUE_POOL_DATAGRAM);
+   ENABLE_INTERRUPTS(); 
+   return pkt;
+}
+
+/**
+\brief Request a new (free) packet buffer, large enough for some content.
+
+For upper layers building a datagram which may not fit in a single frame.
+Content longer than OPENQUEUE_FRAME_CONTENT_MAX bytes gets a datagram buffer,
+and is fragmented on its way down. Without datagram buffers (see
+QUEUELENGTH_DATAGRAM), this is the same as openqueue_getFreePacketBuffer().
+
+\param creator The identifier of the component, taken in COMPONENT_*.
+\param length  The number of bytes the caller writes: its transport header and
+   payload.
+
+\returns A pointer to the queue entry when it could be allocated, or NULL when
+         it could not be allocated (buffer full or not synchronized).
+*/
+OpenQueueEntry_t* openqueue_getFreePacketBufferForLength(uint8_t creator, uint8_t length) {
+#if QUEUELENGTH_DATAGRAM>0
+   if (length>OPENQUEUE_FRAME_CONTENT_MAX) {
+      return openqueue_getFreeDatagramBuffer(creator);
+   }
+#endif
+   return openqueue_getFreePacketBuffer(creator);
 }
 
 
@@ -99,7 +219,12 @@ owerror_t openqueue_freePacketBuffer(OpenQueueEntry_t* pkt) {
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
-   for (i=0;i<QUEUELENGTH;i++) {
+   // the index of the entry follows from its address
+   if (
+         pkt>=&openqueue_vars.queue[0]          &&
+         pkt< &openqueue_vars.queue[QUEUELENGTH]
+      ) {
+      i = (uint8_t)(pkt-&openqueue_vars.queue[0]);
       if (&openqueue_vars.queue[i]==pkt) {
          if (openqueue_vars.queue[i].owner==COMPONENT_NULL) {
             // log the error
@@ -107,7 +232,7 @@ owerror_t openqueue_freePacketBuffer(OpenQueueEntry_t* pkt) {
                                   (errorparameter_t)0,
                                   (errorparameter_t)0);
          }
-         openqueue_reset_entry(&(openqueue_vars.queue[i]));
+         openqueue_free_entry(i);
          ENABLE_INTERRUPTS();
          return E_SUCCESS;
       }
@@ -131,7 +256,7 @@ void openqueue_removeAllCreatedBy(uint8_t creator) {
    DISABLE_INTERRUPTS();
    for (i=0;i<QUEUELENGTH;i++){
       if (openqueue_vars.queue[i].creator==creator) {
-         openqueue_reset_entry(&(openqueue_vars.queue[i]));
+         openqueue_free_entry(i);
       }
    }
    ENABLE_INTERRUPTS();
@@ -148,7 +273,7 @@ void openqueue_removeAllOwnedBy(uint8_t owner) {
    DISABLE_INTERRUPTS();
    for (i=0;i<QUEUELENGTH;i++){
       if (openqueue_vars.queue[i].owner==owner) {
-         openqueue_reset_entry(&(openqueue_vars.queue[i]));
+         openqueue_free_entry(i);
       }
    }
    ENABLE_INTERRUPTS();
@@ -186,35 +311,71 @@ OpenQueueEntry_t* openqueue_sixtopGetReceivedPacket() {
    return NULL;
 }
 
+/**
+\brief Hand a packet over to the MAC.
+
+The packet is assigned to the virtual component COMPONENT_SIXTOP_TO_IEEE802154E
+and appended to the list of packets waiting for its next hop.
+
+\param pkt A pointer to the packet, its l2_nextORpreviousHop must be set.
+*/
+void openqueue_sixtopPutDataPacket(OpenQueueEntry_t* pkt) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   pkt->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+   openqueue_txLink((uint8_t)(pkt-&openqueue_vars.queue[0]),FALSE);
+   ENABLE_INTERRUPTS();
+}
+
 //======= called by IEEE80215E
 
+/**
+\brief Take the next packet to send to a neighbor out of the queue.
+
+Only the list of packets for that neighbor is looked at, so the cost does not
+depend on QUEUELENGTH. The returned packet is removed from that list; the MAC
+either sends it or puts it back with openqueue_macPutBackDataPacket().
+
+\param toNeighbor The 64-bit address of the neighbor, or an ADDR_ANYCAST
+   address to get any packet but EBs.
+
+\returns A pointer to the packet, or NULL if there is none.
+*/
 OpenQueueEntry_t* openqueue_macGetDataPacket(open_addr_t* toNeighbor) {
+   uint8_t bucket;
+   uint8_t n;
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
    if (toNeighbor->type==ADDR_64B) {
       // a neighbor is specified, look for a packet unicast to that neigbhbor
-      for (i=0;i<QUEUELENGTH;i++) {
-         if (openqueue_vars.queue[i].owner==COMPONENT_SIXTOP_TO_IEEE802154E &&
-            packetfunctions_sameAddress(toNeighbor,&openqueue_vars.queue[i].l2_nextORpreviousHop)) {
+      i = openqueue_vars.txHead[openqueue_txBucket(toNeighbor)];
+      while (i!=OPENQUEUE_NONE) {
+         if (packetfunctions_sameAddress(toNeighbor,&openqueue_vars.queue[i].l2_nextORpreviousHop)) {
+            openqueue_txUnlink(i);
             ENABLE_INTERRUPTS();
             return &openqueue_vars.queue[i];
          }
+         i = openqueue_vars.next[i];
       }
    } else if (toNeighbor->type==ADDR_ANYCAST) {
       // anycast case: look for a packet which is either not created by RES
       // or an KA (created by RES, but not broadcast)
-      for (i=0;i<QUEUELENGTH;i++) {
-         if (openqueue_vars.queue[i].owner==COMPONENT_SIXTOP_TO_IEEE802154E &&
-             ( openqueue_vars.queue[i].creator!=COMPONENT_SIXTOP ||
-                (
-                   openqueue_vars.queue[i].creator==COMPONENT_SIXTOP &&
-                   packetfunctions_isBroadcastMulticast(&(openqueue_vars.queue[i].l2_nextORpreviousHop))==FALSE
-                )
-             )
-            ) {
-            ENABLE_INTERRUPTS();
-            return &openqueue_vars.queue[i];
+      for (n=0;n<OPENQUEUE_TX_BUCKETS;n++) {
+         // start from a different list each time, for fairness
+         bucket = (openqueue_vars.txAnycastStart+n)%OPENQUEUE_TX_BUCKETS;
+         i = openqueue_vars.txHead[bucket];
+         while (i!=OPENQUEUE_NONE) {
+            if (
+                  openqueue_vars.queue[i].creator!=COMPONENT_SIXTOP ||
+                  packetfunctions_isBroadcastMulticast(&(openqueue_vars.queue[i].l2_nextORpreviousHop))==FALSE
+               ) {
+               openqueue_txUnlink(i);
+               openqueue_vars.txAnycastStart = (bucket+1)%OPENQUEUE_TX_BUCKETS;
+               ENABLE_INTERRUPTS();
+               return &openqueue_vars.queue[i];
+            }
+            i = openqueue_vars.next[i];
          }
       }
    }
@@ -222,29 +383,54 @@ OpenQueueEntry_t* openqueue_macGetDataPacket(open_addr_t* toNeighbor) {
    return NULL;
 }
 
+/**
+\brief Take the next Enhanced Beacon out of the queue.
+
+\returns A pointer to the EB, or NULL if there is none.
+*/
 OpenQueueEntry_t* openqueue_macGetEBPacket() {
    uint8_t i;
    INTERRUPT_DECLARATION();
    DISABLE_INTERRUPTS();
-   for (i=0;i<QUEUELENGTH;i++) {
-      if (openqueue_vars.queue[i].owner==COMPONENT_SIXTOP_TO_IEEE802154E &&
-          openqueue_vars.queue[i].creator==COMPONENT_SIXTOP              &&
+   // EBs are broadcast, so they all sit in list 0
+   i = openqueue_vars.txHead[0];
+   while (i!=OPENQUEUE_NONE) {
+      if (openqueue_vars.queue[i].creator==COMPONENT_SIXTOP              &&
           packetfunctions_isBroadcastMulticast(&(openqueue_vars.queue[i].l2_nextORpreviousHop))) {
+         openqueue_txUnlink(i);
          ENABLE_INTERRUPTS();
          return &openqueue_vars.queue[i];
       }
+      i = openqueue_vars.next[i];
    }
    ENABLE_INTERRUPTS();
    return NULL;
 }
 
+/**
+\brief Give a packet which could not be sent back to the queue.
+
+The packet is put at the head of the list of packets for its next hop, so it
+is the next one picked for that neighbor.
+
+\param pkt A pointer to the packet, as returned by openqueue_macGetDataPacket()
+   or openqueue_macGetEBPacket().
+*/
+void openqueue_macPutBackDataPacket(OpenQueueEntry_t* pkt) {
+   INTERRUPT_DECLARATION();
+   DISABLE_INTERRUPTS();
+   pkt->owner = COMPONENT_SIXTOP_TO_IEEE802154E;
+   openqueue_txLink((uint8_t)(pkt-&openqueue_vars.queue[0]),TRUE);
+   ENABLE_INTERRUPTS();
+}
+
 //=========================== private =========================================
 
 void openqueue_reset_entry(OpenQueueEntry_t* entry) {
    //admin
    entry->creator                      = COMPONENT_NULL;
    entry->owner                        = COMPONENT_NULL;
-   entry->payload                      = &(entry->packet[127 - IEEE802154_SECURITY_TAG_LEN]); // Footer is longer if security is used
+   entry->payload                      = &(entry->packet[entry->packetSize-3-IEEE802154_SECURITY_TAG_LEN]); // Footer is longer if security is used
    entry->length                       = 0;
    //l4
    entry->l4_protocol                  = IANA_UNDEFINED;
@@ -260,3 +446,124 @@ void openqueue_reset_entry(OpenQueueEntry_t* entry) {
    //l2-security
    entry->l2_securityLevel             = 0;
 }
+
+/**
+\brief Take the first entry of a pool's free list.
+
+\note Interrupts must be disabled when calling this function.
+*/
+OpenQueueEntry_t* openqueue_getFreeEntry(uint8_t creator, uint8_t pool) {
+   uint8_t i;
+   
+   i = openqueue_vars.freeHead[pool];
+   if (i==OPENQUEUE_NONE) {
+      openqueue_vars.stats[pool].numFailed++;
+      return NULL;
+   }
+   openqueue_vars.freeHead[pool]  = openqueue_vars.next[i];
+   openqueue_vars.next[i]         = OPENQUEUE_NONE;
+   openqueue_vars.queue[i].creator=creator;
+   openqueue_vars.queue[i].owner=COMPONENT_OPENQUEUE;
+   // maintain statistics
+   openqueue_vars.stats[pool].numUsed++;
+   if (openqueue_vars.stats[pool].numUsed>openqueue_vars.stats[pool].maxUsed) {
+      openqueue_vars.stats[pool].maxUsed = openqueue_vars.stats[pool].numUsed;
+   }
+   return &openqueue_vars.queue[i];
+}
+
+/**
+\brief Reset an entry and return it to the free list of its pool.
+
+\note Interrupts must be disabled when calling this function.
+*/
+void openqueue_free_entry(uint8_t i) {
+   uint8_t pool;
+   
+   if (openqueue_vars.txBucket[i]!=OPENQUEUE_NONE) {
+      openqueue_txUnlink(i);
+   }
+   if (openqueue_vars.queue[i].owner!=COMPONENT_NULL) {
+      // not in the free list yet
+      if (i<QUEUELENGTH_LARGE) {
+         pool = OPENQUEUE_POOL_LARGE;
+      } else if (i<QUEUELENGTH_LARGE+QUEUELENGTH_SMALL) {
+         pool = OPENQUEUE_POOL_SMALL;
+      } else {
+         pool = OPENQUEUE_POOL_DATAGRAM;
+      }
+      openqueue_vars.next[i]        = openqueue_vars.freeHead[pool];
+      openqueue_vars.freeHead[pool] = i;
+      openqueue_vars.stats[pool].numUsed--;
+   }
+   openqueue_reset_entry(&(openqueue_vars.queue[i]));
+}
+
+/**
+\brief Index of the TX list for a given next hop.
+*/
+uint8_t openqueue_txBucket(open_addr_t* nextHop) {
+   if (nextHop->type!=ADDR_64B) {
+      return 0;
+   }
+   return 1+(nextHop->addr_64b[7]%(OPENQUEUE_TX_BUCKETS-1));
+}
+
+/**
+\brief Add an entry to the TX list of its next hop.
+
+\note Interrupts must be disabled when calling this function.
+*/
+void openqueue_txLink(uint8_t i, bool atHead) {
+   uint8_t bucket;
+   
+   if (openqueue_vars.txBucket[i]!=OPENQUEUE_NONE) {
+      // already in a list
+      return;
+   }
+   bucket                            = openqueue_txBucket(&openqueue_vars.queue[i].l2_nextORpreviousHop);
+   openqueue_vars.txBucket[i]        = bucket;
+   if (openqueue_vars.txHead[bucket]==OPENQUEUE_NONE) {
+      openqueue_vars.next[i]         = OPENQUEUE_NONE;
+      openqueue_vars.txHead[bucket]  = i;
+      openqueue_vars.txTail[bucket]  = i;
+   } else if (atHead) {
+      openqueue_vars.next[i]         = openqueue_vars.txHead[bucket];
+      openqueue_vars.txHead[bucket]  = i;
+   } else {
+      openqueue_vars.next[i]         = OPENQUEUE_NONE;
+      openqueue_vars.next[openqueue_vars.txTail[bucket]] = i;
+      openqueue_vars.txTail[bucket]  = i;
+   }
+}
+
+/**
+\brief Remove an entry from the TX list it is in.
+
+\note Interrupts must be disabled when calling this function.
+*/
+void openqueue_txUnlink(uint8_t i) {
+   uint8_t bucket;
+   uint8_t prev;
+   uint8_t j;
+   
+   bucket = openqueue_vars.txBucket[i];
+   prev   = OPENQUEUE_NONE;
+   j      = openqueue_vars.txHead[bucket];
+   while (j!=OPENQUEUE_NONE && j!=i) {
+      prev = j;
+      j    = openqueue_vars.next[j];
+   }
+   if (j==i) {
+      if (prev==OPENQUEUE_NONE) {
+         openqueue_vars.txHead[bucket] = openqueue_vars.next[i];
+      } else {
+         openqueue_vars.next[prev]     = openqueue_vars.next[i];
+      }
+      if (openqueue_vars.txTail[bucket]==i) {
+         openqueue_vars.txTail[bucket] = prev;
+      }
+   }
+   openqueue_vars.next[i]     = OPENQUEUE_NONE;
+   openqueue_vars.txBucket[i] = OPENQUEUE_NONE;
+}
@@ -13,7 +13,66 @@
 
 //=========================== define ==========================================
 
-#define QUEUELENGTH  10
+// number of entries with a full-size (LENGTH_PACKET) frame buffer
+//
+// With the defaults, the large and small pools have as many entries as the
+// former 10-entry queue, with 972B of frame buffers (1036B with L2 security)
+// instead of 1300B. Each entry costs 5B more bookkeeping (buffer pointer and
+// size, free and TX lists), about 280B (210B with L2 security) are saved.
+#ifndef QUEUELENGTH_LARGE
+#define QUEUELENGTH_LARGE  6
+#endif
+
+// number of entries with a small frame buffer, for ACKs and KAs
+#ifndef QUEUELENGTH_SMALL
+#define QUEUELENGTH_SMALL  4
+#endif
+
+// number of entries with a datagram buffer, for 6LoWPAN datagrams which do
+// not fit in a single frame, set by the "datagrams" build option. Without
+// them, datagrams larger than a frame can only be relayed fragment by
+// fragment.
+#ifndef QUEUELENGTH_DATAGRAM
+#define QUEUELENGTH_DATAGRAM  0
+#endif
+
+#define QUEUELENGTH        (QUEUELENGTH_LARGE+QUEUELENGTH_SMALL+QUEUELENGTH_DATAGRAM)
+
+// size of a small frame buffer, room for an ACK or a KA with its security
+// header and MIC
+#ifndef OPENQUEUE_SMALL_BUFFER_SIZE
+#ifdef L2_SECURITY_ACTIVE
+#define OPENQUEUE_SMALL_BUFFER_SIZE  64
+#else
+#define OPENQUEUE_SMALL_BUFFER_SIZE  48
+#endif
+#endif
+
+// size of a datagram buffer, the largest packetSize
+#ifndef OPENQUEUE_DATAGRAM_BUFFER_SIZE
+#define OPENQUEUE_DATAGRAM_BUFFER_SIZE  255
+#endif
+
+// upper-layer bytes (transport header and payload) which always fit in a
+// full-size frame buffer, next to the IPv6 and 6LoWPAN headers; see
+// openqueue_getFreePacketBufferForLength()
+#ifndef OPENQUEUE_FRAME_CONTENT_MAX
+#define OPENQUEUE_FRAME_CONTENT_MAX     64
+#endif
+
+enum {
+   OPENQUEUE_POOL_LARGE    = 0,
+   OPENQUEUE_POOL_SMALL    = 1,
+   OPENQUEUE_POOL_DATAGRAM = 2,
+   OPENQUEUE_POOL_MAX      = 3,
+};
+
+// number of per-neighbor lists of packets waiting for the MAC; list 0 holds
+// broadcast and 16-bit addressed packets, the others are indexed by a hash of
+// the 64-bit next hop address.
+#define OPENQUEUE_TX_BUCKETS     8
+
+#define OPENQUEUE_NONE           0xff // end of list / entry not in any list
 
 //=========================== typedef =========================================
 
@@ -22,10 +81,28 @@ typedef struct {
    uint8_t  owner;
 } debugOpenQueueEntry_t;
 
+typedef struct {
+   uint8_t  numUsed;      // entries currently allocated
+   uint8_t  maxUsed;      // high-water mark of numUsed
+   uint8_t  numFailed;    // allocations which failed, pool exhausted
+} debugOpenQueuePool_t;
+
 //=========================== module variables ================================
 
 typedef struct {
    OpenQueueEntry_t queue[QUEUELENGTH];
+   uint8_t          largeBuffers[QUEUELENGTH_LARGE][LENGTH_PACKET];
+   uint8_t          smallBuffers[QUEUELENGTH_SMALL][OPENQUEUE_SMALL_BUFFER_SIZE];
+#if QUEUELENGTH_DATAGRAM>0
+   uint8_t          datagramBuffers[QUEUELENGTH_DATAGRAM][OPENQUEUE_DATAGRAM_BUFFER_SIZE];
+#endif
+   uint8_t          next[QUEUELENGTH];                // next entry in free list or TX list
+   uint8_t          txBucket[QUEUELENGTH];            // TX list the entry is in, if any
+   uint8_t          freeHead[OPENQUEUE_POOL_MAX];     // first free entry, per pool
+   debugOpenQueuePool_t stats[OPENQUEUE_POOL_MAX];
+   uint8_t          txHead[OPENQUEUE_TX_BUCKETS];     // first entry for the MAC, per list
+   uint8_t          txTail[OPENQUEUE_TX_BUCKETS];     // last entry for the MAC, per list
+   uint8_t          txAnycastStart;                   // list to start an anycast lookup from
 } openqueue_vars_t;
 
 //=========================== prototypes ======================================
@@ -35,15 +112,20 @@ void               openqueue_init(void);
 bool               debugPrint_queue(void);
 // called by any component
 OpenQueueEntry_t*  openqueue_getFreePacketBuffer(uint8_t creator);
+OpenQueueEntry_t*  openqueue_getFreeSmallPacketBuffer(uint8_t creator);
+OpenQueueEntry_t*  openqueue_getFreeDatagramBuffer(uint8_t creator);
+OpenQueueEntry_t*  openqueue_getFreePacketBufferForLength(uint8_t creator, uint8_t length);
 owerror_t         openqueue_freePacketBuffer(OpenQueueEntry_t* pkt);
 void               openqueue_removeAllCreatedBy(uint8_t creator);
 void               openqueue_removeAllOwnedBy(uint8_t owner);
 // called by res
 OpenQueueEntry_t*  openqueue_sixtopGetSentPacket(void);
 OpenQueueEntry_t*  openqueue_sixtopGetReceivedPacket(void);
+void               openqueue_sixtopPutDataPacket(OpenQueueEntry_t* pkt);
 // called by IEEE80215E
 OpenQueueEntry_t*  openqueue_macGetDataPacket(open_addr_t* toNeighbor);
 OpenQueueEntry_t*  openqueue_macGetEBPacket(void);
+void               openqueue_macPutBackDataPacket(OpenQueueEntry_t* pkt);
 
 /**
 \}
@@ -1,12 +1,16 @@
+#include "opendefs.h"
 #include "packetfunctions.h"
 #include "openserial.h"
 #include "idmanager.h"
 
 //=========================== variables =======================================
 
+packetfunctions_vars_t packetfunctions_vars;
+
 //=========================== prototypes ======================================
 
-void onesComplementSum(uint8_t* global_sum, uint8_t* ptr, int length);
+uint32_t onesComplementSum(uint32_t sum, uint8_t* ptr, uint16_t length);
+uint16_t onesComplementFold(uint32_t sum);
 
 //=========================== public ==========================================
 
@@ -278,7 +282,7 @@ void packetfunctions_reserveHeaderSize(OpenQueueEntry_t* pkt, uint8_t header_len
 void packetfunctions_tossHeader(OpenQueueEntry_t* pkt, uint8_t header_length) {
    pkt->payload += header_length;
    pkt->length  -= header_length;
-   if ( (uint8_t*)(pkt->payload) > (uint8_t*)(pkt->packet+126) ) {
+   if ( (uint8_t*)(pkt->payload) > (uint8_t*)(pkt->packet+pkt->packetSize-4) ) {
       openserial_printError(COMPONENT_PACKETFUNCTIONS,ERR_HEADER_TOO_LONG,
                             (errorparameter_t)1,
                             (errorparameter_t)pkt->length);
@@ -287,7 +291,7 @@ void packetfunctions_tossHeader(OpenQueueEntry_t* pkt, uint8_t header_length) {
 
 void packetfunctions_reserveFooterSize(OpenQueueEntry_t* pkt, uint8_t header_length) {
    pkt->length  += header_length;
-   if (pkt->length>127) {
+   if ((uint8_t*)(pkt->payload+pkt->length) > (uint8_t*)(pkt->packet+pkt->packetSize)) {
       openserial_printError(COMPONENT_PACKETFUNCTIONS,ERR_HEADER_TOO_LONG,
                             (errorparameter_t)2,
                             (errorparameter_t)pkt->length);
@@ -306,13 +310,35 @@ void packetfunctions_tossFooter(OpenQueueEntry_t* pkt, uint8_t header_length) {
 //======= packet duplication
 // function duplicates a frame from one OpenQueueEntry structure to the other,
 // updating pointers to the new memory location. Used to make a local copy of
-// the frame before transmission (where it can possibly be encrypted). 
-void packetfunctions_duplicatePacket(OpenQueueEntry_t* dst, OpenQueueEntry_t* src) {
-   // make a copy of the frame
+// the frame before transmission (where it can possibly be encrypted). Fails,
+// leaving dst untouched, if the frame and the room after it do not fit in the
+// frame buffer of dst.
+owerror_t packetfunctions_duplicatePacket(OpenQueueEntry_t* dst, OpenQueueEntry_t* src) {
+   uint8_t* dstPacket;
+   uint8_t  dstPacketSize;
+   uint8_t  tail;
+   
+   // bytes from the start of the frame to the end of the source buffer
+   tail = src->packetSize-(uint8_t)(src->payload-src->packet);
+   if (tail>dst->packetSize) {
+      return E_FAIL;
+   }
+   
+   // the destination keeps its own frame buffer
+   dstPacket     = dst->packet;
+   dstPacketSize = dst->packetSize;
+   
+   // make a copy of the metadata
    memcpy(dst, src, sizeof(OpenQueueEntry_t));
+   dst->packet     = dstPacket;
+   dst->packetSize = dstPacketSize;
+
+   // Calculate where payload starts in the buffer, as far from its end as in
+   // the source buffer, so the same room is left for footers
+   dst->payload = &dst->packet[dst->packetSize-tail]; // update pointers
 
-   // Calculate where payload starts in the buffer
-   dst->payload = &dst->packet[src->payload - src->packet]; // update pointers
+   // copy the frame only
+   memcpy(dst->payload, src->payload, src->length);
 
    // update l2_FrameCounter pointer
    dst->l2_FrameCounter = dst->payload + (src->l2_FrameCounter - src->payload);
@@ -328,6 +354,8 @@ void packetfunctions_duplicatePacket(OpenQueueEntry_t* dst, OpenQueueEntry_t* sr
 
    // update l4_payload pointer
    dst->l4_payload = dst->payload + (src->l4_payload - src->payload);
+   
+   return E_SUCCESS;
 }
 
 //======= CRC calculation
@@ -381,31 +409,26 @@ bool packetfunctions_checkCRC(OpenQueueEntry_t* msg) {
 //see http://www-net.cs.umass.edu/kurose/transport/UDP.html, or http://tools.ietf.org/html/rfc1071
 //see http://en.wikipedia.org/wiki/User_Datagram_Protocol#IPv6_PSEUDO-HEADER
 void packetfunctions_calculateChecksum(OpenQueueEntry_t* msg, uint8_t* checksum_ptr) {
-   uint8_t temp_checksum[2];
-   uint8_t little_helper[2];
-   
-   // initialize running checksum
-   temp_checksum[0]  = 0;
-   temp_checksum[1]  = 0;
+   uint32_t sum;
+   uint16_t checksum;
    
    //===== IPv6 pseudo header
    
-   // source address (prefix and EUI64)
-   onesComplementSum(temp_checksum,(idmanager_getMyID(ADDR_PREFIX))->prefix,8);
-   onesComplementSum(temp_checksum,(idmanager_getMyID(ADDR_64B))->addr_64b,8);
+   // source address (prefix and EUI64), only summed again when it changes
+   if (packetfunctions_vars.sourceSumValid==FALSE) {
+      sum = onesComplementSum(0,(idmanager_getMyID(ADDR_PREFIX))->prefix,8);
+      sum = onesComplementSum(sum,(idmanager_getMyID(ADDR_64B))->addr_64b,8);
+      packetfunctions_vars.sourceSum      = onesComplementFold(sum);
+      packetfunctions_vars.sourceSumValid = TRUE;
+   }
+   sum  = packetfunctions_vars.sourceSum;
    
    // destination address
-   onesComplementSum(temp_checksum,msg->l3_destinationAdd.addr_128b,16);
+   sum  = onesComplementSum(sum,msg->l3_destinationAdd.addr_128b,16);
    
-   // length
-   little_helper[0] = 0;
-   little_helper[1] = msg->length;
-   onesComplementSum(temp_checksum,little_helper,2);
-   
-   // next header
-   little_helper[0] = 0;
-   little_helper[1] = msg->l4_protocol;
-   onesComplementSum(temp_checksum,little_helper,2);
+   // length and next header, each in the low byte of a 16-bit word
+   sum += msg->length;
+   sum += msg->l4_protocol;
    
    //===== payload
    
@@ -413,31 +436,88 @@ void packetfunctions_calculateChecksum(OpenQueueEntry_t* msg, uint8_t* checksum_
    *checksum_ptr     = 0;
    *(checksum_ptr+1) = 0;
    
-   onesComplementSum(temp_checksum,msg->payload,msg->length);
-   temp_checksum[0] ^= 0xFF;
-   temp_checksum[1] ^= 0xFF;
+   sum      = onesComplementSum(sum,msg->payload,msg->length);
+   checksum = ~onesComplementFold(sum);
    
    //write in packet
-   *checksum_ptr     = temp_checksum[0];
-   *(checksum_ptr+1) = temp_checksum[1];
+   *checksum_ptr     = (checksum>>8) & 0xFF;
+   *(checksum_ptr+1) = checksum & 0xFF;
 }
 
+/**
+\brief Update a checksum after a 16-bit word it covers changed.
+
+Implements eqn. 3 of RFC 1624, HC' = ~(~HC + ~m + m'), so forwarded or
+rewritten packets need not be summed again.
 
-void onesComplementSum(uint8_t* global_sum, uint8_t* ptr, int length) {
-   uint32_t sum = 0xFFFF & (global_sum[0]<<8 | global_sum[1]);
+\param checksum_ptr Where the checksum is in the packet, in network order.
+\param oldValue     The word before the change.
+\param newValue     The word after the change.
+*/
+void packetfunctions_updateChecksum(uint8_t* checksum_ptr, uint16_t oldValue, uint16_t newValue) {
+   uint32_t sum;
+   uint16_t checksum;
+   
+   checksum = ((uint16_t)checksum_ptr[0]<<8) | checksum_ptr[1];
+   sum      = (uint16_t)~checksum;
+   sum     += (uint16_t)~oldValue;
+   sum     += newValue;
+   checksum = ~onesComplementFold(sum);
+   
+   checksum_ptr[0] = (checksum>>8) & 0xFF;
+   checksum_ptr[1] = checksum & 0xFF;
+}
+
+/**
+\brief Forget the pseudo-header sum of my own address.
+
+Called whenever my prefix or EUI64 changes.
+*/
+void packetfunctions_invalidateChecksumCache() {
+   packetfunctions_vars.sourceSumValid = FALSE;
+}
+
+/**
+\brief Add bytes to a ones' complement sum, as 16-bit big endian words.
+
+The sum is kept in 32 bits and only folded by onesComplementFold(), so no
+carry is handled in the loop; 8 bytes are summed per iteration.
+
+\param sum    The running sum, not folded.
+\param ptr    The bytes to add. Must start at an even offset of the data being
+   checksummed.
+\param length The number of bytes to add, an odd last byte is padded with 0.
+
+\returns The new running sum, not folded.
+*/
+uint32_t onesComplementSum(uint32_t sum, uint8_t* ptr, uint16_t length) {
+   while (length>=8) {
+      sum     += ((uint16_t)ptr[0]<<8) | ptr[1];
+      sum     += ((uint16_t)ptr[2]<<8) | ptr[3];
+      sum     += ((uint16_t)ptr[4]<<8) | ptr[5];
+      sum     += ((uint16_t)ptr[6]<<8) | ptr[7];
+      ptr     += 8;
+      length  -= 8;
+   }
    while (length>1) {
-      sum     += 0xFFFF & (*ptr<<8 | *(ptr+1));
+      sum     += ((uint16_t)ptr[0]<<8) | ptr[1];
       ptr     += 2;
       length  -= 2;
    }
    if (length) {
-      sum     += (0xFF & *ptr)<<8;
+      sum     += (uint16_t)ptr[0]<<8;
    }
+   return sum;
+}
+
+/**
+\brief Fold the carries of a 32-bit ones' complement sum into 16 bits.
+*/
+uint16_t onesComplementFold(uint32_t sum) {
    while (sum>>16) {
       sum      = (sum & 0xFFFF)+(sum >> 16);
    }
-   global_sum[0] = (sum>>8) & 0xFF;
-   global_sum[1] = sum & 0xFF;
+   return (uint16_t)sum;
 }
 
 //======= endianness
@@ -16,6 +16,11 @@
 
 //=========================== variables =======================================
 
+typedef struct {
+   bool                 sourceSumValid;      // sourceSum matches my current address
+   uint16_t             sourceSum;           // pseudo-header sum of my prefix and EUI64
+} packetfunctions_vars_t;
+
 //=========================== prototypes ======================================
 
 // address translation
@@ -41,7 +46,7 @@ void     packetfunctions_reserveFooterSize(OpenQueueEntry_t* pkt, uint8_t header
 void     packetfunctions_tossFooter(OpenQueueEntry_t* pkt, uint8_t header_length);
 
 // packet duplication
-void packetfunctions_duplicatePacket(OpenQueueEntry_t* dst, OpenQueueEntry_t* src);
+owerror_t packetfunctions_duplicatePacket(OpenQueueEntry_t* dst, OpenQueueEntry_t* src);
 
 // calculate CRC
 void     packetfunctions_calculateCRC(OpenQueueEntry_t* msg);
@@ -49,6 +54,8 @@ bool     packetfunctions_checkCRC(OpenQueueEntry_t* msg);
 
 // calculate checksum
 void     packetfunctions_calculateChecksum(OpenQueueEntry_t* msg, uint8_t* checksum_ptr);
+void     packetfunctions_updateChecksum(uint8_t* checksum_ptr, uint16_t oldValue, uint16_t newValue);
+void     packetfunctions_invalidateChecksumCache(void);
 
 // endianness
 void     packetfunctions_htons( uint16_t val, uint8_t* dest );
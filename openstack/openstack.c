@@ -25,11 +25,13 @@
 //-- 03a-IPHC
 #include "openbridge.h"
 #include "iphc.h"
+#include "frag.h"
 //-- 03b-IPv6
 #include "forwarding.h"
 #include "icmpv6.h"
 #include "icmpv6echo.h"
 #include "icmpv6rpl.h"
+#include "sourceroute.h"
 //-- 04-TRAN
 #include "opentcp.h"
 #include "openudp.h"
@@ -66,11 +68,13 @@ void openstack_init(void) {
    //-- 03a-IPHC
    openbridge_init();
    iphc_init();
+   frag_init();
    //-- 03b-IPv6
    forwarding_init();
    icmpv6_init();
    icmpv6echo_init();
    icmpv6rpl_init();
+   sourceroute_init();
    //-- 04-TRAN
    opentcp_init();
    openudp_init();
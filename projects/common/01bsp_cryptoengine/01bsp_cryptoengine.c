@@ -13,6 +13,7 @@ tests passed. If there was an error, we use the Error LED to signal.
 
 #include "stdint.h"
 #include "stdio.h"
+#include "string.h"
 // bsp modules required
 #include "board.h"
 #include "crypto_engine.h"
@@ -28,6 +29,8 @@ tests passed. If there was an error, we use the Error LED to signal.
 #define TEST_AES_CBC                   1
 #define TEST_BENCHMARK_CCMS            1
 
+#define BENCHMARK_NUM_ROUNDS           16
+
 typedef struct {
    uint8_t key[16];
    uint8_t buffer[16];
@@ -91,6 +94,24 @@ typedef struct
    uint8_t expected_ciphertext[16];
 } aes_cbc_suite_t;
 
+#if TEST_BENCHMARK_CCMS
+/**
+\brief Duration of the crypto operations, in bsp_timer ticks.
+
+The ECB and CCM* durations are averaged over BENCHMARK_NUM_ROUNDS runs with
+the same key, so they include the effect of caching the expanded key;
+ecb_first is the very first encryption with a new key.
+*/
+typedef struct {
+   PORT_TIMER_WIDTH ecb_first;
+   PORT_TIMER_WIDTH ecb;
+   PORT_TIMER_WIDTH ccms_enc;
+   PORT_TIMER_WIDTH ccms_dec;
+} benchmark_vars_t;
+
+benchmark_vars_t benchmark_vars;
+#endif /* TEST_BENCHMARK_CCMS */
+
 static int hang(uint8_t error_code) {
 
    error_code ? leds_error_on() : leds_radio_on();
@@ -257,6 +278,70 @@ static owerror_t run_aes_cbc_suite(aes_cbc_suite_t* suite, uint8_t test_suite_le
 }
 #endif /* TEST_AES_CBC */
 
+#if TEST_BENCHMARK_CCMS
+
+#define A_LEN 30
+#define M_LEN 91
+#define TAG_LEN 4
+#define L 2
+
+static owerror_t run_benchmark(void) {
+   uint8_t a[A_LEN];
+   uint8_t m[M_LEN + TAG_LEN];
+   uint8_t block[16];
+   uint8_t nonce[] = { 0x00, 0x00, 0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x05 };
+   uint8_t key[16] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+   uint8_t len_m;
+   uint8_t i;
+   PORT_TIMER_WIDTH start;
+   PORT_TIMER_WIDTH enc = 0;
+   PORT_TIMER_WIDTH dec = 0;
+
+   memset(a, 0xfe, A_LEN);
+   memset(m, 0xab, M_LEN);
+   memset(block, 0x00, 16);
+
+   start = bsp_timer_get_currentValue();
+   CRYPTO_ENGINE.aes_ecb_enc(block, key);
+   benchmark_vars.ecb_first = bsp_timer_get_currentValue() - start;
+
+   start = bsp_timer_get_currentValue();
+   for (i = 0; i < BENCHMARK_NUM_ROUNDS; i++) {
+      CRYPTO_ENGINE.aes_ecb_enc(block, key);
+   }
+   benchmark_vars.ecb = (bsp_timer_get_currentValue() - start) / BENCHMARK_NUM_ROUNDS;
+
+   for (i = 0; i < BENCHMARK_NUM_ROUNDS; i++) {
+      len_m = M_LEN;
+
+      start = bsp_timer_get_currentValue();
+      if (CRYPTO_ENGINE.aes_ccms_enc(a, A_LEN, m, &len_m, nonce, L, key, TAG_LEN) != E_SUCCESS) {
+         return E_FAIL;
+      }
+      enc += bsp_timer_get_currentValue() - start;
+
+      start = bsp_timer_get_currentValue();
+      if (CRYPTO_ENGINE.aes_ccms_dec(a, A_LEN, m, &len_m, nonce, L, key, TAG_LEN) != E_SUCCESS) {
+         return E_FAIL;
+      }
+      dec += bsp_timer_get_currentValue() - start;
+   }
+   benchmark_vars.ccms_enc = enc / BENCHMARK_NUM_ROUNDS;
+   benchmark_vars.ccms_dec = dec / BENCHMARK_NUM_ROUNDS;
+
+#ifdef OPENSIM
+   printf("benchmark: ecb first %u, ecb %u, ccms enc %u, ccms dec %u ticks\r\n",
+      (unsigned)benchmark_vars.ecb_first,
+      (unsigned)benchmark_vars.ecb,
+      (unsigned)benchmark_vars.ccms_enc,
+      (unsigned)benchmark_vars.ccms_dec
+   );
+#endif
+
+   return E_SUCCESS;
+}
+#endif /* TEST_BENCHMARK_CCMS */
+
 /**
 \brief The program starts executing here.
 */
@@ -495,64 +580,9 @@ int mote_main(void) {
 #endif /* TEST_AES_CBC */
 
 #if TEST_BENCHMARK_CCMS
-
-#define A_LEN 30
-#define M_LEN 91
-#define TAG_LEN 4
-#define L 2
-
-   uint8_t a[A_LEN];
-   uint8_t m[M_LEN + TAG_LEN];
-   uint8_t nonce[] = { 0x00, 0x00, 0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x05 };
-   uint8_t key[16] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
-   uint8_t len_m = M_LEN;
-   uint8_t ret;
-
-   memset(a, 0xfe, A_LEN);
-   memset(m, 0xab, M_LEN);
-   
-   PORT_TIMER_WIDTH time1 = 0;
-   PORT_TIMER_WIDTH time2 = 0;
-   PORT_TIMER_WIDTH enc = 0;
-   PORT_TIMER_WIDTH dec = 0;
-
-   time1 = bsp_timer_get_currentValue();
-   ret = CRYPTO_ENGINE.aes_ccms_enc(a,
-                                       A_LEN,
-                                       m,
-                                       &len_m,
-                                       nonce,
-                                       L,
-                                       key,
-                                       TAG_LEN);
-   time2 = bsp_timer_get_currentValue();
-
-   if (ret == E_SUCCESS) {
-      enc = time2 - time1;
-   }
-   else {
+   if (run_benchmark() == E_FAIL) {
       fail++;
    }
-
-   time1 = bsp_timer_get_currentValue();
-   ret = CRYPTO_ENGINE.aes_ccms_dec(a,
-                                       A_LEN,
-                                       m,
-                                       &len_m,
-                                       nonce,
-                                       L,
-                                       key,
-                                       TAG_LEN);
-   time2 = bsp_timer_get_currentValue();
-
-   if (ret == E_SUCCESS) {
-      dec = time2 - time1;
-   }
-   else {
-      fail++;
-   }
-
-   time1 = enc + dec; // to avoid compiler warnings
 #endif /* TEST_BENCHMARK_CCMS */
 
    return hang(fail);
@@ -122,6 +122,9 @@ bool debugPrint_asn(void) {
 bool debugPrint_macStats(void) {
    return FALSE;
 }
+bool debugPrint_macProfile(void) {
+   return FALSE;
+}
 bool debugPrint_schedule(void) {
    return FALSE;
 }
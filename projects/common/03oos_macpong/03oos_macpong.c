@@ -111,6 +111,7 @@ void iphc_receive(OpenQueueEntry_t* msg) {
 //===== L3
 
 void forwarding_init(void)        { return; }
+void sourceroute_init(void)       { return; }
 void openbridge_init(void)        { return; }
 void openbridge_triggerData(void) { return; }
 
@@ -129,7 +130,9 @@ void icmpv6rpl_trigger(void)      { return; }
 void icmpv6rpl_writeDODAGid(uint8_t* dodagid) { return; }
 
 void icmpv6rpl_setDIOPeriod(uint16_t dioPeriod) { return; }
+void icmpv6rpl_resetDIOTrickle(void) { return; }
 void icmpv6rpl_setDAOPeriod(uint16_t daoPeriod) { return; }
+void icmpv6rpl_triggerDAO(void) { return; }
 
 void opentcp_init(void)           { return; }
 
@@ -0,0 +1,101 @@
+/**
+\brief Benchmark of the neighbor table lookups.
+
+Fills the neighbor table with MAXNUMNEIGHBORS neighbors, then measures how many
+per-frame neighbor updates (neighbors_indicateRx(), neighbors_indicateTx()) and
+lookups (neighbors_isPreferredParent()) are done per second. The results are
+printed on the console, so this project is meant for the python board:
+
+   scons board=python toolchain=gcc 03oos_neighbors
+
+Compile with a larger MAXNUMNEIGHBORS to verify the lookup cost does not grow
+with the size of the neighbor table. Once the benchmark is done, the mote runs
+the regular stack.
+*/
+
+// stack initialization
+#include "opendefs.h"
+#include "board.h"
+#include "scheduler.h"
+#include "openstack.h"
+// needed for the benchmark
+#include "neighbors.h"
+#ifdef OPENSIM
+#include <stdio.h>
+#include <time.h>
+#endif
+
+//=========================== defines =========================================
+
+#define NUM_ROUNDS           10000 // lookups per neighbor, for each function
+
+//=========================== variables =======================================
+
+//=========================== prototypes ======================================
+
+void neighborsbench_run(void);
+
+//=========================== initialization ==================================
+
+int mote_main(void) {
+   board_init();
+   scheduler_init();
+   openstack_init();
+#ifdef OPENSIM
+   neighborsbench_run();
+   // start over with an empty neighbor table
+   neighbors_init();
+#endif
+   scheduler_start();
+   return 0; // this line should never be reached
+}
+
+//=========================== private =========================================
+
+#ifdef OPENSIM
+void neighborsbench_run() {
+   open_addr_t     addr[MAXNUMNEIGHBORS];
+   asn_t           asn;
+   uint8_t         i;
+   uint32_t        round;
+   uint32_t        numLookups;
+   clock_t         start;
+   double          elapsed;
+
+   memset(&asn,0,sizeof(asn_t));
+
+   // fill the neighbor table
+   for (i=0;i<MAXNUMNEIGHBORS;i++) {
+      memset(&addr[i],0,sizeof(open_addr_t));
+      addr[i].type           = ADDR_64B;
+      addr[i].addr_64b[0]    = 0x14;
+      addr[i].addr_64b[1]    = 0x15;
+      addr[i].addr_64b[2]    = 0x92;
+      addr[i].addr_64b[6]    = i/0x10;
+      addr[i].addr_64b[7]    = i;
+      neighbors_indicateRx(&addr[i],-50,&asn,FALSE,0);
+   }
+   printf("neighbors: %d neighbors in the table\r\n",neighbors_getNumNeighbors());
+
+   // per-frame updates and lookups
+   numLookups = 0;
+   start      = clock();
+   for (round=0;round<NUM_ROUNDS;round++) {
+      for (i=0;i<MAXNUMNEIGHBORS;i++) {
+         neighbors_indicateRx(&addr[i],-50,&asn,FALSE,0);
+         neighbors_indicateTx(&addr[i],1,TRUE,&asn);
+         neighbors_isPreferredParent(&addr[i]);
+         numLookups += 3;
+      }
+   }
+   elapsed    = (double)(clock()-start)/CLOCKS_PER_SEC;
+
+   if (elapsed>0) {
+      printf("neighbors: %u lookups in %.3fs, %.0f lookups/s\r\n",
+         (unsigned)numLookups,
+         elapsed,
+         numLookups/elapsed
+      );
+   }
+}
+#endif
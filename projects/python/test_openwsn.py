@@ -36,6 +36,16 @@ def eui64_get():
 
 def bsp_timer_scheduleIn(delay):
    print "P: bsp_timer_scheduleIn({0})".format(delay)
+
+def events(batch):
+   # records are [notifId][length][payload]
+   i = 0
+   while i<len(batch):
+      id      = ord(batch[i])
+      length  = ord(batch[i+1])
+      payload = [ord(b) for b in batch[i+2:i+2+length]]
+      print "P: {0}({1}) (batched)".format(notifString[id],payload)
+      i      += 2+length
    
 # create instance
 mote = oos_openwsn.OpenMote()
@@ -49,6 +59,7 @@ for i in range(len(notifString)-1):
 # overwrite some callbacks
 mote.set_callback(notifId('eui64_get'),           eui64_get)
 mote.set_callback(notifId('bsp_timer_scheduleIn'),bsp_timer_scheduleIn)
+mote.set_callback(notifId('events'),              events)
 
 # start the mote
 mote.supply_on()